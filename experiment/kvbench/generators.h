@@ -0,0 +1,82 @@
+#ifndef _GENERATORS_H
+#define _GENERATORS_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include <random>
+
+// Key choosers for the YCSB workloads. Each thread owns its own copies; only
+// the number of items they choose from is shared through the caller.
+
+struct UniformGenerator {
+  std::mt19937_64 rng;
+
+  UniformGenerator(uint64_t seed) : rng(seed) {}
+
+  // Uniform in [0, n)
+  uint64_t next(uint64_t n) {
+    return std::uniform_int_distribution<uint64_t>(0, n - 1)(rng);
+  }
+  double next_double() {
+    return std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+  }
+};
+
+// Zipfian over [0, n) where 0 is the most popular item, using the method from
+// Gray et al., "Quickly Generating Billion-Record Synthetic Databases" as in
+// YCSB. zeta(n) is extended incrementally when n grows, so the "latest"
+// distribution can follow inserts without recomputing it from scratch.
+struct ZipfianGenerator {
+  double theta;
+  double alpha;
+  double zeta2;
+  double zetan;
+  uint64_t n;
+  UniformGenerator uniform;
+
+  ZipfianGenerator(uint64_t items, uint64_t seed, double theta = 0.99)
+      : theta(theta), n(0), uniform(seed) {
+    alpha = 1.0 / (1.0 - theta);
+    zeta2 = 1.0 + pow(0.5, theta);
+    zetan = 0;
+    grow(items);
+  }
+
+  void grow(uint64_t items) {
+    for (uint64_t i = n + 1; i <= items; i++) {
+      zetan += 1.0 / pow((double)i, theta);
+    }
+    if (items > n) {
+      n = items;
+    }
+  }
+
+  uint64_t next() {
+    double eta = (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan);
+    double u = uniform.next_double();
+    double uz = u * zetan;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + pow(0.5, theta)) {
+      return 1;
+    }
+    uint64_t item = (uint64_t)(n * pow(eta * u - eta + 1, alpha));
+    return item >= n ? n - 1 : item;
+  }
+};
+
+// FNV-1a over the bytes of a 64 bit integer, used to scatter popular items
+// over the key space as YCSB's scrambled zipfian does
+inline uint64_t fnv_hash64(uint64_t value) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (int i = 0; i < 8; i++) {
+    hash ^= value & 0xff;
+    hash *= 0x100000001b3ULL;
+    value >>= 8;
+  }
+  return hash;
+}
+
+#endif
@@ -0,0 +1,477 @@
+// YCSB-style workload driver. Loads a database with sequential keys, runs one
+// of the YCSB core workloads (or a custom mix) from several threads and
+// prints throughput, latency percentiles and I/O bytes as JSON or CSV.
+//
+//   ./kvbench --workload=a --records=100000 --operations=100000 --threads=4
+//
+// With --shards=N the workload runs against a ShardedDB of N shards instead,
+// to measure how throughput scales with them.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../src/db.h"
+#include "../../src/exceptions.h"
+#include "../../src/sharded_db.h"
+#include "generators.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+enum Op { READ, UPDATE, INSERT, SCAN, RMW, NUM_OPS };
+const char* OP_NAMES[NUM_OPS] = {"read", "update", "insert", "scan",
+                                 "read_modify_write"};
+
+struct Options {
+  string workload = "a";
+  string distribution = "";  // Defaults to the workload's distribution
+  double proportions[NUM_OPS] = {0, 0, 0, 0, 0};
+  uint64_t records = 100000;
+  uint64_t operations = 100000;
+  uint64_t warmup = 0;  // Operations run before measuring
+  int threads = 1;
+  int shards = 0;  // 0 for a single DB, otherwise a ShardedDB of this many
+  int max_scan_length = 100;
+  string db_name = "kvbench_db";
+  int memtable_size = DEFAULT_MEMTABLE_SIZE;
+  size_t bp_bytes = DEFAULT_BUFFER_POOL_BYTES;
+  int bp_policy = CLOCK;
+  size_t row_cache_bytes = 0;
+  int compaction_trigger = 0;
+  string format = "json";
+  bool keep = false;  // Keep the database directory afterwards
+  string trace = "";  // Record the measured phase to this trace file
+  uint64_t seed = 42;
+  bool help = false;  // Print the options and exit
+};
+
+struct IOCounters {
+  uint64_t read_bytes = 0;   // Bytes fetched from storage
+  uint64_t write_bytes = 0;  // Bytes sent to storage
+  uint64_t rchar = 0;        // Bytes passed to read syscalls
+  uint64_t wchar = 0;        // Bytes passed to write syscalls
+};
+
+void usage() {
+  cerr << "Usage: kvbench [--workload=a|b|c|d|e|f|custom]\n"
+          "  [--distribution=zipfian|uniform|latest] [--records=N]\n"
+          "  [--operations=N] [--warmup=N] [--threads=N] [--max-scan=N]\n"
+          "  [--read=P] [--update=P] [--insert=P] [--scan=P] [--rmw=P]\n"
+          "  [--db=DIR] [--memtable=N] [--bp-bytes=N] [--policy=clock|lru]\n"
+          "  [--row-cache-bytes=N] [--format=json|csv] [--seed=N] [--keep]\n"
+          "  [--compaction-trigger=N] [--trace=FILE] [--shards=N] [--help]\n";
+}
+
+// Set the operation mix and distribution of the YCSB core workloads
+bool apply_workload(Options& options) {
+  double* p = options.proportions;
+  string dist = "zipfian";
+  if (options.workload == "a") {
+    p[READ] = 0.5, p[UPDATE] = 0.5;
+  } else if (options.workload == "b") {
+    p[READ] = 0.95, p[UPDATE] = 0.05;
+  } else if (options.workload == "c") {
+    p[READ] = 1.0;
+  } else if (options.workload == "d") {
+    p[READ] = 0.95, p[INSERT] = 0.05;
+    dist = "latest";
+  } else if (options.workload == "e") {
+    p[SCAN] = 0.95, p[INSERT] = 0.05;
+  } else if (options.workload == "f") {
+    p[READ] = 0.5, p[RMW] = 0.5;
+  } else if (options.workload != "custom") {
+    return false;
+  }
+  if (options.distribution.empty()) {
+    options.distribution = dist;
+  }
+  return options.distribution == "zipfian" ||
+         options.distribution == "uniform" || options.distribution == "latest";
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+  bool custom_mix = false;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    size_t eq = arg.find('=');
+    string flag = arg.substr(0, eq);
+    string value = eq == string::npos ? "" : arg.substr(eq + 1);
+    if (flag == "--workload") {
+      options.workload = value;
+    } else if (flag == "--distribution") {
+      options.distribution = value;
+    } else if (flag == "--records") {
+      options.records = stoull(value);
+    } else if (flag == "--operations") {
+      options.operations = stoull(value);
+    } else if (flag == "--warmup") {
+      options.warmup = stoull(value);
+    } else if (flag == "--threads") {
+      options.threads = stoi(value);
+    } else if (flag == "--shards") {
+      options.shards = stoi(value);
+    } else if (flag == "--max-scan") {
+      options.max_scan_length = stoi(value);
+    } else if (flag == "--read") {
+      options.proportions[READ] = stod(value), custom_mix = true;
+    } else if (flag == "--update") {
+      options.proportions[UPDATE] = stod(value), custom_mix = true;
+    } else if (flag == "--insert") {
+      options.proportions[INSERT] = stod(value), custom_mix = true;
+    } else if (flag == "--scan") {
+      options.proportions[SCAN] = stod(value), custom_mix = true;
+    } else if (flag == "--rmw") {
+      options.proportions[RMW] = stod(value), custom_mix = true;
+    } else if (flag == "--db") {
+      options.db_name = value;
+    } else if (flag == "--memtable") {
+      options.memtable_size = stoi(value);
+    } else if (flag == "--bp-bytes") {
+      options.bp_bytes = stoull(value);
+    } else if (flag == "--policy") {
+      options.bp_policy = value == "lru" ? LRU : CLOCK;
+    } else if (flag == "--row-cache-bytes") {
+      options.row_cache_bytes = stoull(value);
+    } else if (flag == "--compaction-trigger") {
+      options.compaction_trigger = stoi(value);
+    } else if (flag == "--format") {
+      options.format = value;
+    } else if (flag == "--seed") {
+      options.seed = stoull(value);
+    } else if (flag == "--keep") {
+      options.keep = true;
+    } else if (flag == "--trace") {
+      options.trace = value;
+    } else if (flag == "--help") {
+      options.help = true;
+    } else {
+      return false;
+    }
+  }
+  if (custom_mix) {
+    options.workload = "custom";
+  }
+  // Traces are recorded by a single DB
+  if (options.shards > 0 && !options.trace.empty()) {
+    return false;
+  }
+  return options.threads > 0 && options.records > 0 && options.shards >= 0 &&
+         apply_workload(options);
+}
+
+IOCounters read_io_counters() {
+  IOCounters counters;
+  ifstream io("/proc/self/io");
+  string field;
+  uint64_t value;
+  while (io >> field >> value) {
+    if (field == "read_bytes:") {
+      counters.read_bytes = value;
+    } else if (field == "write_bytes:") {
+      counters.write_bytes = value;
+    } else if (field == "rchar:") {
+      counters.rchar = value;
+    } else if (field == "wchar:") {
+      counters.wchar = value;
+    }
+  }
+  return counters;
+}
+
+// The database a workload runs against, one DB or a ShardedDB
+struct Store {
+  DB* db = NULL;
+  ShardedDB* sharded = NULL;
+
+  void put(uint64_t key, uint64_t value) {
+    db ? db->put(key, value) : sharded->put(key, value);
+  }
+  uint64_t get(uint64_t key) { return db ? db->get(key) : sharded->get(key); }
+  vector<KVPair> scan(uint64_t key1, uint64_t key2) {
+    return db ? db->scan(key1, key2) : sharded->scan(key1, key2);
+  }
+};
+
+struct Worker {
+  Options* options;
+  Store* db;
+  atomic<uint64_t>* inserted;  // Keys [0, inserted) have been loaded
+  UniformGenerator uniform;
+  ZipfianGenerator zipfian;
+  vector<uint64_t> latencies[NUM_OPS];  // Nanoseconds per operation
+
+  Worker(Options* options, Store* db, atomic<uint64_t>* inserted,
+         uint64_t seed)
+      : options(options),
+        db(db),
+        inserted(inserted),
+        uniform(seed),
+        zipfian(options->records, seed + 1) {}
+
+  Op choose_op() {
+    double r = uniform.next_double();
+    double total = 0;
+    for (int op = 0; op < NUM_OPS; op++) {
+      total += options->proportions[op];
+    }
+    r *= total;
+    for (int op = 0; op < NUM_OPS; op++) {
+      if (r < options->proportions[op]) {
+        return (Op)op;
+      }
+      r -= options->proportions[op];
+    }
+    return READ;
+  }
+
+  uint64_t choose_key() {
+    uint64_t n = inserted->load();
+    if (options->distribution == "uniform") {
+      return uniform.next(n);
+    }
+    zipfian.grow(n);
+    if (options->distribution == "latest") {
+      return n - 1 - zipfian.next();
+    }
+    return fnv_hash64(zipfian.next()) % n;
+  }
+
+  void run(uint64_t count, bool record) {
+    for (uint64_t i = 0; i < count; i++) {
+      Op op = choose_op();
+      auto start = chrono::steady_clock::now();
+      switch (op) {
+        case READ:
+          read(choose_key());
+          break;
+        case UPDATE:
+          db->put(choose_key(), uniform.next(MAX_KEY - 1));
+          break;
+        case INSERT: {
+          uint64_t key = inserted->fetch_add(1);
+          db->put(key, key);
+          break;
+        }
+        case SCAN: {
+          uint64_t key = choose_key();
+          uint64_t length = 1 + uniform.next(options->max_scan_length);
+          db->scan(key, key + length - 1);
+          break;
+        }
+        case RMW: {
+          uint64_t key = choose_key();
+          uint64_t value = read(key);
+          db->put(key, value + 1);
+          break;
+        }
+        default:
+          break;
+      }
+      auto end = chrono::steady_clock::now();
+      if (record) {
+        latencies[op].push_back(
+            chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+      }
+    }
+  }
+
+  uint64_t read(uint64_t key) {
+    try {
+      return db->get(key);
+    } catch (const KeyException& e) {
+      return 0;
+    }
+  }
+};
+
+// Run count operations split over the worker threads
+void run_workers(vector<Worker>& workers, uint64_t count, bool record) {
+  vector<thread> threads;
+  for (size_t t = 0; t < workers.size(); t++) {
+    uint64_t share = count / workers.size() + (t < count % workers.size());
+    threads.push_back(thread(&Worker::run, &workers[t], share, record));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+struct OpSummary {
+  uint64_t count;
+  double mean_us, p50_us, p95_us, p99_us, p999_us, max_us;
+};
+
+OpSummary summarize(vector<uint64_t>& latencies) {
+  OpSummary summary = {};
+  summary.count = latencies.size();
+  if (latencies.empty()) {
+    return summary;
+  }
+  sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) {
+    size_t index = (size_t)(p * (latencies.size() - 1));
+    return latencies[index] / 1000.0;
+  };
+  double total = 0;
+  for (uint64_t latency : latencies) {
+    total += latency;
+  }
+  summary.mean_us = total / latencies.size() / 1000.0;
+  summary.p50_us = percentile(0.50);
+  summary.p95_us = percentile(0.95);
+  summary.p99_us = percentile(0.99);
+  summary.p999_us = percentile(0.999);
+  summary.max_us = latencies.back() / 1000.0;
+  return summary;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parse_options(argc, argv, options) || options.help) {
+    usage();
+    return options.help ? 0 : 1;
+  }
+
+  fs::remove_all(options.db_name);
+  DB single;
+  ShardedDB sharded;
+  Store db;
+  if (options.shards == 0) {
+    if (!single.open(options.db_name, options.memtable_size,
+                     options.bp_policy, options.bp_bytes,
+                     options.row_cache_bytes)) {
+      return 1;
+    }
+    single.compaction_trigger = options.compaction_trigger;
+    db.db = &single;
+  } else {
+    if (!sharded.open(options.db_name, options.shards, options.memtable_size,
+                      options.bp_policy, options.bp_bytes,
+                      options.row_cache_bytes)) {
+      return 1;
+    }
+    for (auto& shard : sharded.shards) {
+      shard->db.compaction_trigger = options.compaction_trigger;
+    }
+    db.sharded = &sharded;
+  }
+
+  // Load phase
+  auto load_start = chrono::steady_clock::now();
+  for (uint64_t key = 0; key < options.records; key++) {
+    db.put(key, key);
+  }
+  chrono::duration<double> load_seconds =
+      chrono::steady_clock::now() - load_start;
+  atomic<uint64_t> inserted(options.records);
+
+  vector<Worker> workers;
+  for (int t = 0; t < options.threads; t++) {
+    workers.push_back(
+        Worker(&options, &db, &inserted, options.seed + 2 * t));
+  }
+  run_workers(workers, options.warmup, false);
+
+  // Measured phase
+  if (!options.trace.empty() && !single.start_trace(options.trace)) {
+    return 1;
+  }
+  IOCounters io_start = read_io_counters();
+  auto run_start = chrono::steady_clock::now();
+  run_workers(workers, options.operations, true);
+  chrono::duration<double> run_seconds =
+      chrono::steady_clock::now() - run_start;
+  IOCounters io_end = read_io_counters();
+  if (db.db) {
+    single.end_trace();
+  }
+
+  OpSummary summaries[NUM_OPS];
+  for (int op = 0; op < NUM_OPS; op++) {
+    vector<uint64_t> merged;
+    for (auto& worker : workers) {
+      merged.insert(merged.end(), worker.latencies[op].begin(),
+                    worker.latencies[op].end());
+    }
+    summaries[op] = summarize(merged);
+  }
+  double throughput = options.operations / run_seconds.count();
+
+  ostringstream out;
+  if (options.format == "csv") {
+    out << "workload,distribution,threads,shards,records,operations,"
+           "throughput_ops,"
+           "op,count,mean_us,p50_us,p95_us,p99_us,p999_us,max_us,"
+           "read_bytes,write_bytes\n";
+    for (int op = 0; op < NUM_OPS; op++) {
+      OpSummary& s = summaries[op];
+      if (s.count == 0) continue;
+      out << options.workload << "," << options.distribution << ","
+          << options.threads << "," << options.shards << ","
+          << options.records << ","
+          << options.operations << "," << throughput << "," << OP_NAMES[op]
+          << "," << s.count << "," << s.mean_us << "," << s.p50_us << ","
+          << s.p95_us << "," << s.p99_us << "," << s.p999_us << ","
+          << s.max_us << "," << io_end.read_bytes - io_start.read_bytes << ","
+          << io_end.write_bytes - io_start.write_bytes << "\n";
+    }
+  } else {
+    out << "{\"workload\": \"" << options.workload << "\", "
+        << "\"distribution\": \"" << options.distribution << "\", "
+        << "\"threads\": " << options.threads << ", "
+        << "\"shards\": " << options.shards << ", "
+        << "\"records\": " << options.records << ", "
+        << "\"operations\": " << options.operations << ", "
+        << "\"memtable_size\": " << options.memtable_size << ", "
+        << "\"bp_bytes\": " << options.bp_bytes << ", "
+        << "\"row_cache_bytes\": " << options.row_cache_bytes << ", "
+        << "\"compaction_trigger\": " << options.compaction_trigger << ", "
+        << "\"load_seconds\": " << load_seconds.count() << ", "
+        << "\"run_seconds\": " << run_seconds.count() << ", "
+        << "\"throughput_ops\": " << throughput << ", "
+        << "\"io\": {\"read_bytes\": " << io_end.read_bytes - io_start.read_bytes
+        << ", \"write_bytes\": " << io_end.write_bytes - io_start.write_bytes
+        << ", \"syscall_read_bytes\": " << io_end.rchar - io_start.rchar
+        << ", \"syscall_write_bytes\": " << io_end.wchar - io_start.wchar
+        << "}, \"ops\": {";
+    bool first = true;
+    for (int op = 0; op < NUM_OPS; op++) {
+      OpSummary& s = summaries[op];
+      if (s.count == 0) continue;
+      out << (first ? "" : ", ") << "\"" << OP_NAMES[op] << "\": {"
+          << "\"count\": " << s.count << ", \"mean_us\": " << s.mean_us
+          << ", \"p50_us\": " << s.p50_us << ", \"p95_us\": " << s.p95_us
+          << ", \"p99_us\": " << s.p99_us << ", \"p999_us\": " << s.p999_us
+          << ", \"max_us\": " << s.max_us << "}";
+      first = false;
+    }
+    out << "}";
+    // A ShardedDB keeps statistics per shard
+    if (db.db) {
+      out << ", \"engine\": " << single.get_statistics().to_json();
+    }
+    out << "}\n";
+  }
+  cout << out.str();
+
+  if (db.db) {
+    single.close();
+  } else {
+    sharded.close();
+  }
+  if (!options.keep) {
+    fs::remove_all(options.db_name);
+  }
+  return 0;
+}
@@ -0,0 +1,14 @@
+#!/bin/bash
+# Run the YCSB core workloads and collect the results in results.csv
+make kvbench
+RECORDS=${RECORDS:-100000}
+OPERATIONS=${OPERATIONS:-100000}
+THREADS=${THREADS:-1}
+rm -f results.csv
+for workload in a b c d e f; do
+  ./kvbench --workload=$workload --records=$RECORDS --operations=$OPERATIONS \
+    --threads=$THREADS --warmup=$((OPERATIONS / 10)) --format=csv "$@" > result.tmp
+  if [ -f results.csv ]; then tail -n +2 result.tmp >> results.csv; else cat result.tmp > results.csv; fi
+done
+rm -f result.tmp
+cat results.csv
@@ -0,0 +1,17 @@
+#!/bin/bash
+# Run one workload against ShardedDBs of a growing number of shards, with a
+# client thread per shard, and collect the results in scaling.csv
+make kvbench
+WORKLOAD=${WORKLOAD:-a}
+RECORDS=${RECORDS:-100000}
+OPERATIONS=${OPERATIONS:-400000}
+rm -f scaling.csv
+for shards in 1 2 4 8 16; do
+  if [ $shards -gt $(nproc) ]; then break; fi
+  ./kvbench --workload=$WORKLOAD --records=$RECORDS --operations=$OPERATIONS \
+    --threads=$shards --shards=$shards --warmup=$((OPERATIONS / 10)) \
+    --format=csv "$@" > result.tmp
+  if [ -f scaling.csv ]; then tail -n +2 result.tmp >> scaling.csv; else cat result.tmp > scaling.csv; fi
+done
+rm -f result.tmp
+cat scaling.csv
@@ -0,0 +1,240 @@
+// Microbenchmarks for the engine components on their own, using Google
+// Benchmark. Sizes are parameters so a change can be checked at several
+// scales, e.g.
+//
+//   ./microbench --benchmark_filter=BufferPool
+//   ./microbench --benchmark_format=json --benchmark_out=micro.json
+//
+// Each benchmark reports time_per_op: the time of a single operation even when
+// an iteration does several.
+
+#include <benchmark/benchmark.h>
+#include <stdlib.h>
+
+#include <random>
+#include <vector>
+
+#include "../../src/avl_tree.h"
+#include "../../src/buffer_pool.h"
+#include "../../src/clock_replacer.h"
+#include "../../src/kvpair.h"
+#include "../../src/lru_replacer.h"
+#include "../../src/sst.h"
+
+using namespace std;
+
+// Not exported by sst.h
+uint64_t get_in_page(KVPair *, uint64_t, uint64_t, int);
+
+const int ENTRIES_PER_PAGE = _PAGE_SIZE / sizeof(KVPair);
+
+vector<uint64_t> random_keys(size_t n, uint64_t seed = 1) {
+  mt19937_64 rng(seed);
+  vector<uint64_t> keys(n);
+  for (auto &key : keys) {
+    key = rng() % (MAX_KEY - 1);
+  }
+  return keys;
+}
+
+void set_time_per_op(benchmark::State &state, int64_t ops_per_iteration) {
+  state.counters["time_per_op"] = benchmark::Counter(
+      (double)state.iterations() * ops_per_iteration,
+      benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+KVPair *new_page() {
+  KVPair *page;
+  if (posix_memalign((void **)&page, BLOCK_SIZE, _PAGE_SIZE) != 0) {
+    abort();
+  }
+  return page;
+}
+
+// Fill a memtable of range(0) keys
+void BM_TreePut(benchmark::State &state) {
+  int n = state.range(0);
+  vector<uint64_t> keys = random_keys(n);
+  for (auto _ : state) {
+    Tree tree(n + 1);
+    for (uint64_t key : keys) {
+      tree.put(key, key);
+    }
+    benchmark::ClobberMemory();
+  }
+  set_time_per_op(state, n);
+}
+BENCHMARK(BM_TreePut)->RangeMultiplier(8)->Range(64, 1 << 15);
+
+// Fill a memtable of range(0) keys in increasing order, as timestamps are
+void BM_TreeAppend(benchmark::State &state) {
+  int n = state.range(0);
+  for (auto _ : state) {
+    Tree tree(n + 1);
+    for (uint64_t key = 0; key < (uint64_t)n; key++) {
+      tree.put(key, key);
+    }
+    benchmark::ClobberMemory();
+  }
+  set_time_per_op(state, n);
+}
+BENCHMARK(BM_TreeAppend)->RangeMultiplier(8)->Range(64, 1 << 15);
+
+void BM_TreeGet(benchmark::State &state) {
+  int n = state.range(0);
+  vector<uint64_t> keys = random_keys(n);
+  Tree tree(n + 1);
+  for (uint64_t key : keys) {
+    tree.put(key, key);
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tree.get(keys[i]));
+    i = (i + 1) % n;
+  }
+  set_time_per_op(state, 1);
+}
+BENCHMARK(BM_TreeGet)->RangeMultiplier(8)->Range(64, 1 << 15);
+
+// Scan range(1) consecutive keys from a memtable of range(0) keys
+void BM_TreeScan(benchmark::State &state) {
+  int n = state.range(0);
+  int length = state.range(1);
+  Tree tree(n + 1);
+  for (int key = 0; key < n; key++) {
+    tree.put(key, key);
+  }
+  vector<uint64_t> starts = random_keys(1024);
+  size_t i = 0;
+  for (auto _ : state) {
+    uint64_t start = starts[i] % (n - length + 1);
+    benchmark::DoNotOptimize(tree.scan(start, start + length - 1));
+    i = (i + 1) % starts.size();
+  }
+  set_time_per_op(state, 1);
+}
+BENCHMARK(BM_TreeScan)->ArgsProduct({{1 << 10, 1 << 15}, {1, 16, 256}});
+
+// Binary search within one SST page holding range(0) entries
+void BM_GetInPage(benchmark::State &state) {
+  int n = state.range(0);
+  KVPair *page = new_page();
+  for (int i = 0; i < n; i++) {
+    page[i] = {(uint64_t)i * 2, (uint64_t)i};
+  }
+  vector<uint64_t> keys = random_keys(1024);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(get_in_page(page, (keys[i] % n) * 2, MAX_SEQUENCE, n));
+    i = (i + 1) % keys.size();
+  }
+  free(page);
+  set_time_per_op(state, 1);
+}
+BENCHMARK(BM_GetInPage)->Arg(16)->Arg(64)->Arg(ENTRIES_PER_PAGE);
+
+// Lookups of cached pages in a pool holding range(0) pages
+void BM_BufferPoolGet(benchmark::State &state) {
+  int pages = state.range(0);
+  int policy = state.range(1);
+  BufferPool bp(DEFAULT_INITIAL_CAPACITY, directory_capacity_for(
+                    (size_t)pages * BP_PAGE_BYTES), DEFAULT_EXTEND_THRESHOLD,
+                policy, (size_t)pages * BP_PAGE_BYTES);
+  for (int i = 0; i < pages; i++) {
+    bp.put("bench.sst", i, new_page());
+  }
+  vector<uint64_t> keys = random_keys(4096);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(bp.get("bench.sst", keys[i] % pages));
+    i = (i + 1) % keys.size();
+  }
+  set_time_per_op(state, 1);
+}
+BENCHMARK(BM_BufferPoolGet)
+    ->ArgsProduct({{64, 1024, 16384}, {CLOCK, LRU}})
+    ->ArgNames({"pages", "policy"});
+
+// Inserts into a full pool of range(0) pages, so every put evicts. The page
+// allocation is part of the measured time.
+void BM_BufferPoolPutEvict(benchmark::State &state) {
+  int pages = state.range(0);
+  int policy = state.range(1);
+  BufferPool bp(DEFAULT_INITIAL_CAPACITY, directory_capacity_for(
+                    (size_t)pages * BP_PAGE_BYTES), DEFAULT_EXTEND_THRESHOLD,
+                policy, (size_t)pages * BP_PAGE_BYTES);
+  int next = 0;
+  for (; next < pages; next++) {
+    bp.put("bench.sst", next, new_page());
+  }
+  for (auto _ : state) {
+    bp.put("bench.sst", next++, new_page());
+  }
+  set_time_per_op(state, 1);
+}
+BENCHMARK(BM_BufferPoolPutEvict)
+    ->ArgsProduct({{64, 1024, 16384}, {CLOCK, LRU}})
+    ->ArgNames({"pages", "policy"});
+
+unique_ptr<Replacer> make_replacer(int policy) {
+  if (policy == LRU) {
+    return make_unique<LRUReplacer>();
+  }
+  return make_unique<ClockReplacer>();
+}
+
+// Accesses to pages already tracked by a replacer of range(0) pages
+void BM_ReplacerAccess(benchmark::State &state) {
+  int pages = state.range(0);
+  unique_ptr<Replacer> replacer = make_replacer(state.range(1));
+  vector<KVPair> frames(pages);
+  for (auto &frame : frames) {
+    replacer->record_access(&frame);
+  }
+  vector<uint64_t> keys = random_keys(4096);
+  size_t i = 0;
+  for (auto _ : state) {
+    replacer->record_access(&frames[keys[i] % pages]);
+    i = (i + 1) % keys.size();
+  }
+  set_time_per_op(state, 1);
+}
+BENCHMARK(BM_ReplacerAccess)
+    ->ArgsProduct({{64, 1024, 16384}, {CLOCK, LRU}})
+    ->ArgNames({"pages", "policy"});
+
+// Evict a victim and start tracking it again
+void BM_ReplacerEvict(benchmark::State &state) {
+  int pages = state.range(0);
+  unique_ptr<Replacer> replacer = make_replacer(state.range(1));
+  vector<KVPair> frames(pages);
+  for (auto &frame : frames) {
+    replacer->record_access(&frame);
+  }
+  for (auto _ : state) {
+    KVPair *victim = NULL;
+    replacer->evict(victim);
+    replacer->record_access(victim);
+  }
+  set_time_per_op(state, 1);
+}
+BENCHMARK(BM_ReplacerEvict)
+    ->ArgsProduct({{64, 1024, 16384}, {CLOCK, LRU}})
+    ->ArgNames({"pages", "policy"});
+
+// Merge two sorted runs of range(0) pairs each with interleaved keys
+void BM_Merge(benchmark::State &state) {
+  int n = state.range(0);
+  vector<KVPair> newer(n), older(n);
+  for (int i = 0; i < n; i++) {
+    newer[i] = {(uint64_t)i * 2, 1};
+    older[i] = {(uint64_t)i * 2 + 1, 2};
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(merge(newer, older));
+  }
+  set_time_per_op(state, 2 * n);
+}
+BENCHMARK(BM_Merge)->RangeMultiplier(8)->Range(64, 1 << 18);
+
+BENCHMARK_MAIN();
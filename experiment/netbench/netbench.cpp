@@ -0,0 +1,229 @@
+// Measures a KVServer over loopback: many connections, each keeping a number
+// of requests in flight, report throughput and request latency. Without
+// --port a server is started in-process on a fresh database.
+//
+//   ./netbench --connections=64 --pipeline=16 --batch=1 --read=0.9
+//   ./netbench --port=7070 --connections=256  # against a running kvserver
+
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../src/db.h"
+#include "../../src/kv_client.h"
+#include "../../src/server.h"
+#include "../../src/statistics.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+struct Options {
+  string host = "127.0.0.1";
+  int port = 0;  // 0 starts a server in-process
+  string db_name = "netbench_db";
+  int server_threads = 1;
+  int memtable_size = DEFAULT_MEMTABLE_SIZE;
+  int connections = 16;
+  int pipeline = 1;  // Requests in flight per connection
+  int batch = 1;     // Keys per request
+  uint64_t records = 100000;
+  uint64_t operations = 100000;  // Requests over all connections
+  double read = 0.5;             // Fraction of requests that are GETs, the rest PUTs
+  uint64_t seed = 1;
+  string format = "json";
+};
+
+void usage() {
+  cerr << "Usage: netbench [--host=ADDR] [--port=N] [--db=DIR]\n"
+          "  [--server-threads=N] [--memtable=N] [--connections=N]\n"
+          "  [--pipeline=N] [--batch=N] [--records=N] [--operations=N]\n"
+          "  [--read=P] [--seed=N] [--format=json|text]\n"
+          "Without --port a server is started in-process on a fresh --db.\n";
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    size_t eq = arg.find('=');
+    string flag = arg.substr(0, eq);
+    string value = eq == string::npos ? "" : arg.substr(eq + 1);
+    if (flag == "--host") {
+      options.host = value;
+    } else if (flag == "--port") {
+      options.port = stoi(value);
+    } else if (flag == "--db") {
+      options.db_name = value;
+    } else if (flag == "--server-threads") {
+      options.server_threads = stoi(value);
+    } else if (flag == "--memtable") {
+      options.memtable_size = stoi(value);
+    } else if (flag == "--connections") {
+      options.connections = stoi(value);
+    } else if (flag == "--pipeline") {
+      options.pipeline = stoi(value);
+    } else if (flag == "--batch") {
+      options.batch = stoi(value);
+    } else if (flag == "--records") {
+      options.records = stoull(value);
+    } else if (flag == "--operations") {
+      options.operations = stoull(value);
+    } else if (flag == "--read") {
+      options.read = stod(value);
+    } else if (flag == "--seed") {
+      options.seed = stoull(value);
+    } else if (flag == "--format") {
+      options.format = value;
+    } else {
+      return false;
+    }
+  }
+  return options.connections > 0 && options.pipeline > 0 &&
+         options.batch > 0 && options.records > 0 && options.server_threads > 0;
+}
+
+// Run count requests on one connection, keeping up to pipeline in flight
+bool run_connection(const Options* options, uint64_t count, uint64_t seed,
+                    Histogram* latency) {
+  KVClient client;
+  if (!client.connect(options->host, options->port)) {
+    return false;
+  }
+  mt19937_64 rng(seed);
+  uniform_real_distribution<double> coin(0, 1);
+  deque<chrono::steady_clock::time_point> sent;
+  uint64_t issued = 0;
+  Response response;
+  while (issued < count || !sent.empty()) {
+    while (issued < count && (int)sent.size() < options->pipeline) {
+      Request request;
+      request.op = coin(rng) < options->read ? PROTO_GET : PROTO_PUT;
+      for (int i = 0; i < options->batch; i++) {
+        uint64_t key = rng() % options->records;
+        request.keys.push_back(key);
+        if (request.op == PROTO_PUT) {
+          request.values.push_back(key + 1);
+        }
+      }
+      client.send(request);
+      sent.push_back(chrono::steady_clock::now());
+      issued++;
+    }
+    if (!client.receive(&response)) {
+      return false;
+    }
+    latency->record(chrono::duration_cast<chrono::nanoseconds>(
+                        chrono::steady_clock::now() - sent.front())
+                        .count());
+    sent.pop_front();
+  }
+  client.close();
+  return true;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    usage();
+    return 1;
+  }
+
+  DB db;
+  KVServer server;
+  bool in_process = options.port == 0;
+  if (in_process) {
+    fs::remove_all(options.db_name);
+    if (!db.open(options.db_name, options.memtable_size) ||
+        !server.start(&db, options.host, 0, options.server_threads)) {
+      return 1;
+    }
+    options.port = server.port;
+  }
+
+  // Load phase, in large batches over one connection
+  KVClient loader;
+  if (!loader.connect(options.host, options.port)) {
+    return 1;
+  }
+  vector<KVPair> kvpairs;
+  for (uint64_t key = 0; key < options.records; key++) {
+    kvpairs.push_back({key, key + 1});
+    if (kvpairs.size() == 1024 || key + 1 == options.records) {
+      if (!loader.multi_put(kvpairs)) {
+        return 1;
+      }
+      kvpairs.clear();
+    }
+  }
+  loader.close();
+
+  vector<Histogram> latencies(options.connections);
+  vector<thread> threads;
+  atomic<bool> failed(false);
+  auto start = chrono::steady_clock::now();
+  for (int c = 0; c < options.connections; c++) {
+    uint64_t share = options.operations / options.connections +
+                     ((uint64_t)c < options.operations % options.connections);
+    threads.push_back(thread([&, c, share]() {
+      if (!run_connection(&options, share, options.seed + c, &latencies[c])) {
+        failed = true;
+      }
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  chrono::duration<double> run_seconds = chrono::steady_clock::now() - start;
+  if (in_process) {
+    server.stop();
+    server.wait();
+    db.close();
+    fs::remove_all(options.db_name);
+  }
+  if (failed) {
+    return 1;
+  }
+
+  Histogram merged;
+  for (auto& latency : latencies) {
+    merged.merge(latency);
+  }
+  double requests_per_second = options.operations / run_seconds.count();
+  ostringstream out;
+  if (options.format == "text") {
+    out << "connections: " << options.connections
+        << " pipeline: " << options.pipeline << " batch: " << options.batch
+        << " run_seconds: " << run_seconds.count()
+        << " requests_per_second: " << requests_per_second
+        << " keys_per_second: " << requests_per_second * options.batch << "\n"
+        << "request mean_us: " << merged.mean() / 1000
+        << " p50_us: " << merged.percentile(50) / 1000.0
+        << " p99_us: " << merged.percentile(99) / 1000.0
+        << " p999_us: " << merged.percentile(99.9) / 1000.0
+        << " max_us: " << merged.max / 1000.0 << "\n";
+  } else {
+    out << "{\"connections\": " << options.connections << ", "
+        << "\"pipeline\": " << options.pipeline << ", "
+        << "\"batch\": " << options.batch << ", "
+        << "\"server_threads\": " << options.server_threads << ", "
+        << "\"records\": " << options.records << ", "
+        << "\"operations\": " << options.operations << ", "
+        << "\"read\": " << options.read << ", "
+        << "\"run_seconds\": " << run_seconds.count() << ", "
+        << "\"requests_per_second\": " << requests_per_second << ", "
+        << "\"keys_per_second\": " << requests_per_second * options.batch
+        << ", \"latency\": {\"mean_us\": " << merged.mean() / 1000
+        << ", \"p50_us\": " << merged.percentile(50) / 1000.0
+        << ", \"p95_us\": " << merged.percentile(95) / 1000.0
+        << ", \"p99_us\": " << merged.percentile(99) / 1000.0
+        << ", \"p999_us\": " << merged.percentile(99.9) / 1000.0
+        << ", \"max_us\": " << merged.max / 1000.0 << "}}\n";
+  }
+  cout << out.str();
+  return 0;
+}
@@ -0,0 +1,219 @@
+// Replays a trace recorded with DB::start_trace against a database, at the
+// recorded pace, faster, or as fast as possible, and reports throughput and
+// latency per operation.
+//
+//   ./replay --trace=prod.trace --db=prod_copy --speed=2 --threads=4
+
+#include <stdlib.h>
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../src/db.h"
+#include "../../src/exceptions.h"
+#include "../../src/statistics.h"
+#include "../../src/trace.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const int TRACE_OPS = 6;
+const char* OP_NAMES[TRACE_OPS] = {"put", "get", "del", "scan", "merge",
+                                   "del_range"};
+
+struct Options {
+  string trace;
+  string db_name = "replay_db";
+  bool fresh = false;  // Start from an empty database
+  int threads = 1;
+  double speed = 0;  // Multiple of the recorded pace, 0 for as fast as possible
+  int memtable_size = DEFAULT_MEMTABLE_SIZE;
+  size_t bp_bytes = DEFAULT_BUFFER_POOL_BYTES;
+  int bp_policy = CLOCK;
+  size_t row_cache_bytes = 0;
+  string format = "json";
+};
+
+void usage() {
+  cerr << "Usage: replay --trace=FILE [--db=DIR] [--fresh] [--threads=N]\n"
+          "  [--speed=X] [--memtable=N] [--bp-bytes=N] [--policy=clock|lru]\n"
+          "  [--row-cache-bytes=N] [--format=json|text]\n"
+          "--speed=1 keeps the recorded pace, 2 replays twice as fast and 0\n"
+          "(the default) replays as fast as possible.\n";
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    size_t eq = arg.find('=');
+    string flag = arg.substr(0, eq);
+    string value = eq == string::npos ? "" : arg.substr(eq + 1);
+    if (flag == "--trace") {
+      options.trace = value;
+    } else if (flag == "--db") {
+      options.db_name = value;
+    } else if (flag == "--fresh") {
+      options.fresh = true;
+    } else if (flag == "--threads") {
+      options.threads = stoi(value);
+    } else if (flag == "--speed") {
+      options.speed = stod(value);
+    } else if (flag == "--memtable") {
+      options.memtable_size = stoi(value);
+    } else if (flag == "--bp-bytes") {
+      options.bp_bytes = stoull(value);
+    } else if (flag == "--policy") {
+      options.bp_policy = value == "lru" ? LRU : CLOCK;
+    } else if (flag == "--row-cache-bytes") {
+      options.row_cache_bytes = stoull(value);
+    } else if (flag == "--format") {
+      options.format = value;
+    } else {
+      return false;
+    }
+  }
+  return !options.trace.empty() && options.threads > 0 && options.speed >= 0;
+}
+
+// Replay the records of one thread, keeping to the schedule if there is one
+void replay(DB* db, const vector<TraceRecord>& records, double speed,
+            chrono::steady_clock::time_point start, vector<Histogram>* latency) {
+  for (const TraceRecord& record : records) {
+    if (speed > 0) {
+      this_thread::sleep_until(
+          start + chrono::nanoseconds((uint64_t)(record.timestamp / speed)));
+    }
+    auto op_start = chrono::steady_clock::now();
+    try {
+      switch (record.op) {
+        case TRACE_PUT:
+          db->put(record.key, record.arg);
+          break;
+        case TRACE_GET:
+          db->get(record.key);
+          break;
+        case TRACE_DEL:
+          db->del(record.key);
+          break;
+        case TRACE_SCAN:
+          db->scan(record.key, record.arg);
+          break;
+        case TRACE_MERGE:
+          db->merge(record.key, record.arg);
+          break;
+        case TRACE_DEL_RANGE:
+          db->del_range(record.key, record.arg);
+          break;
+      }
+    } catch (const KeyException& e) {
+    }
+    (*latency)[record.op].record(chrono::duration_cast<chrono::nanoseconds>(
+                                     chrono::steady_clock::now() - op_start)
+                                     .count());
+  }
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    usage();
+    return 1;
+  }
+
+  // Operations on a key stay in one thread so they replay in their order
+  vector<vector<TraceRecord>> per_thread(options.threads);
+  TraceReader reader;
+  if (!reader.open(options.trace)) {
+    return 1;
+  }
+  TraceRecord record;
+  uint64_t num_records = 0;
+  uint64_t trace_nanos = 0;
+  while (reader.next(&record)) {
+    if (record.op >= TRACE_OPS) {
+      continue;
+    }
+    per_thread[record.key * 0x9E3779B97F4A7C15ULL % options.threads].push_back(
+        record);
+    trace_nanos = record.timestamp;
+    num_records++;
+  }
+  reader.close();
+
+  if (options.fresh) {
+    fs::remove_all(options.db_name);
+  }
+  DB db;
+  if (!db.open(options.db_name, options.memtable_size, options.bp_policy,
+               options.bp_bytes, options.row_cache_bytes)) {
+    return 1;
+  }
+
+  vector<vector<Histogram>> latencies(options.threads,
+                                      vector<Histogram>(TRACE_OPS));
+  vector<thread> threads;
+  auto start = chrono::steady_clock::now();
+  for (int t = 0; t < options.threads; t++) {
+    threads.push_back(thread(replay, &db, cref(per_thread[t]), options.speed,
+                             start, &latencies[t]));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  chrono::duration<double> run_seconds = chrono::steady_clock::now() - start;
+  db.close();
+
+  vector<Histogram> merged(TRACE_OPS);
+  for (auto& thread_latencies : latencies) {
+    for (int op = 0; op < TRACE_OPS; op++) {
+      merged[op].merge(thread_latencies[op]);
+    }
+  }
+  double throughput = num_records / run_seconds.count();
+
+  ostringstream out;
+  if (options.format == "text") {
+    out << "records: " << num_records
+        << " trace_seconds: " << trace_nanos / 1e9
+        << " run_seconds: " << run_seconds.count()
+        << " throughput_ops: " << throughput << "\n";
+    for (int op = 0; op < TRACE_OPS; op++) {
+      Histogram& h = merged[op];
+      out << OP_NAMES[op] << " count: " << h.count
+          << " mean_us: " << h.mean() / 1000
+          << " p50_us: " << h.percentile(50) / 1000.0
+          << " p99_us: " << h.percentile(99) / 1000.0
+          << " p999_us: " << h.percentile(99.9) / 1000.0
+          << " max_us: " << h.max / 1000.0 << "\n";
+    }
+  } else {
+    out << "{\"trace\": \"" << options.trace << "\", "
+        << "\"records\": " << num_records << ", "
+        << "\"threads\": " << options.threads << ", "
+        << "\"speed\": " << options.speed << ", "
+        << "\"trace_seconds\": " << trace_nanos / 1e9 << ", "
+        << "\"run_seconds\": " << run_seconds.count() << ", "
+        << "\"throughput_ops\": " << throughput << ", \"ops\": {";
+    bool first = true;
+    for (int op = 0; op < TRACE_OPS; op++) {
+      Histogram& h = merged[op];
+      if (h.count == 0) continue;
+      out << (first ? "" : ", ") << "\"" << OP_NAMES[op] << "\": {"
+          << "\"count\": " << h.count << ", \"mean_us\": " << h.mean() / 1000
+          << ", \"p50_us\": " << h.percentile(50) / 1000.0
+          << ", \"p95_us\": " << h.percentile(95) / 1000.0
+          << ", \"p99_us\": " << h.percentile(99) / 1000.0
+          << ", \"p999_us\": " << h.percentile(99.9) / 1000.0
+          << ", \"max_us\": " << h.max / 1000.0 << "}";
+      first = false;
+    }
+    out << "}}\n";
+  }
+  cout << out.str();
+  return 0;
+}
@@ -0,0 +1,101 @@
+// Serves a database over TCP until interrupted, then closes it cleanly.
+//
+//   ./kvserver --db=served_db --port=7070 --threads=4
+//   ./kvserver --db=served_db --port=6380 --protocol=resp  # for Redis clients
+
+#include <signal.h>
+
+#include <iostream>
+#include <string>
+
+#include "../src/db.h"
+#include "../src/server.h"
+
+using namespace std;
+
+struct Options {
+  string db_name = "kvserver_db";
+  string host = "0.0.0.0";
+  int port = 7070;
+  int threads = 1;
+  int protocol = SERVER_BINARY;
+  int memtable_size = DEFAULT_MEMTABLE_SIZE;
+  size_t bp_bytes = DEFAULT_BUFFER_POOL_BYTES;
+  int bp_policy = CLOCK;
+  size_t row_cache_bytes = 0;
+  int compaction_trigger = 0;
+};
+
+KVServer server;
+
+void usage() {
+  cerr << "Usage: kvserver [--db=DIR] [--host=ADDR] [--port=N] [--threads=N]\n"
+          "  [--protocol=binary|resp] [--memtable=N] [--bp-bytes=N] [--policy=clock|lru]\n"
+          "  [--row-cache-bytes=N] [--compaction-trigger=N]\n"
+          "--threads is the number of event loops serving connections.\n";
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    size_t eq = arg.find('=');
+    string flag = arg.substr(0, eq);
+    string value = eq == string::npos ? "" : arg.substr(eq + 1);
+    if (flag == "--db") {
+      options.db_name = value;
+    } else if (flag == "--host") {
+      options.host = value;
+    } else if (flag == "--port") {
+      options.port = stoi(value);
+    } else if (flag == "--threads") {
+      options.threads = stoi(value);
+    } else if (flag == "--protocol") {
+      if (value != "binary" && value != "resp") {
+        return false;
+      }
+      options.protocol = value == "resp" ? SERVER_RESP : SERVER_BINARY;
+    } else if (flag == "--memtable") {
+      options.memtable_size = stoi(value);
+    } else if (flag == "--bp-bytes") {
+      options.bp_bytes = stoull(value);
+    } else if (flag == "--policy") {
+      options.bp_policy = value == "lru" ? LRU : CLOCK;
+    } else if (flag == "--row-cache-bytes") {
+      options.row_cache_bytes = stoull(value);
+    } else if (flag == "--compaction-trigger") {
+      options.compaction_trigger = stoi(value);
+    } else {
+      return false;
+    }
+  }
+  return options.threads > 0;
+}
+
+void handle_signal(int) { server.stop(); }
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    usage();
+    return 1;
+  }
+
+  DB db;
+  if (!db.open(options.db_name, options.memtable_size, options.bp_policy,
+               options.bp_bytes, options.row_cache_bytes)) {
+    return 1;
+  }
+  db.compaction_trigger = options.compaction_trigger;
+  if (!server.start(&db, options.host, options.port, options.threads,
+                    options.protocol)) {
+    db.close();
+    return 1;
+  }
+  signal(SIGINT, handle_signal);
+  signal(SIGTERM, handle_signal);
+  cerr << "Serving " << options.db_name << " on " << options.host << ":"
+       << server.port << "\n";
+
+  server.wait();
+  return db.close() ? 0 : 1;
+}
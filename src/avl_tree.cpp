@@ -8,33 +8,65 @@
 
 using namespace std;
 
-Tree::Node_t Tree::NIL = {0, 0, &Tree::NIL, &Tree::NIL, -1};
+Tree::Node_t Tree::NIL = {0, 0, 0, {}, &Tree::NIL, &Tree::NIL, -1};
 
-Tree::Node_t *Tree::Node(uint64_t key, uint64_t value) {
+Tree::Node_t *Tree::Node(uint64_t key, uint64_t value, uint64_t seq) {
   Tree::Node_t *node = new Tree::Node_t;
   node->key = key;
   node->value = value;
+  node->seq = seq;
   node->left = &NIL;
   node->right = &NIL;
   node->height = 0;
+  num_nodes++;
   return node;
 }
 
-Tree::Node_t *Tree::insert(Tree::Node_t *root, uint64_t key, uint64_t value) {
+// Writes to a key already in the tree are kept for reads at older snapshots
+Tree::Node_t *Tree::insert(Tree::Node_t *root, uint64_t key, uint64_t value,
+                           uint64_t seq) {
   if (root == &NIL) {
-    root = Tree::Node(key, value);
+    root = Tree::Node(key, value, seq);
   } else if (key < root->key) {
-    root->left = Tree::insert(root->left, key, value);
+    root->left = Tree::insert(root->left, key, value, seq);
     root = rebalance_right(root);
   } else if (key > root->key) {
-    root->right = Tree::insert(root->right, key, value);
+    root->right = Tree::insert(root->right, key, value, seq);
     root = rebalance_left(root);
   } else {
+    root->older.insert(root->older.begin(), {key, root->value, root->seq});
+    num_older++;
     root->value = value;
+    root->seq = seq;
   }
   return root;
 }
 
+// Insert a key above every other. Its place is below the last node of the
+// right spine, so only the spine is walked, without comparing keys, and it is
+// rebalanced from the bottom only until a subtree's height stays the same.
+void Tree::append(uint64_t key, uint64_t value, uint64_t seq) {
+  Node_t *spine[MAX_HEIGHT];
+  size_t length = 0;
+  for (Node_t *node = root; node != &NIL; node = node->right) {
+    spine[length++] = node;
+  }
+  max_node = Tree::Node(key, value, seq);
+  spine[length - 1]->right = max_node;
+  for (size_t i = length; i-- > 0;) {
+    int height = spine[i]->height;
+    Node_t *balanced = rebalance_left(spine[i]);
+    if (i == 0) {
+      root = balanced;
+    } else {
+      spine[i - 1]->right = balanced;
+    }
+    if (balanced != spine[i] || balanced->height == height) {
+      break;
+    }
+  }
+}
+
 Tree::Node_t *Tree::rebalance_left(Tree::Node_t *root) {
   root->height = 1 + max(root->left->height, root->right->height);
   if (root->right->height > root->left->height + 1) {
@@ -81,7 +113,10 @@ Tree::Node_t *Tree::rotate_right(Tree::Node_t *parent) {
 
 Tree::Tree(unsigned int memtable_size) {
   root = &NIL;
+  max_node = &NIL;
   ttl = memtable_size;
+  num_nodes = 0;
+  num_older = 0;
 }
 
 Tree::~Tree() { DestructorRec(root); }
@@ -94,47 +129,141 @@ void Tree::DestructorRec(Node_t *node) {
   }
 }
 
-bool Tree::put(uint64_t key, uint64_t value) {
-  root = insert(root, key, value);
+// In-order keys, such as timestamps, take the append fast path
+bool Tree::put(uint64_t key, uint64_t value, uint64_t seq) {
+  if (root == &NIL) {
+    root = max_node = Tree::Node(key, value, seq);
+  } else if (key > max_node->key) {
+    append(key, value, seq);
+  } else {
+    root = insert(root, key, value, seq);
+  }
   return --ttl > 0;
 }
 
-uint64_t Tree::get(uint64_t key) {
+Tree::Node_t *Tree::find_node(uint64_t key) {
   Node_t *node = root;
-  while (node != &NIL) {
-    if (key < node->key) {
-      node = node->left;
-    } else if (key > node->key) {
-      node = node->right;
-    } else if (node->value == TOMBSTONE) {
-      break;
-    } else {
-      return node->value;
+  while (node != &NIL && node->key != key) {
+    node = key < node->key ? node->left : node->right;
+  }
+  return node;
+}
+
+uint64_t Tree::get(uint64_t key) {
+  Node_t *node = find_node(key);
+  if (node == &NIL || node->value == TOMBSTONE) {
+    throw KeyException("Key not found in tree");
+  }
+  return node->value;
+}
+
+// Find the newest write to a key with a sequence number of at most snapshot,
+// and the seq it was written with if seq isn't NULL. Return false if there is
+// none. A delete is found as a TOMBSTONE value.
+bool Tree::find(uint64_t key, uint64_t snapshot, uint64_t *value,
+                uint64_t *seq) {
+  Node_t *node = find_node(key);
+  if (node == &NIL) {
+    return false;
+  }
+  KVPair newest = {node->key, node->value, node->seq};
+  if (newest.sequence() <= snapshot) {
+    *value = newest.value;
+    if (seq != NULL) {
+      *seq = newest.seq;
     }
+    return true;
   }
-  throw KeyException("Key not found in tree");
+  for (auto &kvpair : node->older) {
+    if (kvpair.sequence() <= snapshot) {
+      *value = kvpair.value;
+      if (seq != NULL) {
+        *seq = kvpair.seq;
+      }
+      return true;
+    }
+  }
+  return false;
 }
 
-vector<KVPair> Tree::scan(uint64_t lower, uint64_t upper) {
-  vector<KVPair> output;
-  if (root == &NIL) return output;
+bool Tree::delete_range(uint64_t start, uint64_t end, uint64_t seq) {
+  range_deletions.push_back({start, end, seq});
+  return --ttl > 0;
+}
+
+uint64_t Tree::deleted_at(uint64_t key, uint64_t snapshot) {
+  return ::deleted_at(range_deletions, key, snapshot);
+}
 
+const vector<RangeTombstone> &Tree::range_tombstones() {
+  return range_deletions;
+}
+
+// Visit the nodes with keys in [lower, upper] in key order, or from the
+// highest key down, until visit returns false
+void Tree::walk(uint64_t lower, uint64_t upper, bool reverse,
+                const function<bool(Node_t *)> &visit) {
   stack<Node_t *> s;
   Node_t *curr = root;
   while (curr != &NIL || !s.empty()) {
-    while (curr != &NIL && curr->key >= lower) {
-      if (curr->key <= upper) {
+    while (curr != &NIL) {
+      if (reverse ? curr->key > upper : curr->key < lower) {
+        curr = reverse ? curr->left : curr->right;
+        continue;
+      }
+      if (reverse ? curr->key >= lower : curr->key <= upper) {
         s.push(curr);
       }
-      curr = curr->left;
+      curr = reverse ? curr->right : curr->left;
     }
     if (s.empty()) break;
     curr = s.top();
     s.pop();
-    if (curr->value != TOMBSTONE) {
-      output.push_back({.key = curr->key, .value = curr->value});
-    }
-    curr = curr->right;
+    if (!visit(curr)) break;
+    curr = reverse ? curr->left : curr->right;
   }
+}
+
+// The newest value of up to limit keys in [lower, upper], deleted keys left
+// out but counted
+vector<KVPair> Tree::scan(uint64_t lower, uint64_t upper, size_t limit,
+                          bool reverse) {
+  vector<KVPair> output;
+  size_t keys = 0;
+  walk(lower, upper, reverse, [&](Node_t *node) {
+    if (keys++ == limit) {
+      return false;
+    }
+    if (node->value != TOMBSTONE) {
+      output.push_back({node->key, node->value, node->seq});
+    }
+    return true;
+  });
+  return output;
+}
+
+// Every write to up to limit keys in [lower, upper], overwritten ones and
+// deletes included, ordered by key, descending if reverse, and newest first
+vector<KVPair> Tree::versions(uint64_t lower, uint64_t upper, size_t limit,
+                              bool reverse) {
+  vector<KVPair> output;
+  size_t keys = 0;
+  walk(lower, upper, reverse, [&](Node_t *node) {
+    if (keys++ == limit) {
+      return false;
+    }
+    output.push_back({node->key, node->value, node->seq});
+    output.insert(output.end(), node->older.begin(), node->older.end());
+    return true;
+  });
   return output;
 }
+
+size_t Tree::size() { return num_nodes; }
+
+int Tree::height() { return root->height; }
+
+size_t Tree::memory_usage() {
+  return sizeof(Tree) + num_nodes * sizeof(Node_t) + num_older * sizeof(KVPair) +
+         range_deletions.size() * sizeof(RangeTombstone);
+}
@@ -2,16 +2,21 @@
 #define _TREE_H
 
 #include <cstdint>
+#include <functional>
 #include <vector>
 #include "kvpair.h"
 
 using namespace std;
 
+const int MAX_HEIGHT = 64; // Above the height of an AVL tree of 2^32 nodes
+
 class Tree {
 private:
   struct Node {
     uint64_t key;
     uint64_t value;
+    uint64_t seq;
+    vector<KVPair> older; // Overwritten writes to the key, newest first
     Node *left;
     Node *right;
     int height;
@@ -19,10 +24,16 @@ private:
   typedef Node Node_t;
 
   Node_t *root;
+  Node_t *max_node; // The node of the highest key
   unsigned int ttl;
+  size_t num_nodes;
+  size_t num_older;
+  vector<RangeTombstone> range_deletions; // Oldest first
 
-  Node_t *Node(uint64_t, uint64_t);
-  Node_t *insert(Node_t*, uint64_t, uint64_t);
+  Node_t *Node(uint64_t, uint64_t, uint64_t);
+  Node_t *insert(Node_t*, uint64_t, uint64_t, uint64_t);
+  void append(uint64_t, uint64_t, uint64_t);
+  Node_t *find_node(uint64_t);
   Node_t *rebalance_left(Node_t*);
   Node_t *rebalance_right(Node_t*);
   Node_t *rotate_left(Node_t*);
@@ -31,13 +42,26 @@ private:
   static Node_t NIL;
 
   void DestructorRec(Node_t*);
+  void walk(uint64_t, uint64_t, bool, const function<bool(Node_t *)> &);
 
 public:
   Tree(unsigned int);
   ~Tree();
-  bool put(uint64_t, uint64_t); // returns false when ttl reaches 0
+  bool put(uint64_t, uint64_t, uint64_t seq = 0); // returns false when ttl reaches 0
   uint64_t get(uint64_t);
-  vector<KVPair> scan(uint64_t, uint64_t);
+  bool find(uint64_t key, uint64_t snapshot, uint64_t *value,
+            uint64_t *seq = NULL);
+  bool delete_range(uint64_t start, uint64_t end, uint64_t seq); // returns false when ttl reaches 0
+  uint64_t deleted_at(uint64_t key, uint64_t snapshot);
+  const vector<RangeTombstone> &range_tombstones();
+  // limit counts keys, and reverse walks them from the highest down
+  vector<KVPair> scan(uint64_t, uint64_t, size_t limit = SIZE_MAX,
+                      bool reverse = false);
+  vector<KVPair> versions(uint64_t, uint64_t, size_t limit = SIZE_MAX,
+                          bool reverse = false);
+  size_t size(); // Number of distinct keys
+  int height(); // Of the root, which a single key has at 0
+  size_t memory_usage();
 };
 
 
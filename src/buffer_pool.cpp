@@ -1,5 +1,7 @@
 #include "buffer_pool.h"
 
+#include <string.h>
+
 #include <string>
 
 #include "exceptions.h"
@@ -8,12 +10,14 @@ using namespace std;
 
 shared_ptr<BufferPool::LLNode_t> BufferPool::LLNode(string filename,
                                                     int page_number,
-                                                    KVPair* page) {
+                                                    KVPair* page,
+                                                    size_t bytes) {
   auto node = make_shared<BufferPool::LLNode_t>();
   node->page = page;
   node->next = NULL;
   node->filename = filename;
   node->page_number = page_number;
+  node->bytes = bytes;
 
   return node;
 }
@@ -27,12 +31,15 @@ shared_ptr<BufferPool::Bucket_t> BufferPool::Bucket() {
 }
 
 BufferPool::BufferPool(int initial_size, int max_size, double extend_threshold,
-                       int policy) {
+                       int policy, size_t budget_bytes) {
   this->extend_threshold = extend_threshold;
   this->initial_capacity = initial_size;
   this->max_capacity = max_size;
   this->curr_capacity = initial_size;
   this->num_pages = 0;
+  this->budget_bytes =
+      budget_bytes == 0 ? (size_t)max_size * BP_PAGE_BYTES : budget_bytes;
+  this->used_bytes = 0;
 
   directory.resize(initial_size);
   for (int i = 0; i < initial_size; i++) {
@@ -50,20 +57,38 @@ BufferPool::BufferPool(int initial_size, int max_size, double extend_threshold,
   }
 }
 
-KVPair* BufferPool::get(string filename, int page_number) {
-  int bucket_num = hash(filename, page_number);
-  auto bucket = directory[bucket_num];
-  auto curr = bucket->head;
+KVPair* BufferPool::get(string filename, int page_number, int hint) {
+  lock_guard<mutex> guard(latch);
+  return access(filename, page_number, hint);
+}
 
-  KVPair* page = NULL;
+// Copy a cached page into dest, which must hold a whole page, and return the
+// bytes copied, or 0 if the page isn't cached. Unlike get, the copy stays valid
+// when another thread evicts the page.
+size_t BufferPool::get_copy(string filename, int page_number, KVPair* dest,
+                            int hint) {
+  lock_guard<mutex> guard(latch);
+  KVPair* page = access(filename, page_number, hint);
+  if (page == NULL) {
+    return 0;
+  }
+  size_t bytes = resident[page]->bytes;
+  memcpy(dest, page, bytes);
+  return bytes;
+}
 
-  while (curr != NULL) {
-    if (curr->page_number == page_number && curr->filename == filename) {
-      page = curr->page;
-      int page_added = this->replacer->record_access(page);
-      break;
-    }
-    curr = curr->next;
+KVPair* BufferPool::access(string filename, int page_number, int hint) {
+  // Continue a pending shrink before the lookup so the page we hand out can't
+  // be evicted by it
+  if (is_resizing()) {
+    evict_some(RESIZE_STEP_PAGES);
+  }
+
+  int bucket_num = hash(filename, page_number);
+  auto bucket = directory[bucket_num];
+  KVPair* page = find(filename, page_number);
+  if (page != NULL && hint != BP_BYPASS) {
+    this->replacer->record_access(page);
   }
 
   // Opportunistically check if we can rehash (multiple prefixes map to this
@@ -76,24 +101,64 @@ KVPair* BufferPool::get(string filename, int page_number) {
   return page;
 }
 
-void BufferPool::put(string filename, int page_number, KVPair* page) {
-  int bucket_num = hash(filename, page_number);
-  auto bucket = directory[bucket_num];
-  auto new_node = BufferPool::LLNode(filename, page_number, page);
-
-  if (this->curr_capacity == this->max_capacity &&
-      this->num_pages >= this->curr_capacity) {
-    // TODO: Evict a page
-    struct KVPair* page_to_evict = new KVPair;
-    if (this->replacer->evict(page_to_evict) == 1) {
-      remove_from_bucket(bucket, page_to_evict);
+// Cache a page, evicting others if it doesn't fit in the budget. The pool owns
+// the page from now on; if the page is already cached the copy is freed.
+void BufferPool::put(string filename, int page_number, KVPair* page,
+                     size_t bytes, int hint) {
+  lock_guard<mutex> guard(latch);
+  if (find(filename, page_number) != NULL) {
+    free(page);
+    return;
+  }
+  // Make room before the page is linked in so it can't be chosen as a victim.
+  // This also continues a pending shrink.
+  while (this->used_bytes + bytes > this->budget_bytes && evict_one()) {
+  }
+  insert(filename, page_number, page, bytes, hint);
+}
+
+// Cache a page at the cold end only if it fits without evicting anything.
+// Return false, leaving the page to the caller, if there is no room.
+bool BufferPool::put_if_room(string filename, int page_number, KVPair* page,
+                             size_t bytes) {
+  lock_guard<mutex> guard(latch);
+  if (find(filename, page_number) != NULL) {
+    free(page);
+    return true;
+  }
+  if (this->used_bytes + bytes > this->budget_bytes) {
+    return false;
+  }
+  insert(filename, page_number, page, bytes, BP_COLD);
+  return true;
+}
+
+KVPair* BufferPool::find(string filename, int page_number) {
+  auto curr = directory[hash(filename, page_number)]->head;
+  while (curr != NULL) {
+    if (curr->page_number == page_number && curr->filename == filename) {
+      return curr->page;
     }
-    delete page_to_evict;
-  } else {
-    this->num_pages++;
+    curr = curr->next;
   }
+  return NULL;
+}
+
+void BufferPool::insert(string filename, int page_number, KVPair* page,
+                        size_t bytes, int hint) {
+  int bucket_num = hash(filename, page_number);
+  auto bucket = directory[bucket_num];
+  auto new_node = BufferPool::LLNode(filename, page_number, page, bytes);
 
   append_to_bucket(bucket, new_node);
+  this->resident[page] = new_node;
+  if (hint == BP_COLD) {
+    this->replacer->record_cold(page);
+  } else {
+    this->replacer->record_access(page);
+  }
+  this->used_bytes += bytes;
+  this->num_pages++;
 
   if (this->curr_capacity < this->max_capacity &&
       this->num_pages >= (this->curr_capacity * this->extend_threshold)) {
@@ -107,14 +172,43 @@ void BufferPool::put(string filename, int page_number, KVPair* page) {
   }
 }
 
+// Evict the replacer's victim and free it. Return false if there was nothing
+// to evict.
+bool BufferPool::evict_one() {
+  KVPair* victim = NULL;
+  if (this->replacer->evict(victim) != 1) {
+    return false;
+  }
+  auto it = this->resident.find(victim);
+  if (it == this->resident.end()) {
+    return true;
+  }
+  auto node = it->second;
+  remove_from_bucket(directory[hash(node->filename, node->page_number)],
+                     victim);
+  this->resident.erase(it);
+  this->used_bytes -= node->bytes;
+  this->num_pages--;
+  free(victim);
+  return true;
+}
+
 void BufferPool::remove_from_bucket(shared_ptr<BufferPool::Bucket_t> bucket,
                                     KVPair* evicted_page) {
+  if (bucket->head == NULL) {
+    return;
+  }
+  if (bucket->head->page == evicted_page) {
+    bucket->head = bucket->head->next;
+    return;
+  }
   auto curr = bucket->head;
-  while (1) {
+  while (curr->next != NULL) {
     if (curr->next->page == evicted_page) {
       curr->next = curr->next->next;
       return;
     }
+    curr = curr->next;
   }
 }
 
@@ -149,44 +243,94 @@ void BufferPool::extend() {
   }
 }
 
+// Change the number of directory buckets. Growing only raises the limit the
+// directory may extend to. Shrinking relinks the resident pages into a smaller
+// directory and lowers the byte budget to one page per bucket.
 void BufferPool::resize(int new_capacity) {
+  lock_guard<mutex> guard(latch);
   if (new_capacity >= this->curr_capacity) {
     this->max_capacity = new_capacity;
+    return;
   }
-  // Shrink in this case
-  else {
-    // Evict all the pages in the buckets that are going to be removed
-    for (int i = this->curr_capacity - 1; i >= new_capacity; i--) {
-      auto bucket = directory[i];
-      auto curr = bucket->head;
-
-      while (curr != NULL) {
-        replacer->evict(curr->page);
-        curr = curr->next;
-      }
-    }
-    this->curr_capacity = new_capacity;
-    this->max_capacity = new_capacity;
-    auto old_directory = this->directory;
 
-    // Make new directory
-    this->directory = std::vector<std::shared_ptr<Bucket_t>>(new_capacity);
-    for (int i = 0; i < new_capacity; i++) {
-      directory[i] = BufferPool::Bucket();
-      directory[i]->ref_count = 1;
+  this->curr_capacity = new_capacity;
+  this->max_capacity = new_capacity;
+  this->directory = std::vector<std::shared_ptr<Bucket_t>>(new_capacity);
+  for (int i = 0; i < new_capacity; i++) {
+    directory[i] = BufferPool::Bucket();
+    directory[i]->ref_count = 1;
+  }
+  for (auto& entry : this->resident) {
+    auto node = entry.second;
+    node->next = NULL;
+    append_to_bucket(directory[hash(node->filename, node->page_number)], node);
+  }
+
+  size_t bucket_bytes = (size_t)new_capacity * BP_PAGE_BYTES;
+  if (bucket_bytes < this->budget_bytes) {
+    set_budget(bucket_bytes);
+  }
+}
+
+// Change the byte budget without blocking the caller. Growing takes effect
+// immediately. Shrinking evicts one batch of pages now and leaves the rest to
+// later gets and puts (or explicit shrink_step calls), a batch at a time.
+void BufferPool::resize_bytes(size_t new_budget) {
+  lock_guard<mutex> guard(latch);
+  set_budget(new_budget);
+}
+
+void BufferPool::set_budget(size_t new_budget) {
+  this->budget_bytes = new_budget;
+  int needed_capacity = directory_capacity_for(new_budget);
+  if (needed_capacity > this->max_capacity) {
+    this->max_capacity = needed_capacity;
+  }
+  evict_some(RESIZE_STEP_PAGES);
+}
+
+// Evict up to max_pages pages while the pool is over budget. Return true if
+// the pool is still over budget afterwards.
+bool BufferPool::shrink_step(int max_pages) {
+  lock_guard<mutex> guard(latch);
+  return evict_some(max_pages);
+}
+
+bool BufferPool::evict_some(int max_pages) {
+  for (int i = 0; i < max_pages && is_resizing(); i++) {
+    if (!evict_one()) {
+      break;
     }
+  }
+  return is_resizing();
+}
+
+bool BufferPool::is_resizing() { return this->used_bytes > this->budget_bytes; }
+
+// Bytes held by the pool: cached pages plus the directory and list nodes that
+// index them
+size_t BufferPool::memory_usage() {
+  lock_guard<mutex> guard(latch);
+  size_t bytes = this->used_bytes;
+  bytes += this->directory.capacity() * sizeof(shared_ptr<Bucket_t>);
+  bytes += this->curr_capacity * sizeof(Bucket_t);
+  for (auto& entry : this->resident) {
+    bytes += sizeof(LLNode_t) + entry.second->filename.capacity();
+  }
+  return bytes;
+}
 
-    // Rehash all the remaining pages
-    this->num_pages = 0;
-    for (int i = 0; i < new_capacity; i++) {
-      auto old_bucket = old_directory[i];
-      auto curr = old_bucket->head;
-      while (curr != NULL) {
-        put(curr->filename, curr->page_number, curr->page);
-        curr = curr->next;
-      }
+// (filename, page number) of every cached page, hottest first
+vector<pair<string, int>> BufferPool::resident_by_hotness() {
+  lock_guard<mutex> guard(latch);
+  vector<pair<string, int>> pages;
+  for (KVPair* page : this->replacer->pages_by_hotness()) {
+    auto it = this->resident.find(page);
+    if (it != this->resident.end()) {
+      pages.push_back(make_pair(it->second->filename, it->second->page_number));
     }
   }
+  return pages;
 }
 
 void BufferPool::rehash(int orig_bucket_num) {
@@ -218,23 +362,26 @@ void BufferPool::rehash(int orig_bucket_num) {
 BufferPool::~BufferPool() { prepare_destroy(); }
 
 void BufferPool::prepare_destroy() {
-  // Put pages in vector to avoid problem freeing a page in multiple buckets
-  vector<KVPair*> pages;
+  lock_guard<mutex> guard(latch);
+  // Free through the resident map since a bucket can be shared by several
+  // directory entries
+  for (auto& entry : this->resident) {
+    free(entry.first);
+  }
+  this->resident.clear();
   for (auto& bucket : directory) {
-    auto curr = bucket->head;
-    if (bucket->ref_count > 0) {
-      while (curr != NULL) {
-        pages.push_back(curr->page);
-        curr = curr->next;
-      }
-      bucket->ref_count = 0;
-    }
+    bucket->head = NULL;
   }
+  this->num_pages = 0;
+  this->used_bytes = 0;
+}
 
-  for (auto& page : pages) {
-    if (page) {
-      free(page);
-      page = NULL;
-    }
+// Smallest power of 2 number of buckets that gives every page in the budget a
+// bucket of its own
+int directory_capacity_for(size_t budget_bytes) {
+  int capacity = 1;
+  while ((size_t)capacity * BP_PAGE_BYTES < budget_bytes) {
+    capacity <<= 1;
   }
-}
\ No newline at end of file
+  return capacity;
+}
@@ -3,7 +3,9 @@
 
 #include <string>
 #include <vector>
-#include <memory> 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include "kvpair.h"
 #include "replacer.h"
 #include "clock_replacer.h"
@@ -12,20 +14,29 @@
 const double DEFAULT_EXTEND_THRESHOLD = 0.9;
 const int DEFAULT_INITIAL_CAPACITY = 32;
 const int DEFAULT_MAX_CAPACITY = 64;
+const size_t BP_PAGE_BYTES = 4096; // Bytes charged for a page when the caller doesn't say
+const size_t DEFAULT_BUFFER_POOL_BYTES = DEFAULT_MAX_CAPACITY * BP_PAGE_BYTES;
+const int RESIZE_STEP_PAGES = 8; // Pages evicted per get/put while shrinking to a new budget
+
+// How a read should treat the buffer pool
+#define BP_FILL 0   // Cache the page as recently used (point lookups)
+#define BP_COLD 1   // Cache the page at the cold end so it is evicted first unless reused (scans)
+#define BP_BYPASS 2 // Use a cached copy if there is one, but never cache or promote (compaction)
 
 struct BufferPool {
   struct LLNode {
     KVPair* page;
     std::string filename;
     int page_number;
+    size_t bytes; // Bytes charged against the budget for this page
     std::shared_ptr<LLNode> next;
   };
   typedef LLNode LLNode_t;
-  std::shared_ptr<LLNode_t> LLNode(std::string, int, KVPair*);
+  std::shared_ptr<LLNode_t> LLNode(std::string, int, KVPair*, size_t);
 
   struct Bucket {
     std::shared_ptr<LLNode_t> head;
-    int ref_count; // Number of hash prefixes that point to this bucket (after expansion but before rehash) 
+    int ref_count; // Number of hash prefixes that point to this bucket (after expansion but before rehash)
   };
   typedef Bucket Bucket_t;
   std::shared_ptr<Bucket_t> Bucket();
@@ -34,8 +45,20 @@ struct BufferPool {
 
   void extend();
   void resize(int);
+  void resize_bytes(size_t);
+  bool shrink_step(int);
+  bool is_resizing();
+  size_t memory_usage();
+  std::vector<std::pair<std::string, int>> resident_by_hotness();
   void prepare_destroy();
 
+  // Unlocked helpers; callers hold latch
+  void insert(std::string, int, KVPair*, size_t, int);
+  KVPair* find(std::string, int);
+  KVPair* access(std::string, int, int);
+  void set_budget(size_t);
+  bool evict_some(int);
+  bool evict_one();
   void append_to_bucket(std::shared_ptr<Bucket_t>, std::shared_ptr<LLNode_t>);
   void remove_from_bucket(std::shared_ptr<Bucket_t>, KVPair*);
 
@@ -45,14 +68,26 @@ struct BufferPool {
   int max_capacity;
   int curr_capacity;
   int num_pages;
+  size_t budget_bytes; // Resident pages are evicted until they fit in this many bytes
+  size_t used_bytes; // Bytes of pages currently resident
+  std::unordered_map<KVPair*, std::shared_ptr<LLNode_t>> resident; // Locates the node of a page chosen by the replacer
   std::unique_ptr<Replacer> replacer;
-  
+  std::mutex latch; // Lets prefetch threads fill the pool while requests use it
+
   BufferPool(int initial = DEFAULT_INITIAL_CAPACITY, int max = DEFAULT_MAX_CAPACITY,
-   double extend_threshold = DEFAULT_EXTEND_THRESHOLD, int policy = CLOCK);
+   double extend_threshold = DEFAULT_EXTEND_THRESHOLD, int policy = CLOCK,
+   size_t budget_bytes = 0); // A budget of 0 allows one page per bucket of max
   ~BufferPool();
-  KVPair* get(std::string filename, int page_number);
-  void put(std::string filename, int page_number, KVPair* page);
+  KVPair* get(std::string filename, int page_number, int hint = BP_FILL);
+  size_t get_copy(std::string filename, int page_number, KVPair* dest,
+   int hint = BP_FILL);
+  void put(std::string filename, int page_number, KVPair* page,
+   size_t bytes = BP_PAGE_BYTES, int hint = BP_FILL);
+  bool put_if_room(std::string filename, int page_number, KVPair* page,
+   size_t bytes = BP_PAGE_BYTES);
   int hash(std::string filename, int page_number);
 };
 
-#endif
\ No newline at end of file
+int directory_capacity_for(size_t budget_bytes);
+
+#endif
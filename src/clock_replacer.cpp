@@ -18,7 +18,7 @@ ClockReplacer::ClockReplacer() {
   this->size = 0;
 }
 
-int ClockReplacer::evict(KVPair *page) {
+int ClockReplacer::evict(KVPair *&page) {
   if (this->size == 0) {
     return 0;
   }
@@ -39,6 +39,7 @@ int ClockReplacer::evict(KVPair *page) {
         curr->prev->next = curr->next;
       }
     } else {
+      curr->access_bit = 0;  // Second chance
       curr = curr->next;
       if (curr == NULL) {
         curr = this->head;
@@ -51,6 +52,7 @@ int ClockReplacer::evict(KVPair *page) {
 int ClockReplacer::record_access(KVPair *page) {
   if (this->size == 0) {
     auto new_node = ClockReplacer::Node(page);
+    new_node->access_bit = 1;
     new_node->next = NULL;
     new_node->prev = NULL;
     this->head = new_node;
@@ -70,6 +72,7 @@ int ClockReplacer::record_access(KVPair *page) {
   }
 
   auto new_node = ClockReplacer::Node(page);
+  new_node->access_bit = 1;
   new_node->prev = NULL;
   new_node->next = this->head;
   new_node->next->prev = new_node;
@@ -77,3 +80,41 @@ int ClockReplacer::record_access(KVPair *page) {
   this->size += 1;
   return 1;
 }
+
+int ClockReplacer::record_cold(KVPair *page) {
+  auto curr = this->head;
+  for (int i = 0; i < this->size; i++) {
+    if (curr->page == page) {
+      return 0;
+    }
+    curr = curr->next;
+  }
+
+  // The hand starts at the head, so an unreferenced page there goes first
+  auto new_node = ClockReplacer::Node(page);
+  new_node->next = this->head;
+  if (this->head != NULL) {
+    this->head->prev = new_node;
+  }
+  this->head = new_node;
+  this->size += 1;
+  return 1;
+}
+
+// Referenced pages survive the next sweep of the hand, so they come first.
+// Within each group, pages nearer the tail are reached by the hand last.
+vector<KVPair *> ClockReplacer::pages_by_hotness() {
+  vector<KVPair *> referenced, unreferenced;
+  auto curr = this->head;
+  for (int i = 0; i < this->size; i++) {
+    if (curr->access_bit == 1) {
+      referenced.push_back(curr->page);
+    } else {
+      unreferenced.push_back(curr->page);
+    }
+    curr = curr->next;
+  }
+  vector<KVPair *> pages(referenced.rbegin(), referenced.rend());
+  pages.insert(pages.end(), unreferenced.rbegin(), unreferenced.rend());
+  return pages;
+}
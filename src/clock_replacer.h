@@ -21,8 +21,10 @@ struct ClockReplacer : Replacer {
 
   std::shared_ptr<Node_t> Node(KVPair *page);
   ClockReplacer();
-  int evict(KVPair *page);
+  int evict(KVPair *&page);
   int record_access(KVPair *page);
+  int record_cold(KVPair *page);
+  std::vector<KVPair *> pages_by_hotness();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -13,14 +13,29 @@
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <map>
+#include <queue>
+#include <sstream>
 
 #include "exceptions.h"
+#include "perf_context.h"
 
 using namespace std;
 
-bool is_file_exists(string fileName);
+uint64_t count_deletions(const vector<KVPair>&);
+size_t count_keys(const vector<KVPair>&);
+uint64_t file_size(string);
+bool sync_directory(string);
+bool ingestible(const string&, FileMeta*);
+const vector<PageSummary>& page_summaries(SSTFile&);
+bool summary_usable(const PageSummary&, const SSTFile&, const Version&,
+                    const vector<uint64_t>&, const vector<RangeTombstone>&,
+                    uint64_t);
+bool page_skippable(const vector<PageSummary>&, size_t, const Version&, size_t,
+                    const vector<uint64_t>&);
 
-bool DB::open(string db_name, int memtable_size, int bp_policy) {
+bool DB::open(string db_name, int memtable_size, int bp_policy,
+              size_t bp_bytes, size_t row_cache_bytes) {
   if (!this->name.empty()) {
     fprintf(stderr, "ERROR: DB %s is already open. Close this DB first.\n",
             this->name.c_str());
@@ -31,37 +46,19 @@ bool DB::open(string db_name, int memtable_size, int bp_policy) {
 
   // Check for existing database
   if (fd_db >= 0) {
-    // Read metadata
-    int fd_metadata = ::openat(fd_db, METADATA_FILE.c_str(),
-                               O_RDONLY | O_DIRECT, FILE_PERMISSIONS);
-    if (fd_metadata >= 0) {
-      Metadata* buff;
-      int buff_size = round_up_block_size(sizeof(Metadata));
-      int ret = posix_memalign((void**)&buff, BLOCK_SIZE, buff_size);
-      if (ret == -1) {
-        perror("posix_memalign");
-      }
-      // Assumption: Metadata struct fits inside a single block in the file
-      ret = pread(fd_metadata, buff, buff_size, 0);
-      if (ret == -1) {
-        perror("pread");
-      }
-      metadata.memtable_size = buff->memtable_size;
-      metadata.next_sst_id = buff->next_sst_id;
-      metadata.num_elems = buff->num_elems;
-      free(buff);
-      ::close(fd_metadata);
-    } else {
-      fprintf(stderr, "ERROR: Could not open %s file in database %s. %s\n",
-              METADATA_FILE.c_str(), db_name.c_str(), strerror(errno));
-      ::close(fd_db);
+    bool opened = manifest_exists(db_name) ? manifest.recover(db_name)
+                                           : import_legacy_db(db_name, fd_db);
+    ::close(fd_db);
+    if (!opened) {
       return false;
     }
-
-    DIR* db_dir = fdopendir(fd_db);
-    reopen_ssts_by_age(db_name, db_dir);
-    closedir(db_dir);  // This will also close the file descriptor fd_db
-  } else {             // Otherwise make new database
+    name = db_name;
+    if (!upgrade_ssts()) {
+      name = "";
+      return false;
+    }
+    metadata = manifest.metadata;
+  } else {  // Otherwise make new database
     int ret = mkdir(db_name.c_str(), DIR_PERMISSIONS);
     if (ret == -1) {
       fprintf(stderr, "ERROR: Could not create database %s. %s\n",
@@ -71,81 +68,621 @@ bool DB::open(string db_name, int memtable_size, int bp_policy) {
     metadata.memtable_size = memtable_size;
     metadata.next_sst_id = 0;
     metadata.num_elems = 0;
+    metadata.last_sequence = 0;
+    if (!manifest.create(db_name, metadata)) {
+      return false;
+    }
   }
 
   name = db_name;
-  memtable = new Tree(metadata.memtable_size);
-  buffer_pool = new BufferPool(DEFAULT_INITIAL_CAPACITY, DEFAULT_MAX_CAPACITY,
-                               DEFAULT_EXTEND_THRESHOLD, bp_policy);
+  current = make_shared<Version>();
+  current->memtable = make_shared<Tree>(metadata.memtable_size);
+  for (auto& entry : manifest.files) {
+    current->files.push_back(
+        make_shared<SSTFile>(entry.second, sst_path(entry.first)));
+  }
+  // Files are numbered as they are written, but ingested files may sit below
+  // older ones. By their newest write both come out oldest first.
+  stable_sort(current->files.begin(), current->files.end(),
+              [](const shared_ptr<SSTFile>& a, const shared_ptr<SSTFile>& b) {
+                return a->meta.max_sequence < b->meta.max_sequence;
+              });
+  for (auto& file : current->files) {
+    sst_names.push_back(file->path);
+  }
+  current->range_tombstones = manifest.range_tombstones;
+  delete_unlisted_ssts();
+  int max_capacity = directory_capacity_for(bp_bytes);
+  buffer_pool = new BufferPool(min(DEFAULT_INITIAL_CAPACITY, max_capacity),
+                               max_capacity, DEFAULT_EXTEND_THRESHOLD,
+                               bp_policy, bp_bytes);
+  row_cache = row_cache_bytes > 0 ? new RowCache(row_cache_bytes) : NULL;
+  statistics = new Statistics();
+  io_service = new IOService(DEFAULT_IO_THREADS);
+  start_prefetch();
   return true;
 }
 
 bool DB::close() {
+  stop_prefetch = true;
+  wait_for_prefetch();
+  end_trace();
+  if (compaction_thread.joinable()) {
+    compaction_thread.join();
+  }
+
   // Write memtable to disk before closing
-  vector<KVPair> kvpairs = memtable->scan(MIN_KEY, MAX_KEY);
-  if (kvpairs.size() > 0) {
-    string sst_name = get_sst_filename();
-    write_sst(kvpairs, sst_name);
-    sst_names.push_back(sst_name);
+  bool flushed = flush_memtable();
+  manifest.metadata = metadata;
+  bool checkpointed = manifest.checkpoint() && flushed;
+  manifest.close();
+  save_buffer_pool_state();
+  this->name = "";
+  this->sst_names.clear();
+  this->current = NULL;
+  this->snapshots.clear();
+  this->buffer_pool->prepare_destroy();
+  delete (this->buffer_pool);
+  delete (this->row_cache);
+  delete (this->statistics);
+  delete (this->io_service);
+
+  return checkpointed;
+}
+
+void DB::put(uint64_t key, uint64_t value) {
+  StopWatch timer(statistics, DB_PUT);
+  trace(TRACE_PUT, key, value);
+  write(key, value);
+}
+
+void DB::del(uint64_t key) {
+  StopWatch timer(statistics, DB_DELETE);
+  trace(TRACE_DEL, key, 0);
+  write(key, TOMBSTONE);
+}
+
+// One range tombstone instead of a tombstone per key. It is kept in the
+// memtable and then the manifest until a compaction has dropped the writes it
+// deletes.
+void DB::del_range(uint64_t key1, uint64_t key2) {
+  StopWatch timer(statistics, DB_DELETE);
+  trace(TRACE_DEL_RANGE, key1, key2);
+  if (key1 <= key2) {
+    write(key1, key2, WRITE_RANGE_DELETE);
+  }
+}
+
+// Nothing is read: the operand is written like a value and merged into the
+// older writes to the key when it is read or compacted
+void DB::merge(uint64_t key, uint64_t operand) {
+  StopWatch timer(statistics, DB_MERGE);
+  trace(TRACE_MERGE, key, operand);
+  write(key, operand, WRITE_OPERAND);
+}
+
+void DB::write_batch(const vector<KVPair>& kvpairs) {
+  if (kvpairs.empty()) {
+    return;
+  }
+  vector<Writer> group(kvpairs.size());
+  for (size_t i = 0; i < kvpairs.size(); i++) {
+    bool deletion = kvpairs[i].value == TOMBSTONE;
+    trace(deletion ? TRACE_DEL : TRACE_PUT, kvpairs[i].key,
+          deletion ? 0 : kvpairs[i].value);
+    group[i].key = kvpairs[i].key;
+    group[i].value = kvpairs[i].value;
+  }
+  write(group.data(), group.size());
+}
+
+void DB::write(uint64_t key, uint64_t value, int type) {
+  Writer self;
+  self.key = key;
+  self.value = value;
+  self.type = type;
+  write(&self, 1);
+}
+
+// Queue a group of writes and wait until they are applied. The writer at the
+// front of the queue becomes the leader: its thread applies it together with
+// the ones queued behind it, then wakes their threads and hands over to the
+// next. A group's writes stay next to each other in the queue, so its thread
+// may lead several times in a row.
+void DB::write(Writer* group, size_t n) {
+  condition_variable cv;
+  unique_lock<mutex> lock(writers_lock);
+  for (size_t i = 0; i < n; i++) {
+    group[i].cv = &cv;
+    writers.push_back(&group[i]);
+  }
+  while (!group[n - 1].done) {
+    if (writers.front()->cv != &cv) {
+      cv.wait(lock);
+      continue;
+    }
+
+    vector<Writer*> batch(writers.begin(),
+                          writers.begin() + min(writers.size(), MAX_WRITE_BATCH));
+    lock.unlock();
+    apply_batch(batch);
+    lock.lock();
+
+    for (size_t i = 0; i < batch.size(); i++) {
+      Writer* writer = writers.front();
+      writers.pop_front();
+      writer->done = true;
+      if (writer->cv != &cv) {
+        writer->cv->notify_one();
+      }
+    }
+    if (!writers.empty()) {
+      writers.front()->cv->notify_one();
+    }
   }
-  int fd_db = ::open(name.c_str(), O_RDONLY | O_DIRECTORY, DIR_PERMISSIONS);
-  if (fd_db < 0) {
-    fprintf(stderr, "ERROR: Could not open database %s. %s\n", name.c_str(),
-            strerror(errno));
+}
+
+// Only the leader runs this, so it is the only thread changing the memtable
+// and the only one flushing
+void DB::apply_batch(const vector<Writer*>& batch) {
+  size_t i = 0;
+  while (i < batch.size()) {
+    size_t first = i;
+    bool full = false;
+    // A compaction may install a Version at any time, but only a flush
+    // replaces the memtable
+    shared_ptr<Tree> memtable = acquire_version()->memtable;
+    {
+      unique_lock<shared_mutex> guard(memtable_lock);
+      for (; i < batch.size() && !full; i++) {
+        if (batch[i]->type == WRITE_INGEST) {
+          break;
+        }
+        uint64_t seq = ++metadata.last_sequence;
+        if (batch[i]->type == WRITE_RANGE_DELETE) {
+          full = !memtable->delete_range(batch[i]->key, batch[i]->value, seq);
+          continue;
+        }
+        if (batch[i]->type == WRITE_OPERAND) {
+          seq |= MERGE_OPERAND;
+        }
+        full = !memtable->put(batch[i]->key, batch[i]->value, seq);
+      }
+    }
+    // Lookups check the memtable's range tombstones before the row cache, so
+    // the rows they delete can wait for the flush to be dropped
+    if (row_cache != NULL) {
+      for (size_t j = first; j < i; j++) {
+        if (batch[j]->type != WRITE_RANGE_DELETE) {
+          row_cache->erase(batch[j]->key);
+        }
+      }
+    }
+    if (full) {
+      flush_memtable();
+      maybe_schedule_compaction();
+    }
+    // Ingesting may flush, so it runs between the batch's other writes
+    if (i < batch.size() && batch[i]->type == WRITE_INGEST) {
+      batch[i]->ingested = ingest(*batch[i]->files, *batch[i]->file_metas);
+      maybe_schedule_compaction();
+      i++;
+    }
+  }
+  statistics->add(USER_BYTES_WRITTEN, batch.size() * KV_BYTES);
+}
+
+// The files are checked from their page summaries before queueing, so the
+// other writers only wait for the ones that have to be rewritten
+bool DB::ingest_files(const vector<string>& paths) {
+  StopWatch timer(statistics, DB_INGEST);
+  vector<FileMeta> file_metas(paths.size());
+  for (size_t i = 0; i < paths.size(); i++) {
+    if (!ingestible(paths[i], &file_metas[i])) {
+      return false;
+    }
+  }
+  vector<size_t> order(paths.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return file_metas[a].min_key < file_metas[b].min_key;
+  });
+  for (size_t i = 1; i < order.size(); i++) {
+    if (file_metas[order[i]].min_key <= file_metas[order[i - 1]].max_key) {
+      fprintf(stderr, "ERROR: Ingested SSTs overlap\n");
+      return false;
+    }
+  }
+
+  Writer self;
+  self.type = WRITE_INGEST;
+  self.files = &paths;
+  self.file_metas = &file_metas;
+  write(&self, 1);
+  return self.ingested;
+}
+
+// Add the files in one manifest edit. Only the leader runs this. A file whose
+// key range no write touches yet, while no snapshot is open, is linked into
+// the database as it is, at level 1 below every other file: its pairs keep
+// sequence 0 since nothing they could be read against is older. Any other
+// file is rewritten with the next sequence number and added at level 0 like
+// a flush, after flushing the memtable if that holds its keys.
+bool DB::ingest(const vector<string>& paths,
+                const vector<FileMeta>& file_metas) {
+  // Reads stop at the memtable's writes and range tombstones, which the
+  // files' pairs must override
+  bool flush = false;
+  {
+    shared_ptr<Tree> memtable = acquire_version()->memtable;
+    shared_lock<shared_mutex> guard(memtable_lock);
+    for (auto& meta : file_metas) {
+      uint64_t min_key = meta.min_key;
+      uint64_t max_key = meta.max_key;
+      flush |= !memtable->versions(min_key, max_key, 1).empty();
+      for (auto& tombstone : memtable->range_tombstones()) {
+        flush |= min_key <= tombstone.end && tombstone.start <= max_key;
+      }
+    }
+  }
+  if (flush && !flush_memtable()) {
     return false;
   }
-  int fd_metadata = ::openat(fd_db, METADATA_FILE.c_str(),
-                             O_CREAT | O_WRONLY | O_DIRECT, FILE_PERMISSIONS);
-  if (fd_metadata < 0) {
-    fprintf(stderr, "ERROR: Could not open metadata file. %s\n",
-            strerror(errno));
-    ::close(fd_db);
+
+  lock_guard<mutex> manifest_guard(manifest_lock);
+  vector<RangeTombstone> tombstones = current->range_tombstones;
+  const vector<RangeTombstone>& recent = current->memtable->range_tombstones();
+  tombstones.insert(tombstones.end(), recent.begin(), recent.end());
+  bool snapshots_open = !live_snapshots().empty();
+  uint64_t sequence = 0;
+
+  auto version = make_shared<Version>();
+  version->memtable = current->memtable;
+  version->range_tombstones = current->range_tombstones;
+  vector<shared_ptr<SSTFile>> below, above;
+  vector<FileMeta> added;
+  // Deletes the files added so far
+  auto abandon = [&]() {
+    for (auto& file : below) {
+      file->obsolete = true;
+    }
+    for (auto& file : above) {
+      file->obsolete = true;
+    }
+  };
+  for (size_t i = 0; i < paths.size(); i++) {
+    FileMeta file = file_metas[i];
+    file.number = metadata.next_sst_id++;
+    bool overlaps =
+        snapshots_open || current->overlaps(file.min_key, file.max_key);
+    for (auto& tombstone : tombstones) {
+      overlaps |= file.min_key <= tombstone.end && tombstone.start <= file.max_key;
+    }
+
+    string sst_name = sst_path(file.number);
+    bool written = true;
+    if (!overlaps) {
+      file.level = 1;
+      file.max_sequence = 0;
+      // Files on another file system are copied
+      if (link(paths[i].c_str(), sst_name.c_str()) == -1) {
+        vector<KVPair> pairs = read_sst(paths[i], NULL, statistics);
+        StopWatch write_timer(statistics, SST_WRITE);
+        written = write_sst(pairs, sst_name);
+        statistics->add(SST_BYTES_WRITTEN, file_size(sst_name));
+      }
+    } else {
+      if (sequence == 0) {
+        unique_lock<shared_mutex> guard(memtable_lock);
+        sequence = ++metadata.last_sequence;
+      }
+      file.level = 0;
+      file.max_sequence = sequence;
+      vector<KVPair> pairs = read_sst(paths[i], NULL, statistics);
+      for (auto& kvpair : pairs) {
+        kvpair.seq = sequence;
+      }
+      {
+        StopWatch write_timer(statistics, SST_WRITE);
+        written = write_sst(pairs, sst_name);
+      }
+      statistics->add(SST_BYTES_WRITTEN, file_size(sst_name));
+    }
+    if (!written) {
+      unlink(sst_name.c_str());
+      abandon();
+      return false;
+    }
+    file.file_size = file_size(sst_name);
+    (overlaps ? above : below).push_back(make_shared<SSTFile>(file, sst_name));
+    added.push_back(file);
+  }
+  version->files = below;
+  version->files.insert(version->files.end(), current->files.begin(),
+                        current->files.end());
+  version->files.insert(version->files.end(), above.begin(), above.end());
+  metadata.num_elems = version->estimate_live_keys();
+  if (!sync_directory(name) || !manifest.log_edit(added, {}, metadata)) {
+    abandon();
     return false;
   }
-  Metadata* buff;
-  int buff_size = round_up_block_size(sizeof(Metadata));
-  int ret = posix_memalign((void**)&buff, BLOCK_SIZE, buff_size);
-  if (ret == -1) {
-    perror("posix_memalign");
+
+  sst_names.clear();
+  for (auto& sst : version->files) {
+    sst_names.push_back(sst->path);
   }
-  buff->memtable_size = metadata.memtable_size;
-  buff->next_sst_id = metadata.next_sst_id;
-  buff->num_elems = metadata.num_elems;
-  ret = pwrite(fd_metadata, buff, buff_size, 0);
-  if (ret == -1) {
-    perror("pwrite");
+  unique_lock<shared_mutex> guard(version_lock);
+  current = version;
+  // Absent keys may be cached for the files' ranges
+  if (row_cache != NULL) {
+    for (auto& file : added) {
+      row_cache->erase_range(file.min_key, file.max_key);
+    }
   }
-  free(buff);
-  ::close(fd_metadata);
-  ::close(fd_db);
-  this->name = "";
-  this->sst_names.clear();
-  delete (this->memtable);
-  this->buffer_pool->prepare_destroy();
-  delete (this->buffer_pool);
+  return true;
+}
+
+shared_ptr<Version> DB::acquire_version() {
+  shared_lock<shared_mutex> guard(version_lock);
+  return current;
+}
 
+// Write the memtable to a new SST, record it and the memtable's range
+// tombstones in the manifest and install a Version with the new SST and an
+// empty memtable. Readers of the old Version keep using the old memtable,
+// which is no longer written. If the edit can't be logged the memtable is
+// kept, to be flushed again by the next write that fills it, and false is
+// returned.
+bool DB::flush_memtable() {
+  StopWatch timer(statistics, MEMTABLE_FLUSH);
+  // Held throughout so a compaction can't install a Version in between, and
+  // so file numbers keep the order in which the files' contents were written
+  lock_guard<mutex> manifest_guard(manifest_lock);
+  // Tombstones are kept to hide older writes in the SSTs
+  vector<KVPair> kvpairs =
+      drop_hidden(current->memtable->versions(MIN_KEY, MAX_KEY),
+                  live_snapshots(), false, merge_operator);
+  vector<RangeTombstone> ranges = current->memtable->range_tombstones();
+  if (kvpairs.empty() && ranges.empty()) {
+    return true;
+  }
+
+  auto version = make_shared<Version>();
+  version->memtable = make_shared<Tree>(metadata.memtable_size);
+  version->files = current->files;
+  version->range_tombstones = current->range_tombstones;
+  version->range_tombstones.insert(version->range_tombstones.end(),
+                                   ranges.begin(), ranges.end());
+  vector<FileMeta> added;
+  if (!kvpairs.empty()) {
+    FileMeta file;
+    file.number = metadata.next_sst_id++;
+    file.min_key = kvpairs.front().key;
+    file.max_key = kvpairs.back().key;
+    // A file whose keys no other file's range covers, as when keys only ever
+    // grow, joins level 1 and is never merged for being flushed
+    file.level = current->overlaps(file.min_key, file.max_key) ? 0 : 1;
+    file.max_sequence = metadata.last_sequence;
+    file.num_entries = kvpairs.size();
+    file.num_deletions = count_deletions(kvpairs);
+
+    string sst_name = sst_path(file.number);
+    bool written;
+    {
+      StopWatch write_timer(statistics, SST_WRITE);
+      written = write_sst(kvpairs, sst_name) && sync_directory(name);
+    }
+    if (!written) {
+      fprintf(stderr, "ERROR: Could not write %s\n", sst_name.c_str());
+      unlink(sst_name.c_str());
+      return false;
+    }
+    file.file_size = file_size(sst_name);
+    statistics->add(SST_BYTES_WRITTEN, file.file_size);
+    version->files.push_back(make_shared<SSTFile>(file, sst_name));
+    added.push_back(file);
+  }
+  metadata.num_elems = version->estimate_live_keys();
+  if (!manifest.log_edit(added, {}, metadata, ranges)) {
+    fprintf(stderr, "ERROR: Could not log the flush of the memtable\n");
+    if (!added.empty()) {
+      version->files.back()->obsolete = true;
+    }
+    return false;
+  }
+  if (!added.empty()) {
+    sst_names.push_back(version->files.back()->path);
+  }
+
+  unique_lock<shared_mutex> guard(version_lock);
+  current = version;
+  // A reader may have cached an SST value after the newer memtable value was
+  // written. Lookups stopped at the memtable until now, so drop those rows.
+  // Rows read from an older Version are no longer cached once current changes.
+  if (row_cache != NULL) {
+    for (auto& kvpair : kvpairs) {
+      row_cache->erase(kvpair.key);
+    }
+    for (auto& range : ranges) {
+      row_cache->erase_range(range.start, range.end);
+    }
+  }
   return true;
 }
 
-void DB::put(uint64_t key, uint64_t value) {
-  if (!memtable->put(key, value)) {
-    vector<KVPair> kvpairs = memtable->scan(MIN_KEY, MAX_KEY);
-    unsigned int sst_index = 0;
-    string sst_name = name + "/" + to_string(sst_index++) + SST_EXTENSION;
-    while (is_file_exists(sst_name)) {  // if file exists, merge
-      vector<KVPair> old_sst = read_sst(sst_name);
-      merge(kvpairs, old_sst);
-      sst_name = name + "/" + to_string(sst_index++) + SST_EXTENSION;
+// Merge every SST into a single level 1 SST. The newest value of each key is
+// kept, along with older ones that live snapshots still read. Deleted keys are
+// dropped since no older file is left for their tombstones to hide, and so are
+// the flushed range tombstones once the writes they delete are. An SST that
+// one of them deletes entirely isn't even read. Reads and
+// writes continue while the SSTs are merged; the replaced files are deleted
+// once no read is using them.
+bool DB::compact() {
+  StopWatch timer(statistics, COMPACTION);
+  lock_guard<mutex> compaction_guard(compaction_lock);
+  shared_ptr<Version> base;
+  FileMeta file;
+  {
+    lock_guard<mutex> manifest_guard(manifest_lock);
+    base = acquire_version();
+    if (base->range_tombstones.empty() &&
+        (base->files.empty() ||
+         (base->files.size() == 1 && base->files[0]->meta.level == 1))) {
+      return true;
+    }
+    file.number = metadata.next_sst_id++;
+  }
+
+  // Snapshots taken from now on read the newest writes in base, which are
+  // always kept
+  vector<uint64_t> snapshots = live_snapshots();
+  uint64_t oldest_snapshot =
+      snapshots.empty() ? MAX_SEQUENCE : snapshots.front();
+  vector<KVPair> kvpairs;
+  file.max_sequence = 0;
+  for (auto& input : base->files) {
+    const FileMeta& meta = input->meta;
+    if (range_deleted(base->range_tombstones, meta.min_key, meta.max_key,
+                      meta.max_sequence, oldest_snapshot)) {
+      continue;
+    }
+    vector<KVPair> pairs = read_sst(input->path, buffer_pool, statistics);
+    kvpairs.insert(kvpairs.end(), pairs.begin(), pairs.end());
+    file.max_sequence = max(file.max_sequence, input->meta.max_sequence);
+  }
+  sort(kvpairs.begin(), kvpairs.end(), storage_order);
+  kvpairs = drop_hidden(with_point_tombstones(kvpairs, base->range_tombstones),
+                        snapshots, true, merge_operator);
+
+  shared_ptr<SSTFile> output;
+  if (!kvpairs.empty()) {
+    file.level = 1;
+    file.min_key = kvpairs.front().key;
+    file.max_key = kvpairs.back().key;
+    file.num_entries = kvpairs.size();
+    file.num_deletions = 0;
+    // Tombstones a range tombstone left for snapshots are newer than the
+    // inputs
+    for (auto& kvpair : kvpairs) {
+      file.max_sequence = max(file.max_sequence, kvpair.sequence());
+    }
+    output = make_shared<SSTFile>(file, sst_path(file.number));
+    bool written;
+    {
+      StopWatch write_timer(statistics, SST_WRITE);
+      written = write_sst(kvpairs, output->path) && sync_directory(name);
     }
-    write_sst(kvpairs, sst_name);
-    sst_names.push_back(sst_name);
-    delete (memtable);
-    memtable = new Tree(metadata.memtable_size);
+    if (!written) {
+      output->obsolete = true;
+      return false;
+    }
+    output->meta.file_size = file_size(output->path);
+    statistics->add(SST_BYTES_WRITTEN, output->meta.file_size);
+  }
+
+  lock_guard<mutex> manifest_guard(manifest_lock);
+  // Flushes since base only appended files, which are newer than output, and
+  // ingests only added files after them or below every other
+  auto version = make_shared<Version>();
+  version->memtable = current->memtable;
+  size_t first = 0;
+  if (!base->files.empty()) {
+    first = find(current->files.begin(), current->files.end(),
+                 base->files.front()) -
+            current->files.begin();
+  }
+  version->files.assign(current->files.begin(),
+                        current->files.begin() + first);
+  if (output != NULL) {
+    version->files.push_back(output);
+  }
+  version->files.insert(version->files.end(),
+                        current->files.begin() + first + base->files.size(),
+                        current->files.end());
+  // Likewise for range tombstones
+  version->range_tombstones.assign(
+      current->range_tombstones.begin() + base->range_tombstones.size(),
+      current->range_tombstones.end());
+  vector<uint64_t> removed_ranges;
+  for (auto& tombstone : base->range_tombstones) {
+    removed_ranges.push_back(tombstone.seq);
+  }
+  vector<int> removed;
+  for (auto& input : base->files) {
+    removed.push_back(input->meta.number);
+  }
+  Metadata logged;
+  {
+    // The leader only changes last_sequence with memtable_lock held
+    shared_lock<shared_mutex> guard(memtable_lock);
+    metadata.num_elems = version->estimate_live_keys();
+    logged = metadata;
+  }
+  vector<FileMeta> added;
+  if (output != NULL) {
+    added.push_back(output->meta);
+  }
+  if (!manifest.log_edit(added, removed, logged, {}, removed_ranges)) {
+    if (output != NULL) {
+      output->obsolete = true;
+    }
+    return false;
   }
-  metadata.num_elems++;
+
+  for (auto& input : base->files) {
+    input->obsolete = true;
+  }
+  sst_names.clear();
+  for (auto& sst : version->files) {
+    sst_names.push_back(sst->path);
+  }
+  unique_lock<shared_mutex> guard(version_lock);
+  current = version;
+  return true;
 }
 
-void DB::del(uint64_t key) { put(key, TOMBSTONE); }
+// Start a compaction in the background once enough level 0 SSTs have piled
+// up, unless one is already running. Only the leader calls this.
+void DB::maybe_schedule_compaction() {
+  if (compaction_trigger <= 0 || compaction_scheduled ||
+      acquire_version()->num_files_at_level(0) < compaction_trigger) {
+    return;
+  }
+  if (compaction_thread.joinable()) {
+    compaction_thread.join();
+  }
+  compaction_scheduled = true;
+  compaction_thread = thread([this]() {
+    compact();
+    compaction_scheduled = false;
+  });
+}
+
+// Remove SSTs the manifest doesn't list: outputs of a compaction that didn't
+// commit, or inputs of one that did but wasn't done deleting them
+void DB::delete_unlisted_ssts() {
+  DIR* db_dir = opendir(name.c_str());
+  if (db_dir == NULL) {
+    perror("opendir");
+    return;
+  }
+  struct dirent* ent;
+  while ((ent = readdir(db_dir)) != NULL) {
+    string ent_name = string(ent->d_name);
+    size_t ext = ent_name.rfind(SST_EXTENSION);
+    if (ext == 0 || ext == string::npos ||
+        ext + SST_EXTENSION.length() != ent_name.length() ||
+        ent_name.find_first_not_of("0123456789") != ext) {
+      continue;
+    }
+    if (manifest.files.count(stoi(ent_name.substr(0, ext))) == 0) {
+      unlink((name + "/" + ent_name).c_str());
+    }
+  }
+  closedir(db_dir);
+}
 
 uint64_t DB::binary_search(vector<KVPair> kvpairs, uint64_t key) {
   int low = 0;
@@ -165,81 +702,1076 @@ uint64_t DB::binary_search(vector<KVPair> kvpairs, uint64_t key) {
   throw KeyException("Key not found in sst");
 }
 
-uint64_t DB::get(uint64_t key) {
-  try {
-    uint64_t value = memtable->get(key);
-    return value;
-  } catch (const KeyException& e) {
-    if (VERBOSE) cerr << e.what() << "\n";
-    vector<KVPair> kvpairs;
-    for (auto sst = begin(sst_names); sst != end(sst_names); ++sst) {
-      try {
-        return sst_get(*sst, key, buffer_pool, false);
-      } catch (const KeyException& e) {
-        if (VERBOSE) cerr << e.what() << "\n";
+uint64_t DB::get(uint64_t key, const Snapshot* snapshot) {
+  StopWatch timer(statistics, DB_GET);
+  trace(TRACE_GET, key, 0);
+  uint64_t value = lookup(key, snapshot ? snapshot->sequence : MAX_SEQUENCE);
+  statistics->add(USER_BYTES_READ, KV_BYTES);
+  return value;
+}
+
+// Find the newest value of key written at or before snapshot, merged with the
+// operands written above it. The row cache only holds the newest values, so
+// reads at an older snapshot skip it.
+uint64_t DB::lookup(uint64_t key, uint64_t snapshot) {
+  shared_ptr<Version> version = acquire_version();
+  bool latest = snapshot == MAX_SEQUENCE;
+  MergeChain chain(merge_operator);
+  if (!lookup_in_memory(version, key, snapshot, &chain)) {
+    // Only cache what the SSTs hold on their own
+    bool cacheable = latest && !chain.found;
+    // Newest SST first, skipping files whose key range can't hold the key,
+    // until the writes are older than a range tombstone deleting them
+    PerfTimer perf_timer(&perf_context.sst_nanos);
+    uint64_t deleted = deleted_at(version->range_tombstones, key, snapshot);
+    bool settled = false;
+    for (auto it = version->files.rbegin();
+         it != version->files.rend() && !settled; ++it) {
+      const FileMeta& file = (*it)->meta;
+      if (file.max_sequence < deleted) {
+        settled = chain.add(TOMBSTONE, false);
+        break;
+      }
+      if (key < file.min_key || key > file.max_key) {
+        PERF_ADD(range_filter_negative, 1);
+        continue;
+      }
+      PERF_ADD(range_filter_positive, 1);
+      PERF_ADD(ssts_probed, 1);
+      // Below an operand, read on from the next older write in the file
+      uint64_t read_at = snapshot;
+      while (!settled) {
+        uint64_t value, seq;
+        try {
+          value = sst_get((*it)->path, key, buffer_pool, false, statistics,
+                          read_at, &seq);
+        } catch (const KeyException& e) {
+          if (VERBOSE) cerr << e.what() << "\n";
+          break;
+        }
+        uint64_t sequence = seq & ~MERGE_OPERAND;
+        if (sequence < deleted) {
+          value = TOMBSTONE;
+        }
+        settled = chain.add(value, seq & MERGE_OPERAND) || sequence == 0;
+        read_at = sequence - 1;
+      }
+    }
+    if (cacheable) {
+      cache_row(version, key, chain.found, chain.value);
+    }
+  }
+  if (!chain.found) {
+    throw KeyException("Key not in database");
+  }
+  return chain.value;
+}
+
+// Add the writes to a key in the memtable and, for the newest value, the row
+// cache to chain. Return true if they settle it and the SSTs needn't be read.
+bool DB::lookup_in_memory(const shared_ptr<Version>& version, uint64_t key,
+                          uint64_t snapshot, MergeChain* chain) {
+  {
+    PerfTimer perf_timer(&perf_context.memtable_nanos);
+    shared_lock<shared_mutex> guard(memtable_lock);
+    uint64_t value, seq;
+    uint64_t read_at = snapshot;
+    // Every SST write is older than a range tombstone in the memtable
+    uint64_t deleted = version->memtable->deleted_at(key, snapshot);
+    while (version->memtable->find(key, read_at, &value, &seq)) {
+      uint64_t sequence = seq & ~MERGE_OPERAND;
+      if (sequence < deleted) {
+        break;
       }
+      if (chain->add(value, seq & MERGE_OPERAND)) {
+        return true;
+      }
+      read_at = sequence - 1;
+    }
+    if (deleted > 0) {
+      chain->add(TOMBSTONE, false);
+      return true;
+    }
+  }
+
+  // Cached rows hold what the SSTs have, which the operands in the memtable
+  // would have to be merged onto, so only whole rows are read from the cache
+  if (row_cache != NULL && snapshot == MAX_SEQUENCE && !chain->found) {
+    uint64_t value;
+    int cached;
+    {
+      PerfTimer perf_timer(&perf_context.row_cache_nanos);
+      cached = row_cache->get(key, &value);
+    }
+    if (cached == ROW_MISS) {
+      PERF_ADD(row_cache_misses, 1);
+    } else {
+      PERF_ADD(row_cache_hits, 1);
+    }
+    if (cached != ROW_MISS) {
+      chain->add(cached == ROW_FOUND ? value : TOMBSTONE, false);
+      return true;
     }
   }
-  throw KeyException("Key not in database");
+  return false;
 }
 
-vector<KVPair> DB::scan(uint64_t key1, uint64_t key2) {
-  vector<KVPair> output = memtable->scan(key1, key2);
+// The Version is held across suspensions, so the files it lists stay on disk
+// until the lookup is done even if a compaction replaces them
+Task<uint64_t> DB::get_async(uint64_t key, Executor* executor,
+                             const Snapshot* snapshot) {
+  StopWatch timer(statistics, DB_GET);
+  trace(TRACE_GET, key, 0);
+  if (executor == NULL) {
+    executor = &inline_executor;
+  }
+  uint64_t sequence = snapshot ? snapshot->sequence : MAX_SEQUENCE;
+  shared_ptr<Version> version = acquire_version();
+  MergeChain chain(merge_operator);
+  if (!lookup_in_memory(version, key, sequence, &chain)) {
+    bool cacheable = sequence == MAX_SEQUENCE && !chain.found;
+    uint64_t deleted = deleted_at(version->range_tombstones, key, sequence);
+    bool settled = false;
+    for (auto it = version->files.rbegin();
+         it != version->files.rend() && !settled; ++it) {
+      const FileMeta& file = (*it)->meta;
+      if (file.max_sequence < deleted) {
+        settled = chain.add(TOMBSTONE, false);
+        break;
+      }
+      if (key < file.min_key || key > file.max_key) {
+        PERF_ADD(range_filter_negative, 1);
+        continue;
+      }
+      PERF_ADD(range_filter_positive, 1);
+      PERF_ADD(ssts_probed, 1);
+      uint64_t read_at = sequence;
+      while (!settled) {
+        uint64_t value, seq;
+        bool in_file = true;
+        try {
+          value = co_await sst_get_async((*it)->path, key, buffer_pool,
+                                         io_service, executor, statistics,
+                                         read_at, &seq);
+        } catch (const KeyException& e) {
+          in_file = false;
+        }
+        if (!in_file) {
+          break;
+        }
+        uint64_t written = seq & ~MERGE_OPERAND;
+        if (written < deleted) {
+          value = TOMBSTONE;
+        }
+        settled = chain.add(value, seq & MERGE_OPERAND) || written == 0;
+        read_at = written - 1;
+      }
+    }
+    if (cacheable) {
+      cache_row(version, key, chain.found, chain.value);
+    }
+  }
+  if (!chain.found) {
+    throw KeyException("Key not in database");
+  }
+  statistics->add(USER_BYTES_READ, KV_BYTES);
+  co_return chain.value;
+}
+
+Task<vector<KVPair>> DB::scan_async(uint64_t key1, uint64_t key2,
+                                    Executor* executor,
+                                    const Snapshot* snapshot) {
+  StopWatch timer(statistics, DB_SCAN);
+  trace(TRACE_SCAN, key1, key2);
+  if (executor == NULL) {
+    executor = &inline_executor;
+  }
+  shared_ptr<Version> version = acquire_version();
+  uint64_t sequence;
+  vector<KVPair> kvpairs;
+  vector<RangeTombstone> tombstones = version->range_tombstones;
+  {
+    shared_lock<shared_mutex> guard(memtable_lock);
+    sequence = snapshot ? snapshot->sequence : metadata.last_sequence;
+    kvpairs = version->memtable->versions(key1, key2);
+    const vector<RangeTombstone>& recent =
+        version->memtable->range_tombstones();
+    tombstones.insert(tombstones.end(), recent.begin(), recent.end());
+  }
+
+  for (auto& file : version->files) {
+    if (range_deleted(tombstones, max(key1, file->meta.min_key),
+                      min(key2, file->meta.max_key), file->meta.max_sequence,
+                      sequence)) {
+      continue;
+    }
+    PERF_ADD(ssts_probed, 1);
+    vector<KVPair> pairs =
+        co_await sst_scan_async(file->path, key1, key2, buffer_pool,
+                                io_service, executor, statistics);
+    kvpairs.insert(kvpairs.end(), pairs.begin(), pairs.end());
+  }
+  sort(kvpairs.begin(), kvpairs.end(), storage_order);
+  apply_range_tombstones(kvpairs, tombstones, sequence);
+  vector<KVPair> output = visible_at(kvpairs, sequence, merge_operator);
+  statistics->add(USER_BYTES_READ, output.size() * KV_BYTES);
+  co_return output;
+}
+
+// Cache the result of looking a key up in the SSTs of a Version, unless a
+// flush has installed a newer Version since
+void DB::cache_row(const shared_ptr<Version>& version, uint64_t key,
+                   bool found, uint64_t value) {
+  if (row_cache == NULL) {
+    return;
+  }
+  shared_lock<shared_mutex> guard(version_lock);
+  if (current != version) {
+    return;
+  }
+  if (found) {
+    row_cache->put(key, value);
+  } else {
+    row_cache->put_absent(key);
+  }
+}
+
+// The newest value of every key in [key1, key2] written at or before the
+// snapshot, or at or before the start of the scan without one.
+//
+// With a limit each source, the memtable and every SST, is read only up to
+// some number of keys, from key1 up or from key2 down. Keys past where a
+// truncated source stopped may be missing writes, so only those before are
+// returned; if that is short of the limit, the sources are read again from
+// there, twice as far. Deleted keys count against what a source reads, so a
+// heavily deleted range takes a few rounds.
+vector<KVPair> DB::scan(uint64_t key1, uint64_t key2, const Snapshot* snapshot,
+                        size_t limit, bool reverse) {
+  StopWatch timer(statistics, DB_SCAN);
+  trace(TRACE_SCAN, key1, key2);
+  shared_ptr<Version> version = acquire_version();
+  uint64_t sequence;
+  vector<RangeTombstone> tombstones = version->range_tombstones;
+  {
+    shared_lock<shared_mutex> guard(memtable_lock);
+    sequence = snapshot ? snapshot->sequence : metadata.last_sequence;
+    const vector<RangeTombstone>& recent =
+        version->memtable->range_tombstones();
+    tombstones.insert(tombstones.end(), recent.begin(), recent.end());
+  }
+
+  vector<KVPair> output;
+  size_t fetch = limit;
+  while (key1 <= key2 && output.size() < limit) {
+    vector<KVPair> kvpairs;
+    bool truncated = false;
+    uint64_t bound = reverse ? MIN_KEY : MAX_KEY;  // Where results stay exact
+    auto add = [&](const vector<KVPair>& pairs) {
+      kvpairs.insert(kvpairs.end(), pairs.begin(), pairs.end());
+      if (fetch == SIZE_MAX || count_keys(pairs) < fetch) {
+        return;
+      }
+      truncated = true;
+      bound = reverse ? max(bound, pairs.back().key)
+                      : min(bound, pairs.back().key);
+    };
+    {
+      PerfTimer perf_timer(&perf_context.memtable_nanos);
+      shared_lock<shared_mutex> guard(memtable_lock);
+      add(version->memtable->versions(key1, key2, fetch, reverse));
+    }
+
+    {
+      PerfTimer perf_timer(&perf_context.sst_nanos);
+      for (auto& file : version->files) {
+        // Files whose part of the range was deleted after they were written
+        // aren't read
+        if (range_deleted(tombstones, max(key1, file->meta.min_key),
+                          min(key2, file->meta.max_key),
+                          file->meta.max_sequence, sequence)) {
+          continue;
+        }
+        PERF_ADD(ssts_probed, 1);
+        add(sst_scan(file->path, key1, key2, buffer_pool, statistics, fetch,
+                     reverse));
+      }
+    }
+    sort(kvpairs.begin(), kvpairs.end(),
+         reverse ? reverse_storage_order : storage_order);
+    apply_range_tombstones(kvpairs, tombstones, sequence);
+    for (auto& kvpair : visible_at(kvpairs, sequence, merge_operator)) {
+      if (output.size() == limit ||
+          (reverse ? kvpair.key < bound : kvpair.key > bound)) {
+        break;
+      }
+      output.push_back(kvpair);
+    }
+    if (!truncated || (reverse ? bound == MIN_KEY : bound == MAX_KEY)) {
+      break;
+    }
+    if (reverse) {
+      key2 = bound - 1;
+    } else {
+      key1 = bound + 1;
+    }
+    fetch = fetch > SIZE_MAX / 2 ? SIZE_MAX : fetch * 2;
+  }
+  statistics->add(USER_BYTES_READ, output.size() * KV_BYTES);
+  return output;
+}
 
+// The newest value of every key in [key1, key2] that the predicate matches,
+// as scan would return them. SST pages whose values the predicate can't match
+// aren't read, unless leaving them out could change what other writes read.
+vector<KVPair> DB::scan_filtered(uint64_t key1, uint64_t key2,
+                                 ValuePredicate predicate,
+                                 const Snapshot* snapshot) {
+  StopWatch timer(statistics, DB_SCAN);
+  shared_ptr<Version> version = acquire_version();
+  uint64_t sequence;
   vector<KVPair> kvpairs;
-  for (auto sst = begin(sst_names); sst != end(sst_names); ++sst) {
-    kvpairs = sst_scan(*sst, key1, key2);
-    output.insert(output.end(), kvpairs.begin(), kvpairs.end());
+  vector<RangeTombstone> tombstones = version->range_tombstones;
+  {
+    PerfTimer perf_timer(&perf_context.memtable_nanos);
+    shared_lock<shared_mutex> guard(memtable_lock);
+    sequence = snapshot ? snapshot->sequence : metadata.last_sequence;
+    kvpairs = version->memtable->versions(key1, key2);
+    const vector<RangeTombstone>& recent =
+        version->memtable->range_tombstones();
+    tombstones.insert(tombstones.end(), recent.begin(), recent.end());
+  }
+  vector<uint64_t> operand_keys;
+  for (auto& kvpair : kvpairs) {
+    if (kvpair.is_operand()) {
+      operand_keys.push_back(kvpair.key);
+    }
+  }
+
+  {
+    PerfTimer perf_timer(&perf_context.sst_nanos);
+    for (size_t f = 0; f < version->files.size(); f++) {
+      const FileMeta& meta = version->files[f]->meta;
+      if (meta.max_key < key1 || meta.min_key > key2 ||
+          range_deleted(tombstones, max(key1, meta.min_key),
+                        min(key2, meta.max_key), meta.max_sequence,
+                        sequence)) {
+        continue;
+      }
+      PERF_ADD(ssts_probed, 1);
+      vector<KVPair> pairs = scan_pages(
+          *version->files[f], key1, key2,
+          [&](const vector<PageSummary>& summaries, size_t i) {
+            const PageSummary& summary = summaries[i];
+            if ((summary.count > 0 && summary.min_value <= predicate.high &&
+                 predicate.low <= summary.max_value) ||
+                !page_skippable(summaries, i, *version, f, operand_keys)) {
+              return false;
+            }
+            PERF_ADD(pages_filtered, 1);
+            return true;
+          });
+      kvpairs.insert(kvpairs.end(), pairs.begin(), pairs.end());
+    }
   }
+  sort(kvpairs.begin(), kvpairs.end(), storage_order);
+  apply_range_tombstones(kvpairs, tombstones, sequence);
+  vector<KVPair> output =
+      filter_values(visible_at(kvpairs, sequence, merge_operator), predicate);
+  statistics->add(USER_BYTES_READ, output.size() * KV_BYTES);
   return output;
 }
 
-string DB::get_sst_filename() {
-  return name + "/" + to_string(metadata.next_sst_id++) + SST_EXTENSION;
+// Every pair in [key1, key2] of an SST, except in the pages that skip(the
+// file's page summaries, page index) is true for, which aren't read
+vector<KVPair> DB::scan_pages(SSTFile& file, uint64_t key1, uint64_t key2,
+                              const PageFilter& skip) {
+  vector<KVPair> kvpairs;
+  for (auto cursor = page_cursor(file, key1, key2, skip); cursor->valid();
+       cursor->next()) {
+    kvpairs.push_back(cursor->get());
+  }
+  return kvpairs;
 }
 
-// Put all SST names back in memory when database is reopened
-void DB::reopen_ssts_by_age(string dir_name, DIR* dir) {
-  struct dirent* ent;
-  struct stat statbuf;
+// scan_pages a page at a time. skip is called for every page before the
+// cursor is returned.
+unique_ptr<SSTCursor> DB::page_cursor(SSTFile& file, uint64_t key1,
+                                      uint64_t key2, const PageFilter& skip) {
+  const vector<PageSummary>& summaries = page_summaries(file);
+  if (summaries.empty()) {
+    return make_unique<SSTCursor>(file.path, (vector<int>*)NULL, key1, key2,
+                                  buffer_pool, statistics);
+  }
+  vector<int> pages;
+  for (size_t i = 0; i < summaries.size(); i++) {
+    if (summaries[i].max_key >= key1 && summaries[i].min_key <= key2 &&
+        !skip(summaries, i)) {
+      pages.push_back(i);
+    }
+  }
+  return make_unique<SSTCursor>(file.path, &pages, key1, key2, buffer_pool,
+                                statistics);
+}
+
+// Read like scan, except that an SST page the range covers is aggregated from
+// its summary when no other write can change what the page reads, so a large
+// range over compacted data reads little besides the pages at its ends
+uint64_t DB::aggregate(uint64_t key1, uint64_t key2, int op,
+                       const Snapshot* snapshot) {
+  StopWatch timer(statistics, DB_AGGREGATE);
+  shared_ptr<Version> version = acquire_version();
+  uint64_t sequence;
+  vector<KVPair> kvpairs;
+  vector<RangeTombstone> tombstones = version->range_tombstones;
+  {
+    PerfTimer perf_timer(&perf_context.memtable_nanos);
+    shared_lock<shared_mutex> guard(memtable_lock);
+    sequence = snapshot ? snapshot->sequence : metadata.last_sequence;
+    kvpairs = version->memtable->versions(key1, key2);
+    const vector<RangeTombstone>& recent =
+        version->memtable->range_tombstones();
+    tombstones.insert(tombstones.end(), recent.begin(), recent.end());
+  }
+  vector<uint64_t> memtable_keys;
+  for (auto& kvpair : kvpairs) {
+    memtable_keys.push_back(kvpair.key);
+  }
+
+  uint64_t count = 0, sum = 0, min_value = MAX_KEY, max_value = 0;
+  vector<unique_ptr<SSTCursor>> cursors;
+  {
+    PerfTimer perf_timer(&perf_context.sst_nanos);
+    for (auto& file : version->files) {
+      const FileMeta& meta = file->meta;
+      if (meta.max_key < key1 || meta.min_key > key2 ||
+          range_deleted(tombstones, max(key1, meta.min_key),
+                        min(key2, meta.max_key), meta.max_sequence,
+                        sequence)) {
+        continue;
+      }
+      PERF_ADD(ssts_probed, 1);
+      cursors.push_back(page_cursor(
+          *file, key1, key2,
+          [&](const vector<PageSummary>& summaries, size_t i) {
+            const PageSummary& summary = summaries[i];
+            if (key1 > summary.min_key || summary.max_key > key2 ||
+                !summary_usable(summary, *file, *version, memtable_keys,
+                                tombstones, sequence)) {
+              return false;
+            }
+            PERF_ADD(pages_summarized, 1);
+            count += summary.count;
+            sum += summary.sum;
+            min_value = min(min_value, summary.min_value);
+            max_value = max(max_value, summary.max_value);
+            return true;
+          }));
+    }
+  }
 
-  vector<pair<string, struct timespec>>
-      sst_name_createtime;  // (name, creation time) pairs
+  // The pages no summary stands in for are merged with the memtable and
+  // folded a key at a time, as visible_at would read them, holding one page
+  // of each file
+  PerfTimer perf_timer(&perf_context.sst_nanos);
+  auto after = [&](size_t a, size_t b) {
+    return storage_order(cursors[b]->get(), cursors[a]->get());
+  };
+  priority_queue<size_t, vector<size_t>, decltype(after)> heap(after);
+  for (size_t i = 0; i < cursors.size(); i++) {
+    if (cursors[i]->valid()) {
+      heap.push(i);
+    }
+  }
+  size_t next = 0;  // Into the memtable's pairs
+  while (next < kvpairs.size() || !heap.empty()) {
+    uint64_t key = next < kvpairs.size() ? kvpairs[next].key : MAX_KEY;
+    if (!heap.empty()) {
+      key = min(key, cursors[heap.top()]->get().key);
+    }
+    uint64_t deleted = deleted_at(tombstones, key, sequence);
+    MergeChain chain(merge_operator);
+    bool settled = false;
+    auto add = [&](const KVPair& kvpair) {
+      if (settled || kvpair.sequence() > sequence) {
+        return;
+      }
+      if (kvpair.sequence() < deleted) {
+        settled = true;
+      } else {
+        settled = chain.add(kvpair.value, kvpair.is_operand());
+      }
+    };
+    // The memtable's writes to a key are newer than any in a file
+    for (; next < kvpairs.size() && kvpairs[next].key == key; next++) {
+      add(kvpairs[next]);
+    }
+    while (!heap.empty() && cursors[heap.top()]->get().key == key) {
+      size_t i = heap.top();
+      heap.pop();
+      add(cursors[i]->get());
+      cursors[i]->next();
+      if (cursors[i]->valid()) {
+        heap.push(i);
+      }
+    }
+    if (chain.found) {
+      count++;
+      sum += chain.value;
+      min_value = min(min_value, chain.value);
+      max_value = max(max_value, chain.value);
+    }
+  }
 
-  while ((ent = readdir(dir)) != NULL) {
+  switch (op) {
+    case AGGREGATE_COUNT:
+      return count;
+    case AGGREGATE_SUM:
+      return sum;
+  }
+  if (count == 0) {
+    throw KeyException("No keys in range");
+  }
+  return op == AGGREGATE_MIN ? min_value : max_value;
+}
+
+const Snapshot* DB::get_snapshot() {
+  Snapshot* snapshot = new Snapshot;
+  // Registered before memtable_lock is released, so a flush or compaction
+  // listing the live snapshots never misses one whose sequence is chosen
+  shared_lock<shared_mutex> guard(memtable_lock);
+  snapshot->sequence = metadata.last_sequence;
+  lock_guard<mutex> snapshots_guard(snapshots_lock);
+  snapshots.insert(snapshot->sequence);
+  return snapshot;
+}
+
+void DB::release_snapshot(const Snapshot* snapshot) {
+  {
+    lock_guard<mutex> guard(snapshots_lock);
+    auto it = snapshots.find(snapshot->sequence);
+    if (it != snapshots.end()) {
+      snapshots.erase(it);
+    }
+  }
+  delete snapshot;
+}
+
+// Sequences of the snapshots still held, ascending
+vector<uint64_t> DB::live_snapshots() {
+  lock_guard<mutex> guard(snapshots_lock);
+  return vector<uint64_t>(snapshots.begin(), snapshots.end());
+}
+
+string DB::sst_path(int number) {
+  return name + "/" + to_string(number) + SST_EXTENSION;
+}
+
+// Build a manifest for a database written before manifests existed. Its
+// metadata file is read once and its SSTs are ordered by file number, which
+// is their creation order.
+bool DB::import_legacy_db(string db_name, int fd_db) {
+  int fd_metadata = ::openat(fd_db, METADATA_FILE.c_str(), O_RDONLY | O_DIRECT,
+                             FILE_PERMISSIONS);
+  if (fd_metadata < 0) {
+    fprintf(stderr, "ERROR: Could not open %s file in database %s. %s\n",
+            METADATA_FILE.c_str(), db_name.c_str(), strerror(errno));
+    return false;
+  }
+  // The legacy metadata block holds memtable_size, next_sst_id and num_elems
+  int* buff;
+  int buff_size = round_up_block_size(3 * sizeof(int));
+  if (posix_memalign((void**)&buff, BLOCK_SIZE, buff_size) != 0) {
+    perror("posix_memalign");
+  }
+  if (pread(fd_metadata, buff, buff_size, 0) == -1) {
+    perror("pread");
+  }
+  Metadata legacy;
+  legacy.memtable_size = buff[0];
+  legacy.next_sst_id = buff[1];
+  legacy.num_elems = buff[2];
+  legacy.last_sequence = buff[2];
+  free(buff);
+  ::close(fd_metadata);
+
+  vector<FileMeta> files;
+  DIR* db_dir = fdopendir(dup(fd_db));
+  struct dirent* ent;
+  while ((ent = readdir(db_dir)) != NULL) {
     string ent_name = string(ent->d_name);
-    if (ent_name.length() >= 4 &&
-        ent_name.substr(ent_name.length() - 4, ent_name.length()) ==
-            SST_EXTENSION) {
-      string sst_name = dir_name + "/" + ent_name;
-      if (stat(sst_name.c_str(), &statbuf) != 0) {
-        perror("stat");
+    size_t ext = ent_name.rfind(SST_EXTENSION);
+    if (ext == 0 || ext == string::npos ||
+        ext + SST_EXTENSION.length() != ent_name.length() ||
+        ent_name.find_first_not_of("0123456789") != ext) {
+      continue;
+    }
+    vector<KVPair> kvpairs = read_sst_v1(db_name + "/" + ent_name);
+    if (kvpairs.empty()) {
+      continue;
+    }
+    FileMeta file;
+    file.number = stoi(ent_name.substr(0, ext));
+    file.level = 0;
+    file.min_key = kvpairs.front().key;
+    file.max_key = kvpairs.back().key;
+    file.max_sequence = legacy.last_sequence;
+    file.num_entries = kvpairs.size();
+    file.num_deletions = count_deletions(kvpairs);
+    file.file_size = file_size(db_name + "/" + ent_name);
+    files.push_back(file);
+    if (file.number >= legacy.next_sst_id) {
+      legacy.next_sst_id = file.number + 1;
+    }
+  }
+  closedir(db_dir);
+
+  if (!manifest.create(db_name, legacy) ||
+      !manifest.log_edit(files, {}, legacy)) {
+    return false;
+  }
+  unlinkat(fd_db, METADATA_FILE.c_str(), 0);
+  return true;
+}
+
+// Rewrite SSTs from before page summaries were stored after the pages, or
+// from before sequence numbers were stored with each pair. Files are numbered
+// in the order they were written, so each one of the latter gets sequences
+// above those of the files before it.
+bool DB::upgrade_ssts() {
+  vector<FileMeta> upgraded;
+  uint64_t sequence = 0;
+  for (auto& entry : manifest.files) {
+    FileMeta file = entry.second;
+    string path = sst_path(file.number);
+    if (sst_has_summaries(path)) {
+      sequence = max(sequence, file.max_sequence);
+      continue;
+    }
+    vector<KVPair> kvpairs;
+    if (sst_has_sequences(path)) {
+      kvpairs = read_sst(path);
+      sequence = max(sequence, file.max_sequence);
+    } else {
+      kvpairs = read_sst_v1(path);
+      sequence = max(file.max_sequence, sequence + 1);
+      for (auto& kvpair : kvpairs) {
+        kvpair.seq = sequence;
+      }
+      file.max_sequence = sequence;
+    }
+    string tmp_path = path + ".tmp";
+    if (!write_sst(kvpairs, tmp_path)) {
+      unlink(tmp_path.c_str());
+      return false;
+    }
+    if (rename(tmp_path.c_str(), path.c_str()) == -1) {
+      perror("rename");
+      return false;
+    }
+    file.file_size = file_size(path);
+    upgraded.push_back(file);
+  }
+  if (upgraded.empty()) {
+    return true;
+  }
+  manifest.metadata.last_sequence =
+      max(manifest.metadata.last_sequence, sequence);
+  return sync_directory(name) &&
+         manifest.log_edit(upgraded, {}, manifest.metadata);
+}
+
+void DB::resize_buffer_pool(size_t bytes) { buffer_pool->resize_bytes(bytes); }
+
+size_t DB::buffer_pool_memory_usage() { return buffer_pool->memory_usage(); }
+
+StatisticsReport DB::get_statistics() { return statistics->report(); }
+
+// Start recording operations to a trace file, replacing any trace in progress
+bool DB::start_trace(string filename) {
+  end_trace();
+  auto writer = make_shared<TraceWriter>();
+  if (!writer->open(filename)) {
+    return false;
+  }
+  atomic_store(&tracer, writer);
+  tracing = true;
+  return true;
+}
+
+// Stop recording and write out the rest of the trace. Operations still holding
+// the old writer record into it until close, after which it ignores them.
+bool DB::end_trace() {
+  tracing = false;
+  shared_ptr<TraceWriter> writer = atomic_exchange(&tracer,
+                                                   shared_ptr<TraceWriter>());
+  if (writer == NULL) {
+    return true;
+  }
+  return writer->close();
+}
+
+void DB::trace(uint32_t op, uint64_t key, uint64_t arg) {
+  if (!tracing) {
+    return;
+  }
+  shared_ptr<TraceWriter> writer = atomic_load(&tracer);
+  if (writer != NULL) {
+    writer->record(op, key, arg);
+  }
+}
+
+// Record which pages are cached, hottest first, so the next open can load them
+// again instead of starting cold. Each line is "<sst file> <page> <hotness>".
+void DB::save_buffer_pool_state() {
+  ofstream state(name + "/" + BUFFER_POOL_STATE_FILE, ios::trunc);
+  string prefix = name + "/";
+  int hotness = 0;
+  for (auto& page : buffer_pool->resident_by_hotness()) {
+    if (page.first.compare(0, prefix.size(), prefix) == 0) {
+      state << page.first.substr(prefix.size()) << " " << page.second << " "
+            << hotness++ << "\n";
+    }
+  }
+}
+
+// Load the pages saved by the last close back into the buffer pool, hottest
+// first. Several threads read pages in parallel while open returns, and they
+// only fill free space, so they never evict pages brought in by requests.
+void DB::start_prefetch() {
+  ifstream state(name + "/" + BUFFER_POOL_STATE_FILE);
+  vector<pair<int, pair<string, int>>> saved;  // (hotness, (file, page))
+  string file;
+  int page, hotness;
+  while (state >> file >> page >> hotness) {
+    saved.push_back(make_pair(hotness, make_pair(name + "/" + file, page)));
+  }
+  if (saved.empty()) {
+    return;
+  }
+  sort(saved.begin(), saved.end());
+
+  auto pages = make_shared<vector<pair<string, int>>>();
+  for (auto& entry : saved) {
+    pages->push_back(entry.second);
+  }
+  auto next = make_shared<atomic<size_t>>(0);
+  stop_prefetch = false;
+  for (int i = 0; i < BP_PREFETCH_THREADS; i++) {
+    prefetch_threads.push_back(thread([this, pages, next]() {
+      size_t i;
+      while (!stop_prefetch && (i = (*next)++) < pages->size()) {
+        if (!prefetch_sst_page((*pages)[i].first, (*pages)[i].second,
+                               buffer_pool, statistics)) {
+          stop_prefetch = true;  // The pool is full
+        }
       }
-      sst_name_createtime.push_back(make_pair(sst_name, statbuf.st_ctim));
+    }));
+  }
+}
+
+void DB::wait_for_prefetch() {
+  for (auto& t : prefetch_threads) {
+    t.join();
+  }
+  prefetch_threads.clear();
+}
+
+
+// Properties with integer values:
+//   kvdb.num-files, kvdb.num-files-at-level<N>, kvdb.total-sst-bytes,
+//   kvdb.num-entries-memtable, kvdb.estimate-num-keys,
+//   kvdb.memory.memtable, kvdb.memory.buffer-pool, kvdb.memory.row-cache,
+//   kvdb.memory.manifest, kvdb.memory.total
+// Return false for an unknown property.
+bool DB::get_int_property(string property, uint64_t* value) {
+  const string level_prefix = "kvdb.num-files-at-level";
+  shared_ptr<Version> version = acquire_version();
+  if (property == "kvdb.num-files") {
+    *value = version->files.size();
+  } else if (property.compare(0, level_prefix.size(), level_prefix) == 0) {
+    string level = property.substr(level_prefix.size());
+    if (level.empty() || level.find_first_not_of("0123456789") != string::npos) {
+      return false;
     }
+    *value = version->num_files_at_level(stoi(level));
+  } else if (property == "kvdb.total-sst-bytes") {
+    *value = 0;
+    for (auto& file : version->files) {
+      *value += file->meta.file_size;
+    }
+  } else if (property == "kvdb.num-entries-memtable") {
+    shared_lock<shared_mutex> guard(memtable_lock);
+    *value = version->memtable->size();
+  } else if (property == "kvdb.estimate-num-keys") {
+    shared_lock<shared_mutex> guard(memtable_lock);
+    *value = version->estimate_live_keys() + version->memtable->size();
+  } else if (property == "kvdb.memory.memtable") {
+    shared_lock<shared_mutex> guard(memtable_lock);
+    *value = version->memtable->memory_usage();
+  } else if (property == "kvdb.memory.buffer-pool") {
+    *value = buffer_pool->memory_usage();
+  } else if (property == "kvdb.memory.row-cache") {
+    *value = row_cache == NULL ? 0 : row_cache->memory_usage();
+  } else if (property == "kvdb.memory.manifest") {
+    // The live file map, the SST names and the files of the Version
+    *value = version->files.size() *
+             (sizeof(pair<const int, FileMeta>) + 4 * sizeof(void*) +
+              sizeof(SSTFile) + sizeof(shared_ptr<SSTFile>));
+    for (auto& file : version->files) {
+      *value += 2 * (sizeof(string) + file->path.capacity());
+    }
+  } else if (property == "kvdb.memory.total") {
+    uint64_t memtable_bytes, buffer_pool_bytes, row_cache_bytes,
+        manifest_bytes;
+    get_int_property("kvdb.memory.memtable", &memtable_bytes);
+    get_int_property("kvdb.memory.buffer-pool", &buffer_pool_bytes);
+    get_int_property("kvdb.memory.row-cache", &row_cache_bytes);
+    get_int_property("kvdb.memory.manifest", &manifest_bytes);
+    *value = memtable_bytes + buffer_pool_bytes + row_cache_bytes +
+             manifest_bytes;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Every integer property as a decimal string, and:
+//   kvdb.sstables               one line per SST, oldest first
+//   kvdb.levelstats             file count and bytes per level
+//   kvdb.write-amplification    SST bytes written per user byte written
+//   kvdb.read-amplification     SST bytes read from disk per user byte read
+//   kvdb.space-amplification    SST bytes per byte of estimated live data
+//   kvdb.stats                  all of the above
+// Amplification is measured since the database was opened. Return false for
+// an unknown property.
+bool DB::get_property(string property, string* value) {
+  uint64_t int_value;
+  if (get_int_property(property, &int_value)) {
+    *value = to_string(int_value);
+    return true;
   }
 
-  // Sort by creation time
-  sort(begin(sst_name_createtime), end(sst_name_createtime),
-       [](const pair<string, struct timespec>& lhs,
-          const pair<string, struct timespec>& rhs) {
-         struct timespec sst1_ctime = lhs.second;
-         struct timespec sst2_ctime = rhs.second;
+  ostringstream out;
+  StatisticsReport report;
+  if (property == "kvdb.write-amplification" ||
+      property == "kvdb.read-amplification" || property == "kvdb.stats") {
+    report = statistics->report();
+  }
+  auto ratio = [](uint64_t a, uint64_t b) {
+    return b == 0 ? 0.0 : (double)a / b;
+  };
+  out.setf(ios::fixed);
+  out.precision(2);
 
-         return sst1_ctime.tv_sec == sst2_ctime.tv_sec
-                    ? sst1_ctime.tv_nsec < sst2_ctime.tv_nsec
-                    : sst1_ctime.tv_sec < sst2_ctime.tv_sec;  // Ascending order
-       });
+  shared_ptr<Version> version = acquire_version();
+  if (property == "kvdb.sstables") {
+    out << "file level entries deletions bytes min_key max_key max_sequence\n";
+    for (auto& sst : version->files) {
+      const FileMeta& file = sst->meta;
+      out << file.number << SST_EXTENSION << " " << file.level << " "
+          << file.num_entries << " " << file.num_deletions << " "
+          << file.file_size << " " << file.min_key << " " << file.max_key
+          << " " << file.max_sequence << "\n";
+    }
+  } else if (property == "kvdb.levelstats") {
+    map<int, pair<uint64_t, uint64_t>> levels;  // level -> (files, bytes)
+    for (auto& file : version->files) {
+      levels[file->meta.level].first++;
+      levels[file->meta.level].second += file->meta.file_size;
+    }
+    out << "level files bytes\n";
+    for (auto& level : levels) {
+      out << level.first << " " << level.second.first << " "
+          << level.second.second << "\n";
+    }
+  } else if (property == "kvdb.write-amplification") {
+    out << ratio(report.tickers[SST_BYTES_WRITTEN],
+                 report.tickers[USER_BYTES_WRITTEN]);
+  } else if (property == "kvdb.read-amplification") {
+    out << ratio(report.tickers[SST_BYTES_READ],
+                 report.tickers[USER_BYTES_READ]);
+  } else if (property == "kvdb.space-amplification") {
+    uint64_t sst_bytes;
+    get_int_property("kvdb.total-sst-bytes", &sst_bytes);
+    out << ratio(sst_bytes, version->estimate_live_keys() * KV_BYTES);
+  } else if (property == "kvdb.stats") {
+    const char* names[] = {
+        "kvdb.num-files",           "kvdb.total-sst-bytes",
+        "kvdb.num-entries-memtable", "kvdb.estimate-num-keys",
+        "kvdb.write-amplification", "kvdb.read-amplification",
+        "kvdb.space-amplification", "kvdb.memory.memtable",
+        "kvdb.memory.buffer-pool",  "kvdb.memory.row-cache",
+        "kvdb.memory.manifest",     "kvdb.memory.total"};
+    for (const char* name : names) {
+      string name_value;
+      get_property(name, &name_value);
+      out << name << ": " << name_value << "\n";
+    }
+    string levelstats;
+    get_property("kvdb.levelstats", &levelstats);
+    out << levelstats;
+  } else {
+    return false;
+  }
+  *value = out.str();
+  return true;
+}
 
-  for (auto pair : sst_name_createtime) {
-    sst_names.push_back(pair.first);
+uint64_t count_deletions(const vector<KVPair>& kvpairs) {
+  uint64_t deletions = 0;
+  for (auto& kvpair : kvpairs) {
+    deletions += kvpair.value == TOMBSTONE;
   }
+  return deletions;
 }
 
-void DB::resize_bp_dir(int new_capacity) { buffer_pool->resize(new_capacity); }
+// The distinct keys of pairs grouped by key
+size_t count_keys(const vector<KVPair>& kvpairs) {
+  size_t keys = 0;
+  for (size_t i = 0; i < kvpairs.size(); i++) {
+    keys += i == 0 || kvpairs[i].key != kvpairs[i - 1].key;
+  }
+  return keys;
+}
 
-// Taken from https://stackoverflow.com/a/19841704/10254049
-bool is_file_exists(string fileName) {
-  std::ifstream infile(fileName);
-  return infile.good();
+uint64_t file_size(string filename) {
+  struct stat statbuf;
+  if (stat(filename.c_str(), &statbuf) == -1) {
+    perror("stat");
+    return 0;
+  }
+  return statbuf.st_size;
+}
+
+// Make the files just created or linked in a directory durable, before a
+// manifest edit names them
+bool sync_directory(string dir) {
+  int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    perror("open");
+    return false;
+  }
+  bool synced = fsync(fd) == 0;
+  if (!synced) {
+    perror("fsync");
+  }
+  ::close(fd);
+  return synced;
+}
+
+// The key range and entries of an SST built by an SSTWriter, from its page
+// summaries: every pair a value at sequence 0, its key in no other pair, and
+// the pages in key order. False if it isn't one.
+bool ingestible(const string& path, FileMeta* file) {
+  vector<PageSummary> summaries;
+  if (!sst_has_summaries(path) || !read_page_summaries(path, &summaries)) {
+    fprintf(stderr, "ERROR: %s is not an SST\n", path.c_str());
+    return false;
+  }
+  bool built = true;
+  file->num_entries = 0;
+  file->num_deletions = 0;
+  for (size_t i = 0; i < summaries.size(); i++) {
+    const PageSummary& summary = summaries[i];
+    if (summary.count == 0) {
+      // Only the last page may hold nothing but the pair ending the file
+      built &= i > 0 && i + 1 == summaries.size() &&
+               summary.min_key == MAX_KEY;
+      continue;
+    }
+    built &= summary.flags == PAGE_DISTINCT && summary.max_sequence == 0 &&
+             summary.max_value < TOMBSTONE &&
+             (i == 0 || summaries[i - 1].max_key < summary.min_key);
+    file->num_entries += summary.count;
+    file->max_key = summary.max_key;
+  }
+  if (!built || file->num_entries == 0) {
+    fprintf(stderr, "ERROR: %s was not built by an SSTWriter\n", path.c_str());
+    return false;
+  }
+  file->min_key = summaries.front().min_key;
+  return true;
+}
+
+// The page summaries of an SST, read on first use. Empty if they can't be.
+const vector<PageSummary>& page_summaries(SSTFile& file) {
+  call_once(file.summaries_read, [&file]() {
+    if (!read_page_summaries(file.path, &file.summaries)) {
+      file.summaries.clear();
+    }
+  });
+  return file.summaries;
+}
+
+// Whether a page's summary aggregates what a read at sequence sees of the
+// page's keys: the page holds one value for each, and no other write to them
+// is left anywhere else, including range deletions
+bool summary_usable(const PageSummary& summary, const SSTFile& file,
+                    const Version& version,
+                    const vector<uint64_t>& memtable_keys,
+                    const vector<RangeTombstone>& tombstones,
+                    uint64_t sequence) {
+  if (!(summary.flags & PAGE_DISTINCT) || summary.max_sequence > sequence) {
+    return false;
+  }
+  auto it = lower_bound(memtable_keys.begin(), memtable_keys.end(),
+                        summary.min_key);
+  if (it != memtable_keys.end() && *it <= summary.max_key) {
+    return false;
+  }
+  for (auto& other : version.files) {
+    if (other.get() != &file && other->meta.min_key <= summary.max_key &&
+        summary.min_key <= other->meta.max_key) {
+      return false;
+    }
+  }
+  for (auto& tombstone : tombstones) {
+    if (tombstone.seq <= sequence && tombstone.start <= summary.max_key &&
+        summary.min_key <= tombstone.end) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Whether a filtered scan can leave out page i of SST f without changing what
+// the other writes to the page's keys read. Newer writes hide the page's
+// writes anyway, except for merge operands, which merge into them. Older
+// writes, in an older SST or the next page, could be hidden by them.
+bool page_skippable(const vector<PageSummary>& summaries, size_t i,
+                    const Version& version, size_t f,
+                    const vector<uint64_t>& operand_keys) {
+  const PageSummary& summary = summaries[i];
+  if ((summary.flags & PAGE_OPERANDS) ||
+      (i > 0 && summaries[i - 1].max_key == summary.min_key) ||
+      (i + 1 < summaries.size() && summaries[i + 1].min_key == summary.max_key)) {
+    return false;
+  }
+  auto it = lower_bound(operand_keys.begin(), operand_keys.end(),
+                        summary.min_key);
+  if (it != operand_keys.end() && *it <= summary.max_key) {
+    return false;
+  }
+  for (size_t j = 0; j < version.files.size(); j++) {
+    const FileMeta& meta = version.files[j]->meta;
+    if (j == f || meta.min_key > summary.max_key ||
+        summary.min_key > meta.max_key) {
+      continue;
+    }
+    if (j < f) {
+      return false;
+    }
+    // A newer SST may hold operands in pages overlapping this one
+    const vector<PageSummary>& newer = page_summaries(*version.files[j]);
+    if (newer.empty()) {
+      return false;
+    }
+    for (auto& page : newer) {
+      if ((page.flags & PAGE_OPERANDS) && page.min_key <= summary.max_key &&
+          summary.min_key <= page.max_key) {
+        return false;
+      }
+    }
+  }
+  return true;
 }
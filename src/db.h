@@ -3,46 +3,177 @@
 
 #include <string.h>
 #include <dirent.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include "avl_tree.h"
+#include "io_service.h"
+#include "task.h"
 #include "sst.h"
 #include "buffer_pool.h"
+#include "manifest.h"
+#include "merge_operator.h"
+#include "row_cache.h"
+#include "statistics.h"
+#include "trace.h"
+#include "version.h"
 
 using namespace std;
 
 const int DEFAULT_MEMTABLE_SIZE = 100;
 const int VERBOSE = 0;
+const int BP_PREFETCH_THREADS = 4; // Threads warming the buffer pool after a restart
+const size_t MAX_WRITE_BATCH = 64; // Most queued writes one leader applies at a time
 
+// Kinds of queued write
+#define WRITE_VALUE 0
+#define WRITE_OPERAND 1
+#define WRITE_RANGE_DELETE 2 // key to value
+#define WRITE_INGEST 3 // files
+
+// Aggregates DB::aggregate computes over the newest values in a key range
+#define AGGREGATE_COUNT 0
+#define AGGREGATE_SUM 1 // Wrapping around
+#define AGGREGATE_MIN 2
+#define AGGREGATE_MAX 3
+
+// A consistent view of the database: reads at a snapshot see the writes with
+// sequence numbers up to its own, whatever is written or compacted after
+struct Snapshot {
+  uint64_t sequence;
+};
+
+// A DB may be used from many threads at once, except for open and close.
+// Reads run in parallel against the current Version. Writes are queued and
+// the writer at the front of the queue applies a batch of them for everyone.
+// A compaction runs alongside both and only locks to install its result.
 struct DB {
 private:
+  struct Writer {
+    uint64_t key;
+    uint64_t value;
+    int type = WRITE_VALUE;
+    const vector<string> *files = NULL;
+    const vector<FileMeta> *file_metas = NULL; // Key ranges and entries of files
+    bool ingested = false;
+    bool done = false;
+    condition_variable *cv = NULL; // Shared by the writes one thread queued together
+  };
+
   uint64_t binary_search(vector<KVPair>, uint64_t);
-  void reopen_ssts_by_age(string, DIR*);
-  string get_sst_filename();
+  bool import_legacy_db(string, int);
+  string sst_path(int);
+  void write(uint64_t key, uint64_t value, int type = WRITE_VALUE);
+  void write(Writer *group, size_t n);
+  void apply_batch(const vector<Writer *> &batch);
+  bool ingest(const vector<string> &paths, const vector<FileMeta> &file_metas);
+  uint64_t lookup(uint64_t key, uint64_t snapshot);
+  bool lookup_in_memory(const shared_ptr<Version> &version, uint64_t key,
+                        uint64_t snapshot, MergeChain *chain);
+  void cache_row(const shared_ptr<Version> &version, uint64_t key, bool found, uint64_t value);
+  typedef function<bool(const vector<PageSummary> &, size_t)> PageFilter;
+  vector<KVPair> scan_pages(SSTFile &file, uint64_t key1, uint64_t key2,
+                            const PageFilter &skip);
+  unique_ptr<SSTCursor> page_cursor(SSTFile &file, uint64_t key1,
+                                    uint64_t key2, const PageFilter &skip);
+  shared_ptr<Version> acquire_version();
+  bool flush_memtable();
+  void maybe_schedule_compaction();
+  void delete_unlisted_ssts();
+  bool upgrade_ssts();
+  vector<uint64_t> live_snapshots();
+  void trace(uint32_t op, uint64_t key, uint64_t arg);
+  void save_buffer_pool_state();
+  void start_prefetch();
+
+  shared_ptr<Version> current;
+  shared_mutex version_lock;  // Guards current
+  shared_mutex memtable_lock; // Held exclusively while the memtable is written
+  mutex manifest_lock;        // Held to change the file list, manifest or metadata.next_sst_id
+  mutex compaction_lock;      // One compaction at a time
+  thread compaction_thread;   // Last compaction started by a flush
+  atomic<bool> compaction_scheduled{false};
+  multiset<uint64_t> snapshots; // Sequence numbers of the snapshots not yet released
+  mutex snapshots_lock;
+  deque<Writer *> writers;    // Waiting writes, the leader first
+  mutex writers_lock;
+  shared_ptr<TraceWriter> tracer; // NULL unless a trace is being recorded
+  atomic<bool> tracing{false};
+
+  IOService *io_service;      // Reads pages for get_async and scan_async
+  InlineExecutor inline_executor;
+
+  vector<thread> prefetch_threads;
+  atomic<bool> stop_prefetch{false};
 
 public:
-  // Any DB information that needs to be persisted when DB is closed belongs in the Metadata struct
-  struct Metadata {
-    int memtable_size;  // Maximum number of KV pairs in a memtable
-    int next_sst_id;    // The ID of the next SST that will be created (used in making unique names)
-    int num_elems; // Number of elements currently in the DB
-  };
   Metadata metadata;
+  Manifest manifest;
   BufferPool *buffer_pool;
+  RowCache *row_cache; // NULL when the row cache is disabled
+  Statistics *statistics;
   string name;
   vector<string> sst_names;
-  Tree *memtable;
+  int compaction_trigger = 0; // Compact once a flush leaves this many level 0 SSTs, 0 for never
+  MergeOperator *merge_operator = &ADD_OPERATOR; // Folds merge operands, the same one every time a DB is opened
   bool open(
       string db_name, int memtable_size = DEFAULT_MEMTABLE_SIZE,
-      int bp_policy = CLOCK);  // Open a new or existing database
+      int bp_policy = CLOCK,
+      size_t bp_bytes = DEFAULT_BUFFER_POOL_BYTES,
+      size_t row_cache_bytes = 0);  // Open a new or existing database
   bool close(); // Close the database
   void put(uint64_t key, uint64_t value); // Put a key value pair in the database
-  uint64_t get(uint64_t key); // Get the value for key and pass it to ptr
+  uint64_t get(uint64_t key, const Snapshot *snapshot = NULL); // Get the value for key and pass it to ptr
   void del(uint64_t key);
-  vector<KVPair> scan(uint64_t key1, uint64_t key2);
-  void resize_bp_dir(int);
+  // Put the pairs in order, deleting the keys whose value is TOMBSTONE. They
+  // are queued at once, so a leader applies them in as few batches as it can.
+  void write_batch(const vector<KVPair> &kvpairs);
+  void del_range(uint64_t key1, uint64_t key2); // Delete every key from key1 to key2 inclusive
+  void merge(uint64_t key, uint64_t operand); // Merge operand into the value of key with merge_operator, below TOMBSTONE
+  // Add SSTs built by SSTWriter, as if their pairs were put at once after
+  // every write before. False if one can't be read or their key ranges overlap.
+  bool ingest_files(const vector<string> &paths);
+  // Sorted by key, descending if reverse. With a limit only that many keys
+  // are returned, the lowest or with reverse the highest.
+  vector<KVPair> scan(uint64_t key1, uint64_t key2, const Snapshot *snapshot = NULL,
+                      size_t limit = SIZE_MAX, bool reverse = false);
+  // Like scan, keeping only the values the predicate matches. SST pages whose
+  // values it can't match are mostly left unread.
+  vector<KVPair> scan_filtered(uint64_t key1, uint64_t key2, ValuePredicate predicate,
+                               const Snapshot *snapshot = NULL);
+  // One of the AGGREGATE_ ops over the values scan would return, without
+  // building them. MIN and MAX throw KeyException for an empty range.
+  uint64_t aggregate(uint64_t key1, uint64_t key2, int op, const Snapshot *snapshot = NULL);
+  // Like get and scan, but the task suspends instead of blocking while a page
+  // is read from disk, and resumes on the executor, by default the I/O thread
+  // that read it. Every task must finish before close.
+  Task<uint64_t> get_async(uint64_t key, Executor *executor = NULL,
+                           const Snapshot *snapshot = NULL);
+  Task<vector<KVPair>> scan_async(uint64_t key1, uint64_t key2,
+                                  Executor *executor = NULL,
+                                  const Snapshot *snapshot = NULL);
+  const Snapshot *get_snapshot(); // Pass to release_snapshot when done with it
+  void release_snapshot(const Snapshot *snapshot);
+  void resize_buffer_pool(size_t bytes); // Returns at once, a shrink finishes over later operations
+  size_t buffer_pool_memory_usage();
+  void wait_for_prefetch(); // Block until the buffer pool warm-up started by open is done
+  StatisticsReport get_statistics(); // Latency histograms of operations since open
+  bool get_property(string property, string *value); // Introspection, see db.cpp for the names
+  bool get_int_property(string property, uint64_t *value);
+  bool start_trace(string filename); // Record every put, get, del and scan to a file
+  bool end_trace();
+  bool compact(); // Merge every SST into one, dropping overwritten and deleted pairs
 };
 
-const string METADATA_FILE = "metadata";
+const string METADATA_FILE = "metadata"; // Only read when upgrading a DB that predates the manifest
+const string BUFFER_POOL_STATE_FILE = "bp_state"; // Pages cached at close, hottest first
 
 #endif
@@ -0,0 +1,62 @@
+#include "io_service.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace std;
+
+void PageRead::await_suspend(coroutine_handle<> handle) {
+  this->handle = handle;
+  io->submit(this);
+}
+
+IOService::IOService(int num_threads) : num_threads(num_threads) {}
+
+IOService::~IOService() {
+  {
+    lock_guard<mutex> guard(lock);
+    stopping = true;
+  }
+  cv.notify_all();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void IOService::submit(PageRead* read) {
+  {
+    lock_guard<mutex> guard(lock);
+    if (threads.empty()) {
+      for (int i = 0; i < num_threads; i++) {
+        threads.push_back(thread(&IOService::run, this));
+      }
+    }
+    queue.push_back(read);
+  }
+  cv.notify_one();
+}
+
+void IOService::run() {
+  while (true) {
+    PageRead* read;
+    {
+      unique_lock<mutex> guard(lock);
+      cv.wait(guard, [this]() { return stopping || !queue.empty(); });
+      if (queue.empty()) {
+        return;
+      }
+      read = queue.front();
+      queue.pop_front();
+    }
+    ssize_t bytes;
+    do {
+      bytes = pread(read->fd, read->buff, read->size, read->offset);
+    } while (bytes == -1 && errno == EINTR);
+    if (bytes == -1) {
+      perror("pread");
+    }
+    read->bytes = bytes;
+    read->executor->schedule(read->handle);
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef _IO_SERVICE_H
+#define _IO_SERVICE_H
+
+#include <sys/types.h>
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "task.h"
+
+struct IOService;
+
+// Awaiting a PageRead suspends the coroutine until the read is done, then
+// resumes it on its executor with the bytes read, or -1
+struct PageRead {
+  IOService *io;
+  Executor *executor;
+  int fd;
+  void *buff;
+  size_t size;
+  off_t offset;
+  ssize_t bytes = -1;
+  std::coroutine_handle<> handle;
+
+  bool await_ready() { return false; }
+  void await_suspend(std::coroutine_handle<> handle);
+  ssize_t await_resume() { return bytes; }
+};
+
+// Runs the reads that coroutines wait on. Submitting never blocks; a few
+// threads issue the preads and hand each finished read to the executor of the
+// coroutine waiting on it. The threads start with the first read.
+struct IOService {
+private:
+  int num_threads;
+  std::vector<std::thread> threads;
+  std::deque<PageRead *> queue;
+  std::mutex lock;
+  std::condition_variable cv;
+  bool stopping = false;
+
+  void run();
+
+public:
+  IOService(int num_threads);
+  ~IOService();  // Waits for the reads already submitted
+  void submit(PageRead *read);
+};
+
+const int DEFAULT_IO_THREADS = 4;
+
+#endif
@@ -0,0 +1,173 @@
+#include "kv_client.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+bool KVClient::connect(string host, int port) {
+  addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addrs;
+  int err = getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &addrs);
+  if (err != 0) {
+    fprintf(stderr, "ERROR: Could not resolve %s. %s\n", host.c_str(),
+            gai_strerror(err));
+    return false;
+  }
+  fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 || ::connect(fd, addrs->ai_addr, addrs->ai_addrlen) == -1) {
+    fprintf(stderr, "ERROR: Could not connect to %s:%d. %s\n", host.c_str(),
+            port, strerror(errno));
+    freeaddrinfo(addrs);
+    close();
+    return false;
+  }
+  freeaddrinfo(addrs);
+  int on = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  return true;
+}
+
+void KVClient::close() {
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+  out.clear();
+  in.clear();
+  pending.clear();
+}
+
+void KVClient::send(const Request& request) {
+  encode_request(request, &out);
+  pending.push_back(request.op);
+}
+
+bool KVClient::flush() {
+  size_t written = 0;
+  while (written < out.size()) {
+    ssize_t n = ::send(fd, out.data() + written, out.size() - written,
+                       MSG_NOSIGNAL);
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("send");
+      return false;
+    }
+    written += n;
+  }
+  out.clear();
+  return true;
+}
+
+bool KVClient::receive(Response* response) {
+  if (pending.empty() || !flush()) {
+    return false;
+  }
+  char buff[1 << 16];
+  while (true) {
+    long size = decode_response(pending.front(), in.data(), in.size(), response);
+    if (size < 0) {
+      fprintf(stderr, "ERROR: Malformed response from server.\n");
+      return false;
+    }
+    if (size > 0) {
+      in.erase(0, size);
+      pending.pop_front();
+      return response->status == PROTO_OK;
+    }
+    ssize_t n = read(fd, buff, sizeof(buff));
+    if (n == 0) {
+      fprintf(stderr, "ERROR: Server closed the connection.\n");
+      return false;
+    }
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("read");
+      return false;
+    }
+    in.append(buff, n);
+  }
+}
+
+bool KVClient::call(const Request& request, Response* response) {
+  send(request);
+  return receive(response);
+}
+
+bool KVClient::put(uint64_t key, uint64_t value) {
+  return multi_put({{key, value}});
+}
+
+bool KVClient::get(uint64_t key, uint64_t* value, bool* found) {
+  vector<uint64_t> values;
+  vector<uint8_t> founds;
+  if (!multi_get({key}, &values, &founds)) {
+    return false;
+  }
+  *value = values[0];
+  *found = founds[0];
+  return true;
+}
+
+bool KVClient::del(uint64_t key) { return multi_del({key}); }
+
+// Servers return at most MAX_SCAN_RESULTS pairs per request, so longer scans
+// take several
+bool KVClient::scan(uint64_t key1, uint64_t key2, vector<KVPair>* kvpairs) {
+  kvpairs->clear();
+  while (true) {
+    Request request = {PROTO_SCAN, {key1}, {key2}};
+    Response response;
+    if (!call(request, &response)) {
+      return false;
+    }
+    for (size_t i = 0; i < response.keys.size(); i++) {
+      kvpairs->push_back({response.keys[i], response.values[i]});
+    }
+    if (response.keys.size() < MAX_SCAN_RESULTS ||
+        response.keys.back() >= key2) {
+      return true;
+    }
+    key1 = response.keys.back() + 1;
+  }
+}
+
+bool KVClient::multi_put(const vector<KVPair>& kvpairs) {
+  Request request = {PROTO_PUT, {}, {}};
+  for (auto& kvpair : kvpairs) {
+    request.keys.push_back(kvpair.key);
+    request.values.push_back(kvpair.value);
+  }
+  Response response;
+  return call(request, &response);
+}
+
+bool KVClient::multi_get(const vector<uint64_t>& keys, vector<uint64_t>* values,
+                         vector<uint8_t>* found) {
+  Request request = {PROTO_GET, keys, {}};
+  Response response;
+  if (!call(request, &response) || response.values.size() != keys.size()) {
+    return false;
+  }
+  *values = response.values;
+  *found = response.found;
+  return true;
+}
+
+bool KVClient::multi_del(const vector<uint64_t>& keys) {
+  Request request = {PROTO_DEL, keys, {}};
+  Response response;
+  return call(request, &response);
+}
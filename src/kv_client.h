@@ -0,0 +1,43 @@
+#ifndef _KV_CLIENT_H
+#define _KV_CLIENT_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "kvpair.h"
+#include "protocol.h"
+
+// A connection to a KVServer. The calls below each wait for their response.
+// To pipeline, queue requests with send and read their responses in order
+// with receive; any number may be in flight. A connection is used by one
+// thread at a time. Every call returns false if the connection failed.
+struct KVClient {
+private:
+  int fd = -1;
+  std::string out;              // Requests not yet written
+  std::string in;               // Bytes read but not yet decoded
+  std::deque<uint8_t> pending;  // Ops of the requests awaiting a response
+
+  bool call(const Request &request, Response *response);
+
+public:
+  bool connect(std::string host, int port);
+  void close();
+  void send(const Request &request);
+  bool flush();  // Write the requests queued by send
+  bool receive(Response *response);  // Flushes first
+  size_t in_flight() { return pending.size(); }
+
+  bool put(uint64_t key, uint64_t value);
+  bool get(uint64_t key, uint64_t *value, bool *found);
+  bool del(uint64_t key);
+  bool scan(uint64_t key1, uint64_t key2, std::vector<KVPair> *kvpairs);
+  bool multi_put(const std::vector<KVPair> &kvpairs);
+  bool multi_get(const std::vector<uint64_t> &keys,
+                 std::vector<uint64_t> *values, std::vector<uint8_t> *found);
+  bool multi_del(const std::vector<uint64_t> &keys);
+};
+
+#endif
@@ -3,8 +3,12 @@
 #include <algorithm>
 #include <vector>
 
+#include "merge_operator.h"
+
 using namespace std;
 
+// Merge two sorted runs, kvps1 being the newer. Where both hold a key the pair
+// from kvps1 wins. Tombstones are dropped with the pairs they hide.
 vector<KVPair> merge(vector<KVPair> kvps1, vector<KVPair> kvps2) {
   vector<KVPair> merged;
 
@@ -12,14 +16,20 @@ vector<KVPair> merge(vector<KVPair> kvps1, vector<KVPair> kvps2) {
   auto it2 = kvps2.begin();
 
   while (it1 != kvps1.end() && it2 != kvps2.end()) {
-    if (it1->key < it2->key && it1->value != TOMBSTONE) {
-      merged.push_back(*it1);
+    if (it1->key < it2->key) {
+      if (it1->value != TOMBSTONE) {
+        merged.push_back(*it1);
+      }
       ++it1;
-    } else if (it2->key < it1->key && it2->value != TOMBSTONE) {
-      merged.push_back(*it2);
+    } else if (it2->key < it1->key) {
+      if (it2->value != TOMBSTONE) {
+        merged.push_back(*it2);
+      }
       ++it2;
-    } else if (it1->value != TOMBSTONE) {
-      merged.push_back(*it1);
+    } else {
+      if (it1->value != TOMBSTONE) {
+        merged.push_back(*it1);
+      }
       ++it1;
       ++it2;
     }
@@ -41,3 +51,187 @@ vector<KVPair> merge(vector<KVPair> kvps1, vector<KVPair> kvps2) {
 
   return merged;
 }
+
+bool storage_order(const KVPair& a, const KVPair& b) {
+  return a.key < b.key || (a.key == b.key && a.sequence() > b.sequence());
+}
+
+bool reverse_storage_order(const KVPair& a, const KVPair& b) {
+  return a.key > b.key || (a.key == b.key && a.sequence() > b.sequence());
+}
+
+// Whether a pair sorts before the newest write to key that a read at snapshot
+// can see
+bool precedes(const KVPair& pair, uint64_t key, uint64_t snapshot) {
+  return pair.key < key || (pair.key == key && pair.sequence() > snapshot);
+}
+
+// Drop the pairs no read can see from a run in storage order. A pair is kept
+// if it is the newest write to its key, or the newest one visible at one of the
+// snapshots (sorted ascending). A kept merge operand needs the writes below it
+// up to the next kept pair; op merges them into it, and without op they are
+// kept too. Tombstones can be dropped when no older pair of the key is left
+// anywhere for them to hide, and operands are then merged onto nothing.
+vector<KVPair> drop_hidden(const vector<KVPair>& kvpairs,
+                           const vector<uint64_t>& snapshots,
+                           bool drop_tombstones, MergeOperator* op) {
+  vector<KVPair> kept;
+  size_t i = 0;
+  while (i < kvpairs.size()) {
+    size_t first_kept = kept.size();
+    uint64_t key = kvpairs[i].key;
+    uint64_t newer_seq = MAX_SEQUENCE;
+    bool open = false;  // The last kept pair is an operand needing older writes
+    for (bool newest = true; i < kvpairs.size() && kvpairs[i].key == key;
+         i++, newest = false) {
+      const KVPair& pair = kvpairs[i];
+      // Snapshots in [seq, newer_seq) read this pair
+      auto snapshot =
+          lower_bound(snapshots.begin(), snapshots.end(), pair.sequence());
+      bool read =
+          newest || (snapshot != snapshots.end() && *snapshot < newer_seq);
+      newer_seq = pair.sequence();
+      if (read || (open && op == NULL)) {
+        kept.push_back(pair);
+        open = pair.is_operand();
+      } else if (open) {
+        KVPair& merged = kept.back();
+        if (pair.value != TOMBSTONE) {
+          merged.value = op->merge(pair.value, merged.value);
+        }
+        if (!pair.is_operand()) {
+          merged.seq = merged.sequence();
+          open = false;
+        }
+      }
+    }
+    while (drop_tombstones && kept.size() > first_kept &&
+           kept.back().value == TOMBSTONE) {
+      kept.pop_back();
+    }
+    if (drop_tombstones && kept.size() > first_kept) {
+      kept.back().seq = kept.back().sequence();
+    }
+  }
+  return kept;
+}
+
+// What a read at snapshot sees of a run in storage order: for each key, the
+// newest visible pair merged with the operands above it, unless the key has
+// no value then
+vector<KVPair> visible_at(const vector<KVPair>& kvpairs, uint64_t snapshot,
+                          MergeOperator* op) {
+  vector<KVPair> visible;
+  size_t i = 0;
+  while (i < kvpairs.size()) {
+    uint64_t key = kvpairs[i].key;
+    uint64_t seq = 0;
+    MergeChain chain(op);
+    bool settled = false;
+    for (; i < kvpairs.size() && kvpairs[i].key == key; i++) {
+      if (settled || kvpairs[i].sequence() > snapshot) {
+        continue;
+      }
+      if (!chain.found) {
+        seq = kvpairs[i].sequence();
+      }
+      settled = chain.add(kvpairs[i].value, kvpairs[i].is_operand());
+    }
+    if (chain.found) {
+      visible.push_back({key, chain.value, seq});
+    }
+  }
+  return visible;
+}
+
+// The seq of the newest range tombstone covering key that a read at snapshot
+// sees, 0 if there is none. Writes to key older than it are deleted.
+uint64_t deleted_at(const vector<RangeTombstone>& tombstones, uint64_t key,
+                    uint64_t snapshot) {
+  uint64_t seq = 0;
+  for (auto& tombstone : tombstones) {
+    if (tombstone.start <= key && key <= tombstone.end &&
+        tombstone.seq <= snapshot) {
+      seq = max(seq, tombstone.seq);
+    }
+  }
+  return seq;
+}
+
+// Whether a range tombstone that a read at snapshot sees deletes every write
+// to [start, end] with a seq up to max_seq, as when it covers a whole SST
+bool range_deleted(const vector<RangeTombstone>& tombstones, uint64_t start,
+                   uint64_t end, uint64_t max_seq, uint64_t snapshot) {
+  for (auto& tombstone : tombstones) {
+    if (tombstone.start <= start && end <= tombstone.end &&
+        max_seq < tombstone.seq && tombstone.seq <= snapshot) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Turn the pairs that the range tombstones a read at snapshot sees have
+// deleted into point tombstones, so visible_at skips them
+void apply_range_tombstones(vector<KVPair>& kvpairs,
+                            const vector<RangeTombstone>& tombstones,
+                            uint64_t snapshot) {
+  if (tombstones.empty()) {
+    return;
+  }
+  for (auto& kvpair : kvpairs) {
+    if (kvpair.sequence() < deleted_at(tombstones, kvpair.key, snapshot)) {
+      kvpair.value = TOMBSTONE;
+      kvpair.seq = kvpair.sequence();
+    }
+  }
+}
+
+// A run in storage order with a point tombstone added for each key a range
+// tombstone deletes writes of, at the range tombstone's seq. drop_hidden can
+// then drop the deleted writes like any others, keeping the ones snapshots
+// older than the range tombstone still read.
+vector<KVPair> with_point_tombstones(const vector<KVPair>& kvpairs,
+                                     const vector<RangeTombstone>& tombstones) {
+  vector<KVPair> output;
+  size_t i = 0;
+  while (i < kvpairs.size()) {
+    size_t first = i;
+    uint64_t key = kvpairs[i].key;
+    uint64_t oldest = kvpairs[i].sequence();
+    for (; i < kvpairs.size() && kvpairs[i].key == key; i++) {
+      oldest = min(oldest, kvpairs[i].sequence());
+    }
+    size_t first_added = output.size();
+    for (auto& tombstone : tombstones) {
+      if (tombstone.start <= key && key <= tombstone.end &&
+          tombstone.seq > oldest) {
+        output.push_back({key, TOMBSTONE, tombstone.seq});
+      }
+    }
+    output.insert(output.end(), kvpairs.begin() + first, kvpairs.begin() + i);
+    if (output.size() - first_added > i - first) {
+      sort(output.begin() + first_added, output.end(), storage_order);
+    }
+  }
+  return output;
+}
+
+// The pairs whose values the predicate matches. Without a branch per pair:
+// each pair is copied and only kept if it matches, and one unsigned compare
+// tests both bounds.
+vector<KVPair> filter_values(const vector<KVPair>& kvpairs,
+                             ValuePredicate predicate) {
+  if (predicate.low > predicate.high) {
+    return {};
+  }
+  vector<KVPair> output(kvpairs.size());
+  uint64_t width = predicate.high - predicate.low;
+  size_t kept = 0;
+  for (size_t i = 0; i < kvpairs.size(); i++) {
+    output[kept] = kvpairs[i];
+    kept += kvpairs[i].value - predicate.low <= width;
+  }
+  output.resize(kept);
+  return output;
+}
@@ -4,22 +4,72 @@
 #define MIN_KEY 0
 #define MAX_KEY 0xffffffffffffffff
 #define TOMBSTONE 0xfffffffffffffffe
+#define MAX_SEQUENCE 0xffffffffffffffff // Reads at this sequence see every write
+#define MERGE_OPERAND 0x8000000000000000 // Set in seq when the value is a merge operand
 
-#include <vector>
+#include <cstddef>
 #include <cstdint>
+#include <vector>
 
 class KVPair {
 public:
   uint64_t key;
   uint64_t value;
+  uint64_t seq; // Sequence number of the write, later writes have larger ones
+
+  uint64_t sequence() const { return seq & ~MERGE_OPERAND; }
+  bool is_operand() const { return (seq & MERGE_OPERAND) != 0; }
 
+  // Pairs are compared by key and value only
   bool operator==(const KVPair& other) const {
     return (key == other.key) && (value == other.value);
   }
 };
 
+// Deletes every key in [start, end] written before seq. Reads at a snapshot
+// older than seq still see those writes.
+struct RangeTombstone {
+  uint64_t start;
+  uint64_t end;
+  uint64_t seq;
+};
+
+// Matches the values in [low, high]
+struct ValuePredicate {
+  uint64_t low;
+  uint64_t high;
+};
+
+struct MergeOperator;
+
 std::vector<KVPair> merge(std::vector<KVPair>, std::vector<KVPair>);
 
+// Stored pairs are ordered by key and, within a key, newest first
+bool storage_order(const KVPair& a, const KVPair& b);
+bool reverse_storage_order(const KVPair& a, const KVPair& b);  // Keys descending
+bool precedes(const KVPair& pair, uint64_t key, uint64_t snapshot);
+std::vector<KVPair> drop_hidden(const std::vector<KVPair>& kvpairs,
+                                const std::vector<uint64_t>& snapshots,
+                                bool drop_tombstones,
+                                MergeOperator* op = NULL);
+std::vector<KVPair> visible_at(const std::vector<KVPair>& kvpairs,
+                               uint64_t snapshot, MergeOperator* op = NULL);
+uint64_t deleted_at(const std::vector<RangeTombstone>& tombstones,
+                    uint64_t key, uint64_t snapshot);
+bool range_deleted(const std::vector<RangeTombstone>& tombstones,
+                   uint64_t start, uint64_t end, uint64_t max_seq,
+                   uint64_t snapshot);
+void apply_range_tombstones(std::vector<KVPair>& kvpairs,
+                            const std::vector<RangeTombstone>& tombstones,
+                            uint64_t snapshot);
+std::vector<KVPair> with_point_tombstones(
+    const std::vector<KVPair>& kvpairs,
+    const std::vector<RangeTombstone>& tombstones);
+std::vector<KVPair> filter_values(const std::vector<KVPair>& kvpairs,
+                                  ValuePredicate predicate);
+
+const size_t KV_BYTES = 2 * sizeof(uint64_t); // The key and value a user reads or writes
+
 // Use this reserved pair for indicating NULL and end of block
 const struct KVPair NULL_PAIR = {
   MAX_KEY,
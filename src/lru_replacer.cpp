@@ -18,7 +18,7 @@ LRUReplacer::LRUReplacer() {
   this->size = 0;
 }
 
-int LRUReplacer::evict(KVPair* page) {
+int LRUReplacer::evict(KVPair*& page) {
   if (this->size == 0) {
     return 0;
   }
@@ -70,3 +70,35 @@ int LRUReplacer::record_access(KVPair* page) {
   }
   return 0;
 }
+
+int LRUReplacer::record_cold(KVPair* page) {
+  auto curr = this->head;
+  while (curr != NULL) {
+    if (curr->page == page) {
+      return 0;
+    }
+    curr = curr->next;
+  }
+
+  // The head is the least recently used page and is evicted first
+  auto new_node = LRUReplacer::Node(page);
+  new_node->next = this->head;
+  if (this->size == 0) {
+    this->tail = new_node;
+  } else {
+    this->head->prev = new_node;
+  }
+  this->head = new_node;
+  this->size += 1;
+  return 1;
+}
+
+vector<KVPair*> LRUReplacer::pages_by_hotness() {
+  vector<KVPair*> pages;
+  auto curr = this->tail;
+  for (int i = 0; i < this->size; i++) {
+    pages.push_back(curr->page);
+    curr = curr->prev;
+  }
+  return pages;
+}
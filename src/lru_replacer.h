@@ -21,9 +21,11 @@ struct LRUReplacer : Replacer {
 
   std::shared_ptr<Node_t> Node(KVPair *page);
   LRUReplacer();
-  int evict(KVPair *page);
+  int evict(KVPair *&page);
   int record_access(KVPair *page);
+  int record_cold(KVPair *page);
+  std::vector<KVPair *> pages_by_hotness();
 
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,301 @@
+#include "manifest.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "sst.h"
+
+using namespace std;
+
+string meta_record(Metadata metadata);
+string add_record(FileMeta file);
+string range_record(RangeTombstone tombstone);
+void remove_ranges(vector<RangeTombstone>* tombstones,
+                   const vector<uint64_t>& removed);
+
+// Start an empty manifest for a new database
+bool Manifest::create(string dir, Metadata metadata) {
+  this->dir = dir;
+  this->metadata = metadata;
+  this->files.clear();
+  this->range_tombstones.clear();
+  return checkpoint();
+}
+
+// Rebuild the metadata and live file set by replaying the log
+bool Manifest::recover(string dir) {
+  this->dir = dir;
+  this->files.clear();
+  this->range_tombstones.clear();
+
+  ifstream log(dir + "/" + MANIFEST_FILE);
+  if (!log.good()) {
+    fprintf(stderr, "ERROR: Could not open %s in database %s. %s\n",
+            MANIFEST_FILE.c_str(), dir.c_str(), strerror(errno));
+    return false;
+  }
+
+  bool have_metadata = false;
+  Metadata pending_metadata;
+  bool pending_has_metadata = false;
+  vector<FileMeta> pending_added;
+  vector<int> pending_removed;
+  vector<RangeTombstone> pending_ranges;
+  vector<uint64_t> pending_unranges;
+
+  string line;
+  while (getline(log, line)) {
+    istringstream record(line);
+    string type;
+    record >> type;
+    if (type == "meta") {
+      record >> pending_metadata.memtable_size >> pending_metadata.next_sst_id >>
+          pending_metadata.num_elems >> pending_metadata.last_sequence;
+      pending_has_metadata = !record.fail();
+    } else if (type == "add") {
+      FileMeta file;
+      record >> file.number >> file.level >> file.min_key >> file.max_key >>
+          file.max_sequence;
+      if (!record.fail()) {
+        if (!(record >> file.num_entries >> file.num_deletions >>
+              file.file_size)) {
+          file.num_entries = file.num_deletions = file.file_size = 0;
+        }
+        pending_added.push_back(file);
+      }
+    } else if (type == "remove") {
+      int number;
+      record >> number;
+      if (!record.fail()) {
+        pending_removed.push_back(number);
+      }
+    } else if (type == "range") {
+      RangeTombstone tombstone;
+      record >> tombstone.start >> tombstone.end >> tombstone.seq;
+      if (!record.fail()) {
+        pending_ranges.push_back(tombstone);
+      }
+    } else if (type == "unrange") {
+      uint64_t seq;
+      record >> seq;
+      if (!record.fail()) {
+        pending_unranges.push_back(seq);
+      }
+    } else if (type == "commit") {
+      for (int number : pending_removed) {
+        files.erase(number);
+      }
+      for (auto& file : pending_added) {
+        files[file.number] = file;
+      }
+      remove_ranges(&range_tombstones, pending_unranges);
+      range_tombstones.insert(range_tombstones.end(), pending_ranges.begin(),
+                              pending_ranges.end());
+      if (pending_has_metadata) {
+        this->metadata = pending_metadata;
+        have_metadata = true;
+      }
+      pending_added.clear();
+      pending_removed.clear();
+      pending_ranges.clear();
+      pending_unranges.clear();
+      pending_has_metadata = false;
+      edits_since_checkpoint++;
+    }
+  }
+
+  if (!have_metadata) {
+    fprintf(stderr, "ERROR: %s in database %s has no metadata\n",
+            MANIFEST_FILE.c_str(), dir.c_str());
+    return false;
+  }
+  // Start from a compact log so it doesn't grow across restarts
+  return checkpoint();
+}
+
+// Atomically apply one edit to the log and to the in-memory state
+bool Manifest::log_edit(const vector<FileMeta>& added,
+                        const vector<int>& removed, Metadata metadata,
+                        const vector<RangeTombstone>& added_ranges,
+                        const vector<uint64_t>& removed_ranges) {
+  string records = meta_record(metadata);
+  for (auto& file : added) {
+    records += add_record(file);
+  }
+  for (int number : removed) {
+    records += "remove " + to_string(number) + "\n";
+  }
+  for (auto& tombstone : added_ranges) {
+    records += range_record(tombstone);
+  }
+  for (uint64_t seq : removed_ranges) {
+    records += "unrange " + to_string(seq) + "\n";
+  }
+  records += "commit\n";
+  if (!append(records)) {
+    return false;
+  }
+
+  this->metadata = metadata;
+  for (int number : removed) {
+    files.erase(number);
+  }
+  for (auto& file : added) {
+    files[file.number] = file;
+  }
+  remove_ranges(&range_tombstones, removed_ranges);
+  range_tombstones.insert(range_tombstones.end(), added_ranges.begin(),
+                          added_ranges.end());
+
+  if (++edits_since_checkpoint >= MANIFEST_CHECKPOINT_EDITS) {
+    return checkpoint();
+  }
+  return true;
+}
+
+// Replace the log with a single edit describing the current state. The new
+// log is written to a temporary file and renamed over the old one, so a crash
+// leaves either the old or the new log in place.
+bool Manifest::checkpoint() {
+  string records = meta_record(this->metadata);
+  for (auto& entry : files) {
+    records += add_record(entry.second);
+  }
+  for (auto& tombstone : range_tombstones) {
+    records += range_record(tombstone);
+  }
+  records += "commit\n";
+
+  string tmp_name = dir + "/" + MANIFEST_FILE + ".tmp";
+  int tmp_fd = ::open(tmp_name.c_str(), O_CREAT | O_TRUNC | O_WRONLY,
+                      FILE_PERMISSIONS);
+  if (tmp_fd < 0) {
+    fprintf(stderr, "ERROR: Could not create %s. %s\n", tmp_name.c_str(),
+            strerror(errno));
+    return false;
+  }
+  if (write(tmp_fd, records.c_str(), records.size()) !=
+          (ssize_t)records.size() ||
+      fsync(tmp_fd) == -1) {
+    perror("write");
+    ::close(tmp_fd);
+    return false;
+  }
+  ::close(tmp_fd);
+
+  string manifest_name = dir + "/" + MANIFEST_FILE;
+  if (rename(tmp_name.c_str(), manifest_name.c_str()) == -1) {
+    perror("rename");
+    return false;
+  }
+  // Make the rename itself durable
+  int fd_dir = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd_dir >= 0) {
+    fsync(fd_dir);
+    ::close(fd_dir);
+  }
+
+  edits_since_checkpoint = 0;
+  failed = false;
+  return open_for_append();
+}
+
+void Manifest::close() {
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+bool Manifest::open_for_append() {
+  close();
+  string manifest_name = dir + "/" + MANIFEST_FILE;
+  fd = ::open(manifest_name.c_str(), O_WRONLY | O_APPEND, FILE_PERMISSIONS);
+  if (fd < 0) {
+    fprintf(stderr, "ERROR: Could not open %s. %s\n", manifest_name.c_str(),
+            strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+// Write a whole edit with one call and make it durable before returning. A
+// failed edit is cut off the log, so the next one can't run into it and be
+// read as part of it; when that fails too, edits wait for a checkpoint.
+bool Manifest::append(string records) {
+  if (failed) {
+    fprintf(stderr, "ERROR: %s/%s needs a checkpoint after a failed edit\n",
+            dir.c_str(), MANIFEST_FILE.c_str());
+    return false;
+  }
+  if (fd < 0 && !open_for_append()) {
+    return false;
+  }
+  off_t end = lseek(fd, 0, SEEK_END);
+  if (end == -1) {
+    perror("lseek");
+    return false;
+  }
+  ssize_t bytes = write(fd, records.c_str(), records.size());
+  bool written = bytes == (ssize_t)records.size();
+  if (bytes == -1) {
+    perror("write");
+  } else if (!written) {
+    fprintf(stderr, "ERROR: Short write to %s/%s\n", dir.c_str(),
+            MANIFEST_FILE.c_str());
+  }
+  // After a failed sync it is unknown what reached the disk
+  if (written && fdatasync(fd) == -1) {
+    perror("fdatasync");
+    failed = true;
+    written = false;
+  }
+  if (!written && ftruncate(fd, end) == -1) {
+    perror("ftruncate");
+    failed = true;
+  }
+  return written;
+}
+
+string meta_record(Metadata metadata) {
+  return "meta " + to_string(metadata.memtable_size) + " " +
+         to_string(metadata.next_sst_id) + " " +
+         to_string(metadata.num_elems) + " " +
+         to_string(metadata.last_sequence) + "\n";
+}
+
+string add_record(FileMeta file) {
+  return "add " + to_string(file.number) + " " + to_string(file.level) + " " +
+         to_string(file.min_key) + " " + to_string(file.max_key) + " " +
+         to_string(file.max_sequence) + " " + to_string(file.num_entries) +
+         " " + to_string(file.num_deletions) + " " +
+         to_string(file.file_size) + "\n";
+}
+
+string range_record(RangeTombstone tombstone) {
+  return "range " + to_string(tombstone.start) + " " +
+         to_string(tombstone.end) + " " + to_string(tombstone.seq) + "\n";
+}
+
+void remove_ranges(vector<RangeTombstone>* tombstones,
+                   const vector<uint64_t>& removed) {
+  for (uint64_t seq : removed) {
+    for (auto it = tombstones->begin(); it != tombstones->end(); ++it) {
+      if (it->seq == seq) {
+        tombstones->erase(it);
+        break;
+      }
+    }
+  }
+}
+
+bool manifest_exists(string dir) {
+  struct stat statbuf;
+  return stat((dir + "/" + MANIFEST_FILE).c_str(), &statbuf) == 0;
+}
@@ -0,0 +1,77 @@
+#ifndef _MANIFEST_H
+#define _MANIFEST_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "kvpair.h"
+
+// Any DB information that needs to be persisted when DB is closed belongs in
+// the Metadata struct. It is stored in the manifest.
+struct Metadata {
+  int memtable_size;  // Maximum number of KV pairs in a memtable
+  int next_sst_id;    // The ID of the next SST that will be created (used in making unique names)
+  int num_elems;      // Estimated number of live keys in the SSTs
+  uint64_t last_sequence;  // Sequence number of the most recent write
+};
+
+// What the manifest records about one SST
+struct FileMeta {
+  int number;  // The file is <number>.sst in the DB directory
+  int level;
+  uint64_t min_key;
+  uint64_t max_key;
+  uint64_t max_sequence;  // Sequence number of the newest write in the file
+  uint64_t num_entries;
+  uint64_t num_deletions;  // Entries that are tombstones
+  uint64_t file_size;      // Bytes on disk
+};
+
+// The MANIFEST is an append-only log of edits to the set of live SSTs. Each
+// edit is a group of text records ended by a commit line:
+//
+//   meta <memtable_size> <next_sst_id> <num_elems> <last_sequence>
+//   add <number> <level> <min_key> <max_key> <max_sequence> <num_entries>
+//       <num_deletions> <file_size>
+//   remove <number>
+//   range <start> <end> <seq>
+//   unrange <seq>
+//   commit
+//
+// range and unrange add and drop a range tombstone, identified by its seq.
+// An add record may end after max_sequence, as written before the entry counts
+// and file size were recorded; those are then 0. An edit without its commit
+// line (a write torn by a crash) is ignored. The
+// log is periodically rewritten as a single edit holding the current state,
+// which replaces the old log with an atomic rename.
+struct Manifest {
+  std::string dir;
+  int fd = -1;  // MANIFEST opened for appending, -1 when closed
+  int edits_since_checkpoint = 0;
+  bool failed = false;  // A failed edit may be left in the log, so only a checkpoint appends again
+  Metadata metadata;
+  std::map<int, FileMeta> files;  // Live SSTs by file number, oldest first
+  std::vector<RangeTombstone> range_tombstones;  // Flushed range deletions, oldest first
+
+  bool create(std::string dir, Metadata metadata);
+  bool recover(std::string dir);
+  bool log_edit(const std::vector<FileMeta>& added,
+                const std::vector<int>& removed, Metadata metadata,
+                const std::vector<RangeTombstone>& added_ranges = {},
+                const std::vector<uint64_t>& removed_ranges = {});
+  bool checkpoint();
+  void close();
+
+ private:
+  bool append(std::string records);
+  bool open_for_append();
+};
+
+bool manifest_exists(std::string dir);
+
+const std::string MANIFEST_FILE = "MANIFEST";
+const int MANIFEST_CHECKPOINT_EDITS = 256;  // Rewrite the log after this many edits
+
+#endif
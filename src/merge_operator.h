@@ -0,0 +1,75 @@
+#ifndef _MERGE_OPERATOR_H
+#define _MERGE_OPERATOR_H
+
+#include <algorithm>
+#include <cstdint>
+
+#include "kvpair.h"
+
+// Folds merge operands into a value, see DB::merge. Operands are merged as
+// reads and compactions find them, in no fixed grouping, so merge must be
+// associative. Results must stay below TOMBSTONE.
+struct MergeOperator {
+  virtual ~MergeOperator() {}
+  virtual uint64_t merge(uint64_t older, uint64_t newer) = 0;
+};
+
+const uint64_t MAX_MERGE_VALUE = TOMBSTONE - 1;
+
+// Sums, saturating at MAX_MERGE_VALUE
+struct AddOperator : MergeOperator {
+  uint64_t merge(uint64_t older, uint64_t newer) override {
+    return older > MAX_MERGE_VALUE - newer ? MAX_MERGE_VALUE : older + newer;
+  }
+};
+
+struct MaxOperator : MergeOperator {
+  uint64_t merge(uint64_t older, uint64_t newer) override {
+    return std::max(older, newer);
+  }
+};
+
+struct MinOperator : MergeOperator {
+  uint64_t merge(uint64_t older, uint64_t newer) override {
+    return std::min(older, newer);
+  }
+};
+
+// Bitwise or. A result with the reserved bits set becomes MAX_MERGE_VALUE.
+struct OrOperator : MergeOperator {
+  uint64_t merge(uint64_t older, uint64_t newer) override {
+    return std::min(older | newer, MAX_MERGE_VALUE);
+  }
+};
+
+inline AddOperator ADD_OPERATOR;
+inline MaxOperator MAX_OPERATOR;
+inline MinOperator MIN_OPERATOR;
+inline OrOperator OR_OPERATOR;
+
+// Folds the writes to one key, added newest first as a read finds them, into
+// the value the read returns. Operands are merged until a value or tombstone
+// is found below them; without one they are merged onto nothing. Without an
+// operator, an operand reads like a value.
+struct MergeChain {
+  MergeOperator *op;
+  bool found = false;  // A write was added that wasn't a tombstone
+  uint64_t value = 0;  // Those writes merged
+
+  MergeChain(MergeOperator *op) : op(op) {}
+
+  // Return true once the older writes no longer matter
+  bool add(uint64_t write, bool is_operand) {
+    if (write == TOMBSTONE) {
+      return true;
+    }
+    value = found ? op->merge(write, value) : write;
+    found = true;
+    return !is_operand || op == NULL;
+  }
+
+  // The value read, TOMBSTONE if the key has none
+  uint64_t result() { return found ? value : TOMBSTONE; }
+};
+
+#endif
@@ -0,0 +1,38 @@
+#include "perf_context.h"
+
+#include <string.h>
+
+#include <sstream>
+
+using namespace std;
+
+thread_local int perf_level = PERF_DISABLED;
+thread_local PerfContext perf_context = {};
+
+void set_perf_level(int level) { perf_level = level; }
+
+int get_perf_level() { return perf_level; }
+
+PerfContext* get_perf_context() { return &perf_context; }
+
+void PerfContext::reset() { memset(this, 0, sizeof(PerfContext)); }
+
+string PerfContext::to_string() const {
+  ostringstream out;
+  out << "ssts_probed = " << ssts_probed
+      << ", range_filter_positive = " << range_filter_positive
+      << ", range_filter_negative = " << range_filter_negative
+      << ", row_cache_hits = " << row_cache_hits
+      << ", row_cache_misses = " << row_cache_misses
+      << ", pages_from_pool = " << pages_from_pool
+      << ", pages_from_disk = " << pages_from_disk
+      << ", bytes_read = " << bytes_read
+      << ", key_comparisons = " << key_comparisons
+      << ", pages_summarized = " << pages_summarized
+      << ", pages_filtered = " << pages_filtered
+      << ", memtable_nanos = " << memtable_nanos
+      << ", row_cache_nanos = " << row_cache_nanos
+      << ", sst_nanos = " << sst_nanos
+      << ", page_read_nanos = " << page_read_nanos;
+  return out.str();
+}
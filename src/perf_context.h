@@ -0,0 +1,78 @@
+#ifndef _PERF_CONTEXT_H
+#define _PERF_CONTEXT_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// How much the perf context of a thread collects
+#define PERF_DISABLED 0  // Nothing, the default
+#define PERF_COUNT 1     // Counters only
+#define PERF_TIME 2      // Counters and time spent per stage
+
+// Counters describing the work done by the operations of one thread, used to
+// see why a single get or scan was slow:
+//
+//   set_perf_level(PERF_TIME);
+//   get_perf_context()->reset();
+//   db.get(key);
+//   cout << get_perf_context()->to_string();
+struct PerfContext {
+  uint64_t ssts_probed;            // SSTs searched for a key or range
+  uint64_t range_filter_positive;  // SSTs whose key range may hold the key
+  uint64_t range_filter_negative;  // SSTs skipped because of their key range
+  uint64_t row_cache_hits;
+  uint64_t row_cache_misses;
+  uint64_t pages_from_pool;  // SST pages found in the buffer pool
+  uint64_t pages_from_disk;  // SST pages read with pread
+  uint64_t bytes_read;       // Bytes read from SSTs on disk
+  uint64_t key_comparisons;  // Keys compared while searching SST pages
+  uint64_t pages_summarized; // SST pages an aggregate took from their summaries
+  uint64_t pages_filtered;   // SST pages a filtered scan left out by their values
+
+  // Nanoseconds spent per stage, with PERF_TIME only
+  uint64_t memtable_nanos;
+  uint64_t row_cache_nanos;
+  uint64_t sst_nanos;  // Searching or scanning SSTs, page reads included
+  uint64_t page_read_nanos;
+
+  void reset();
+  std::string to_string() const;
+};
+
+extern thread_local int perf_level;
+extern thread_local PerfContext perf_context;
+
+void set_perf_level(int level);
+int get_perf_level();
+PerfContext* get_perf_context();  // The context of the calling thread
+
+#define PERF_ADD(field, n)              \
+  do {                                  \
+    if (perf_level >= PERF_COUNT) {     \
+      perf_context.field += (n);        \
+    }                                   \
+  } while (0)
+
+// Add the time from construction to destruction to a perf context field when
+// the thread's level is PERF_TIME
+struct PerfTimer {
+  uint64_t* field;
+  std::chrono::steady_clock::time_point start;
+
+  PerfTimer(uint64_t* field)
+      : field(perf_level >= PERF_TIME ? field : NULL) {
+    if (this->field != NULL) {
+      start = std::chrono::steady_clock::now();
+    }
+  }
+  ~PerfTimer() {
+    if (field != NULL) {
+      *field += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include "protocol.h"
+
+#include <string.h>
+
+#include "kvpair.h"
+
+using namespace std;
+
+void append_bytes(string *out, const void *data, size_t size) {
+  out->append((const char *)data, size);
+}
+
+template <typename T>
+void append_int(string *out, T value) {
+  append_bytes(out, &value, sizeof(value));
+}
+
+// Reads integers from a frame body, failing once the body runs out
+struct BodyReader {
+  const char *next;
+  const char *end;
+
+  template <typename T>
+  bool read(T *value) {
+    if ((size_t)(end - next) < sizeof(T)) {
+      return false;
+    }
+    memcpy(value, next, sizeof(T));
+    next += sizeof(T);
+    return true;
+  }
+};
+
+// Append the header of a frame whose body is written after it, and return
+// where the header is so its length can be filled in
+size_t begin_frame(string *out) {
+  size_t start = out->size();
+  append_int<uint32_t>(out, 0);
+  return start;
+}
+
+void end_frame(string *out, size_t start) {
+  uint32_t length = out->size() - start - FRAME_HEADER_BYTES;
+  memcpy(&(*out)[start], &length, sizeof(length));
+}
+
+void encode_request(const Request &request, string *out) {
+  size_t start = begin_frame(out);
+  append_int<uint8_t>(out, request.op);
+  append_int<uint32_t>(out, request.keys.size());
+  for (size_t i = 0; i < request.keys.size(); i++) {
+    append_int<uint64_t>(out, request.keys[i]);
+    if (request.op == PROTO_PUT || request.op == PROTO_SCAN) {
+      append_int<uint64_t>(out, request.values[i]);
+    }
+  }
+  end_frame(out, start);
+}
+
+void encode_response(uint8_t op, const Response &response, string *out) {
+  size_t start = begin_frame(out);
+  append_int<uint8_t>(out, response.status);
+  if (response.status != PROTO_OK || op == PROTO_PUT || op == PROTO_DEL) {
+    append_int<uint32_t>(out, 0);
+  } else if (op == PROTO_GET) {
+    append_int<uint32_t>(out, response.values.size());
+    for (size_t i = 0; i < response.values.size(); i++) {
+      append_int<uint8_t>(out, response.found[i]);
+      append_int<uint64_t>(out, response.values[i]);
+    }
+  } else {
+    append_int<uint32_t>(out, response.keys.size());
+    for (size_t i = 0; i < response.keys.size(); i++) {
+      append_int<uint64_t>(out, response.keys[i]);
+      append_int<uint64_t>(out, response.values[i]);
+    }
+  }
+  end_frame(out, start);
+}
+
+// Find the body of the first frame in buff. Return the frame size, 0 if it
+// isn't all there yet, or -1 if it is too large.
+long frame_body(const char *buff, size_t size, BodyReader *body) {
+  if (size < FRAME_HEADER_BYTES) {
+    return 0;
+  }
+  uint32_t length;
+  memcpy(&length, buff, sizeof(length));
+  if (length > MAX_FRAME_BYTES) {
+    return -1;
+  }
+  if (size < FRAME_HEADER_BYTES + length) {
+    return 0;
+  }
+  body->next = buff + FRAME_HEADER_BYTES;
+  body->end = body->next + length;
+  return FRAME_HEADER_BYTES + length;
+}
+
+long decode_request(const char *buff, size_t size, Request *request) {
+  BodyReader body;
+  long frame_size = frame_body(buff, size, &body);
+  if (frame_size <= 0) {
+    return frame_size;
+  }
+  uint32_t count;
+  if (!body.read(&request->op) || !body.read(&count)) {
+    return -1;
+  }
+  bool pairs = request->op == PROTO_PUT || request->op == PROTO_SCAN;
+  if (request->op < PROTO_GET || request->op > PROTO_SCAN ||
+      (request->op == PROTO_SCAN && count != 1) ||
+      (size_t)(body.end - body.next) !=
+          count * sizeof(uint64_t) * (pairs ? 2 : 1)) {
+    return -1;
+  }
+  request->keys.resize(count);
+  request->values.resize(pairs ? count : 0);
+  for (uint32_t i = 0; i < count; i++) {
+    body.read(&request->keys[i]);
+    if (pairs) {
+      body.read(&request->values[i]);
+    }
+    // A PUT of TOMBSTONE would delete the key, so reserved values are refused
+    if (request->op == PROTO_PUT && request->values[i] >= TOMBSTONE) {
+      return -1;
+    }
+  }
+  return frame_size;
+}
+
+long decode_response(uint8_t op, const char *buff, size_t size,
+                     Response *response) {
+  BodyReader body;
+  long frame_size = frame_body(buff, size, &body);
+  if (frame_size <= 0) {
+    return frame_size;
+  }
+  uint32_t count;
+  if (!body.read(&response->status) || !body.read(&count) ||
+      (size_t)(body.end - body.next) < count * (sizeof(uint8_t) + sizeof(uint64_t))) {
+    return -1;
+  }
+  response->keys.resize(op == PROTO_SCAN ? count : 0);
+  response->values.resize(count);
+  response->found.resize(op == PROTO_GET ? count : 0);
+  for (uint32_t i = 0; i < count; i++) {
+    bool read = op == PROTO_GET ? body.read(&response->found[i])
+                                : body.read(&response->keys[i]);
+    if (!read || !body.read(&response->values[i])) {
+      return -1;
+    }
+  }
+  return frame_size;
+}
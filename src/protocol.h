@@ -0,0 +1,57 @@
+#ifndef _PROTOCOL_H
+#define _PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Requests
+#define PROTO_GET 1
+#define PROTO_PUT 2
+#define PROTO_DEL 3
+#define PROTO_SCAN 4
+
+// Response status
+#define PROTO_OK 0
+#define PROTO_ERROR 1  // The request was malformed; the server then closes
+
+// Every message is a frame: a uint32 length of the body, then the body. All
+// integers are in host byte order, so client and server must share it.
+//
+// A request body is the op (uint8), a count (uint32) and count items:
+//   GET, DEL  count keys
+//   PUT       count key, value pairs, values below TOMBSTONE
+//   SCAN      one key1, key2 pair
+// A response body is the status (uint8), a count (uint32) and count items:
+//   GET       one found (uint8), value pair per key asked for
+//   SCAN      key, value pairs in key order
+//   PUT, DEL  nothing
+// A client may send any number of requests before reading the responses,
+// which come back in the same order.
+struct Request {
+  uint8_t op;
+  std::vector<uint64_t> keys;
+  std::vector<uint64_t> values;  // PUT values, or the end of a SCAN
+};
+
+struct Response {
+  uint8_t status = PROTO_OK;
+  std::vector<uint64_t> keys;    // SCAN keys
+  std::vector<uint64_t> values;  // GET or SCAN values
+  std::vector<uint8_t> found;    // Whether each GET key was found
+};
+
+void encode_request(const Request &request, std::string *out);
+void encode_response(uint8_t op, const Response &response, std::string *out);
+// Decode the first frame in buff: return its size, 0 when more bytes are
+// needed, or -1 when it is malformed
+long decode_request(const char *buff, size_t size, Request *request);
+long decode_response(uint8_t op, const char *buff, size_t size,
+                     Response *response);
+
+const size_t FRAME_HEADER_BYTES = sizeof(uint32_t);
+const size_t MAX_FRAME_BYTES = 64 << 20;
+const size_t MAX_SCAN_RESULTS = MAX_FRAME_BYTES / 16 - 1;
+
+#endif
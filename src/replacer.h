@@ -1,14 +1,25 @@
 #ifndef _REPLACER_H
 #define _REPLACER_H
 
+#include <vector>
+
 #include "kvpair.h"
 
 #define CLOCK 0
 #define LRU 1
 
 struct Replacer {
-  virtual int evict(KVPair *page) = 0;
+  // Choose a victim, stop tracking it and hand it back through page. Return 0
+  // if there is nothing to evict.
+  virtual int evict(KVPair *&page) = 0;
   virtual int record_access(KVPair *page) = 0;
+  // Start tracking a page at the cold end, so it is the next victim unless it
+  // is accessed again. Pages already tracked keep their position.
+  virtual int record_cold(KVPair *page) = 0;
+  // Tracked pages ordered from the one this policy would evict last to the one
+  // it would evict first
+  virtual std::vector<KVPair *> pages_by_hotness() = 0;
+  virtual ~Replacer() {}
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,267 @@
+#include "resp.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "exceptions.h"
+
+using namespace std;
+
+// Find the end of the line starting at next. Return the position of its "\r\n"
+// or NULL if the line isn't all there yet.
+const char *resp_line_end(const char *next, const char *end) {
+  const void *cr = memchr(next, '\r', end - next);
+  if (cr == NULL || (const char *)cr + 1 >= end) {
+    return NULL;
+  }
+  return (const char *)cr;
+}
+
+// Parse the integer after a type byte such as '*' or '$' up to end
+bool resp_parse_length(const char *next, const char *end, long *length) {
+  if (end - next < 1 || end - next > 18) {
+    return false;
+  }
+  string digits(next, end);
+  char *parsed;
+  *length = strtol(digits.c_str(), &parsed, 10);
+  return *parsed == '\0';
+}
+
+long decode_inline_command(const char *buff, size_t size,
+                           vector<string> *args) {
+  const void *newline = memchr(buff, '\n', size);
+  if (newline == NULL) {
+    return size > RESP_MAX_INLINE_BYTES ? -1 : 0;
+  }
+  const char *end = (const char *)newline;
+  args->clear();
+  const char *next = buff;
+  while (next < end) {
+    while (next < end && (*next == ' ' || *next == '\r' || *next == '\t')) {
+      next++;
+    }
+    const char *word = next;
+    while (next < end && *next != ' ' && *next != '\r' && *next != '\t') {
+      next++;
+    }
+    if (next > word) {
+      args->push_back(string(word, next));
+    }
+  }
+  return end + 1 - buff;
+}
+
+long decode_resp_command(const char *buff, size_t size, vector<string> *args) {
+  if (size == 0) {
+    return 0;
+  }
+  if (buff[0] != '*') {
+    return decode_inline_command(buff, size, args);
+  }
+  const char *next = buff;
+  const char *end = buff + size;
+  const char *eol = resp_line_end(next, end);
+  long count;
+  if (eol == NULL) {
+    return size > RESP_MAX_INLINE_BYTES ? -1 : 0;
+  }
+  if (eol[1] != '\n' || !resp_parse_length(next + 1, eol, &count) ||
+      count > (long)RESP_MAX_ARGS) {
+    return -1;
+  }
+  next = eol + 2;
+  args->clear();
+  for (long i = 0; i < count; i++) {
+    if (next == end) {
+      return 0;
+    }
+    eol = resp_line_end(next, end);
+    if (eol == NULL) {
+      return 0;
+    }
+    long length;
+    if (*next != '$' || eol[1] != '\n' ||
+        !resp_parse_length(next + 1, eol, &length) || length < 0 ||
+        length > (long)RESP_MAX_BULK_BYTES) {
+      return -1;
+    }
+    next = eol + 2;
+    if (end - next < length + 2) {
+      return 0;
+    }
+    if (next[length] != '\r' || next[length + 1] != '\n') {
+      return -1;
+    }
+    args->push_back(string(next, length));
+    next += length + 2;
+  }
+  return next - buff;
+}
+
+void resp_error(string message, string *out) {
+  *out += "-ERR " + message + "\r\n";
+}
+
+void resp_integer(long long value, string *out) {
+  *out += ":" + to_string(value) + "\r\n";
+}
+
+void resp_bulk(string value, string *out) {
+  *out += "$" + to_string(value.size()) + "\r\n" + value + "\r\n";
+}
+
+void resp_nil(string *out) { *out += "$-1\r\n"; }
+
+void resp_array(size_t count, string *out) {
+  *out += "*" + to_string(count) + "\r\n";
+}
+
+// Parse a key or value. Values can't be the reserved TOMBSTONE or MAX_KEY.
+bool resp_parse_number(const string &arg, uint64_t *number, bool value = false) {
+  if (arg.empty() || arg.size() > 20 ||
+      arg.find_first_not_of("0123456789") != string::npos) {
+    return false;
+  }
+  errno = 0;
+  *number = strtoull(arg.c_str(), NULL, 10);
+  return errno == 0 && (!value || *number < TOMBSTONE);
+}
+
+bool resp_lookup(DB *db, uint64_t key, uint64_t *value) {
+  try {
+    *value = db->get(key);
+    return true;
+  } catch (const KeyException &e) {
+    return false;
+  }
+}
+
+bool execute_resp_command(DB *db, const vector<string> &args, string *out,
+                          vector<KVPair> *writes) {
+  if (args.empty()) {
+    return true;
+  }
+  string command = args[0];
+  transform(command.begin(), command.end(), command.begin(), ::toupper);
+  if (writes != NULL && command != "SET" && command != "MSET") {
+    db->write_batch(*writes);
+    writes->clear();
+  }
+  size_t argc = args.size();
+  vector<uint64_t> numbers(argc);
+  auto parse_args = [&](size_t first, bool pairs) {
+    for (size_t i = first; i < argc; i++) {
+      bool value = pairs && (i - first) % 2 == 1;
+      if (!resp_parse_number(args[i], &numbers[i], value)) {
+        resp_error(value ? "value is not an integer below 2^64 - 2"
+                         : "key is not an unsigned 64-bit integer",
+                   out);
+        return false;
+      }
+    }
+    return true;
+  };
+  auto wrong_arity = [&]() {
+    resp_error("wrong number of arguments for '" + args[0] + "' command",
+               out);
+  };
+
+  if (command == "GET") {
+    if (argc != 2) {
+      wrong_arity();
+    } else if (parse_args(1, false)) {
+      uint64_t value;
+      if (resp_lookup(db, numbers[1], &value)) {
+        resp_bulk(to_string(value), out);
+      } else {
+        resp_nil(out);
+      }
+    }
+  } else if (command == "SET") {
+    if (argc != 3) {
+      wrong_arity();
+    } else if (parse_args(1, true)) {
+      if (writes != NULL) {
+        writes->push_back({numbers[1], numbers[2]});
+      } else {
+        db->put(numbers[1], numbers[2]);
+      }
+      *out += "+OK\r\n";
+    }
+  } else if (command == "DEL") {
+    // Like Redis, reply with how many of the keys existed
+    if (argc < 2) {
+      wrong_arity();
+    } else if (parse_args(1, false)) {
+      long long deleted = 0;
+      for (size_t i = 1; i < argc; i++) {
+        uint64_t value;
+        if (resp_lookup(db, numbers[i], &value)) {
+          db->del(numbers[i]);
+          deleted++;
+        }
+      }
+      resp_integer(deleted, out);
+    }
+  } else if (command == "MGET") {
+    if (argc < 2) {
+      wrong_arity();
+    } else if (parse_args(1, false)) {
+      resp_array(argc - 1, out);
+      for (size_t i = 1; i < argc; i++) {
+        uint64_t value;
+        if (resp_lookup(db, numbers[i], &value)) {
+          resp_bulk(to_string(value), out);
+        } else {
+          resp_nil(out);
+        }
+      }
+    }
+  } else if (command == "MSET") {
+    if (argc < 3 || argc % 2 == 0) {
+      wrong_arity();
+    } else if (parse_args(1, true)) {
+      vector<KVPair> kvpairs;
+      for (size_t i = 1; i < argc; i += 2) {
+        kvpairs.push_back({numbers[i], numbers[i + 1]});
+      }
+      if (writes != NULL) {
+        writes->insert(writes->end(), kvpairs.begin(), kvpairs.end());
+      } else {
+        db->write_batch(kvpairs);
+      }
+      *out += "+OK\r\n";
+    }
+  } else if (command == "RANGE") {
+    if (argc != 3) {
+      wrong_arity();
+    } else if (parse_args(1, false)) {
+      // Longer ranges are cut short; the client continues after the last key
+      vector<KVPair> kvpairs =
+          db->scan(numbers[1], numbers[2], NULL, RESP_MAX_RANGE_PAIRS);
+      resp_array(2 * kvpairs.size(), out);
+      for (auto &kvpair : kvpairs) {
+        resp_bulk(to_string(kvpair.key), out);
+        resp_bulk(to_string(kvpair.value), out);
+      }
+    }
+  } else if (command == "PING") {
+    if (argc > 1) {
+      resp_bulk(args[1], out);
+    } else {
+      *out += "+PONG\r\n";
+    }
+  } else if (command == "QUIT") {
+    *out += "+OK\r\n";
+    return false;
+  } else if (command == "COMMAND" || command == "CONFIG") {
+    resp_array(0, out);
+  } else {
+    resp_error("unknown command '" + args[0] + "'", out);
+  }
+  return true;
+}
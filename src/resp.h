@@ -0,0 +1,42 @@
+#ifndef _RESP_H
+#define _RESP_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "db.h"
+
+// A subset of the Redis protocol (RESP), so Redis clients and load generators
+// can drive a DB. Keys and values are unsigned 64-bit integers written in
+// decimal. Commands:
+//   GET key, SET key value, DEL key [key ...], MGET key [key ...],
+//   MSET key value [key value ...], RANGE key1 key2 (the pairs in
+//   [key1, key2] as a flat array of keys and values, at most
+//   RESP_MAX_RANGE_PAIRS of the lowest), PING, QUIT
+// COMMAND and CONFIG are answered with an empty array for clients that send
+// them on connect.
+
+// Decode the first command in buff, an array of bulk strings or an inline
+// command. Return its size, 0 when more bytes are needed, or -1 when it is
+// malformed.
+long decode_resp_command(const char *buff, size_t size,
+                         std::vector<std::string> *args);
+// Run a command and append its reply to out. Return false if the client
+// asked to close the connection. With writes, SET and MSET add their pairs to
+// it instead of writing them, and any other command first applies it with
+// DB::write_batch, so a run of pipelined SETs is written at once; the caller
+// applies what is left.
+bool execute_resp_command(DB *db, const std::vector<std::string> &args,
+                          std::string *out,
+                          std::vector<KVPair> *writes = NULL);
+void resp_error(std::string message, std::string *out);
+
+const size_t RESP_MAX_ARGS = 1 << 20;
+const size_t RESP_MAX_BULK_BYTES = 1 << 20;
+const size_t RESP_MAX_INLINE_BYTES = 64 << 10;
+// Each pair takes at most 54 bytes of reply, so one RANGE stays under
+// SERVER_MAX_PENDING_OUTPUT
+const size_t RESP_MAX_RANGE_PAIRS = 1 << 15;
+
+#endif
@@ -0,0 +1,101 @@
+#include "row_cache.h"
+
+using namespace std;
+
+RowCache::RowCache(size_t budget_bytes, int num_shards) {
+  this->shard_budget_bytes = budget_bytes / num_shards;
+  for (int i = 0; i < num_shards; i++) {
+    auto shard = make_unique<Shard_t>();
+    shard->used_bytes = 0;
+    shards.push_back(move(shard));
+  }
+}
+
+RowCache::Shard_t& RowCache::shard_for(uint64_t key) {
+  // Fibonacci hashing so sequential keys spread over the shards
+  uint64_t hashed = key * 0x9e3779b97f4a7c15ULL;
+  return *shards[(hashed >> 32) & (shards.size() - 1)];
+}
+
+int RowCache::get(uint64_t key, uint64_t* value) {
+  Shard_t& shard = shard_for(key);
+  lock_guard<mutex> guard(shard.lock);
+
+  auto it = shard.index.find(key);
+  if (it == shard.index.end()) {
+    return ROW_MISS;
+  }
+  shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+  if (!it->second->found) {
+    return ROW_ABSENT;
+  }
+  *value = it->second->value;
+  return ROW_FOUND;
+}
+
+void RowCache::put(uint64_t key, uint64_t value) { insert(key, value, true); }
+
+void RowCache::put_absent(uint64_t key) { insert(key, 0, false); }
+
+void RowCache::insert(uint64_t key, uint64_t value, bool found) {
+  Shard_t& shard = shard_for(key);
+  lock_guard<mutex> guard(shard.lock);
+
+  auto it = shard.index.find(key);
+  if (it != shard.index.end()) {
+    it->second->value = value;
+    it->second->found = found;
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return;
+  }
+  if (ROW_CACHE_ENTRY_BYTES > this->shard_budget_bytes) {
+    return;
+  }
+
+  while (shard.used_bytes + ROW_CACHE_ENTRY_BYTES > this->shard_budget_bytes) {
+    shard.index.erase(shard.lru.back().key);
+    shard.lru.pop_back();
+    shard.used_bytes -= ROW_CACHE_ENTRY_BYTES;
+  }
+  shard.lru.push_front({.key = key, .value = value, .found = found});
+  shard.index[key] = shard.lru.begin();
+  shard.used_bytes += ROW_CACHE_ENTRY_BYTES;
+}
+
+void RowCache::erase(uint64_t key) {
+  Shard_t& shard = shard_for(key);
+  lock_guard<mutex> guard(shard.lock);
+
+  auto it = shard.index.find(key);
+  if (it == shard.index.end()) {
+    return;
+  }
+  shard.lru.erase(it->second);
+  shard.index.erase(it);
+  shard.used_bytes -= ROW_CACHE_ENTRY_BYTES;
+}
+
+void RowCache::erase_range(uint64_t start, uint64_t end) {
+  for (auto& shard : shards) {
+    lock_guard<mutex> guard(shard->lock);
+    for (auto it = shard->lru.begin(); it != shard->lru.end();) {
+      if (it->key < start || it->key > end) {
+        ++it;
+        continue;
+      }
+      shard->index.erase(it->key);
+      it = shard->lru.erase(it);
+      shard->used_bytes -= ROW_CACHE_ENTRY_BYTES;
+    }
+  }
+}
+
+size_t RowCache::memory_usage() {
+  size_t bytes = 0;
+  for (auto& shard : shards) {
+    lock_guard<mutex> guard(shard->lock);
+    bytes += sizeof(Shard_t) + shard->used_bytes +
+             shard->index.bucket_count() * sizeof(void*);
+  }
+  return bytes;
+}
@@ -0,0 +1,60 @@
+#ifndef _ROW_CACHE_H
+#define _ROW_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+const int DEFAULT_ROW_CACHE_SHARDS = 16;  // Must be a power of 2
+
+// Results of a row cache lookup
+#define ROW_MISS 0    // Nothing cached, the SSTs must be searched
+#define ROW_FOUND 1   // The cached value is current
+#define ROW_ABSENT 2  // The key is known not to be in the database
+
+// Caches individual key -> value results of SST lookups, including negative
+// results, so hot keys are served by one hash probe instead of a page search
+// per SST. Each shard is an LRU list bounded by its share of the byte budget.
+struct RowCache {
+  struct Entry {
+    uint64_t key;
+    uint64_t value;
+    bool found;  // false for a negative entry
+  };
+  typedef Entry Entry_t;
+
+  struct Shard {
+    std::list<Entry_t> lru;  // Most recently used at the front
+    std::unordered_map<uint64_t, std::list<Entry_t>::iterator> index;
+    size_t used_bytes;
+    std::mutex lock;
+  };
+  typedef Shard Shard_t;
+
+  std::vector<std::unique_ptr<Shard_t>> shards;
+  size_t shard_budget_bytes;
+
+  RowCache(size_t budget_bytes, int num_shards = DEFAULT_ROW_CACHE_SHARDS);
+  int get(uint64_t key, uint64_t *value);
+  void put(uint64_t key, uint64_t value);
+  void put_absent(uint64_t key);
+  void erase(uint64_t key);
+  void erase_range(uint64_t start, uint64_t end);  // Visits every cached row
+  size_t memory_usage();
+
+ private:
+  Shard_t& shard_for(uint64_t key);
+  void insert(uint64_t key, uint64_t value, bool found);
+};
+
+// Approximate bytes held per cached row: the entry plus its list and hash
+// table nodes
+const size_t ROW_CACHE_ENTRY_BYTES =
+    sizeof(RowCache::Entry_t) + 2 * sizeof(void*) +
+    sizeof(std::pair<uint64_t, std::list<RowCache::Entry_t>::iterator>) +
+    2 * sizeof(void*);
+
+#endif
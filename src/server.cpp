@@ -0,0 +1,356 @@
+#include "server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "exceptions.h"
+#include "resp.h"
+
+using namespace std;
+
+bool KVServer::start(DB* db, string host, int port, int threads,
+                     int protocol) {
+  this->db = db;
+  this->protocol = protocol;
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+    fprintf(stderr, "ERROR: %s is not an IPv4 address.\n", host.c_str());
+    return false;
+  }
+
+  listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0) {
+    perror("socket");
+    return false;
+  }
+  int on = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  socklen_t addr_size = sizeof(addr);
+  if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) == -1 ||
+      listen(listen_fd, SERVER_BACKLOG) == -1 ||
+      getsockname(listen_fd, (sockaddr*)&addr, &addr_size) == -1) {
+    fprintf(stderr, "ERROR: Could not listen on %s:%d. %s\n", host.c_str(),
+            port, strerror(errno));
+    ::close(listen_fd);
+    listen_fd = -1;
+    return false;
+  }
+  this->port = ntohs(addr.sin_port);
+
+  stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (stop_fd < 0) {
+    perror("eventfd");
+    ::close(listen_fd);
+    listen_fd = -1;
+    return false;
+  }
+  for (int i = 0; i < threads; i++) {
+    loops.push_back(thread(&KVServer::run_loop, this));
+  }
+  return true;
+}
+
+// The eventfd is never read, so it stays readable and wakes every loop
+void KVServer::stop() {
+  uint64_t one = 1;
+  if (write(stop_fd, &one, sizeof(one)) == -1) {
+    perror("write");
+  }
+}
+
+void KVServer::wait() {
+  for (auto& loop : loops) {
+    loop.join();
+  }
+  loops.clear();
+  ::close(listen_fd);
+  ::close(stop_fd);
+  listen_fd = -1;
+  stop_fd = -1;
+}
+
+void KVServer::run_loop() {
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    perror("epoll_create1");
+    return;
+  }
+  // Only one loop is woken per new connection
+  epoll_event event = {};
+  event.events = EPOLLIN | EPOLLEXCLUSIVE;
+  event.data.ptr = &listen_fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+  event.events = EPOLLIN;
+  event.data.ptr = &stop_fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &event);
+
+  unordered_set<Connection*> connections;
+  epoll_event events[SERVER_MAX_EVENTS];
+  bool stopping = false;
+  while (!stopping) {
+    int n = epoll_wait(epoll_fd, events, SERVER_MAX_EVENTS, -1);
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("epoll_wait");
+      break;
+    }
+    for (int i = 0; i < n; i++) {
+      if (events[i].data.ptr == &stop_fd) {
+        stopping = true;
+        continue;
+      }
+      if (events[i].data.ptr == &listen_fd) {
+        accept_connections(epoll_fd, &connections);
+        continue;
+      }
+      Connection* connection = (Connection*)events[i].data.ptr;
+      bool open = true;
+      if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        open = read_requests(connection);
+      }
+      // Requests held back while the output was backed up run as it drains
+      open = open && write_responses(connection);
+      while (open && run_requests(connection)) {
+        open = write_responses(connection);
+      }
+      open = open && watch(epoll_fd, connection);
+      if (!open) {
+        ::close(connection->fd);
+        connections.erase(connection);
+        delete connection;
+      }
+    }
+  }
+
+  for (Connection* connection : connections) {
+    ::close(connection->fd);
+    delete connection;
+  }
+  ::close(epoll_fd);
+}
+
+void KVServer::accept_connections(int epoll_fd,
+                                  unordered_set<Connection*>* connections) {
+  while (true) {
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        perror("accept4");
+      }
+      return;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    Connection* connection = new Connection();
+    connection->fd = fd;
+    connection->events = EPOLLIN;
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = connection;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+      perror("epoll_ctl");
+      ::close(fd);
+      delete connection;
+      continue;
+    }
+    connections->insert(connection);
+  }
+}
+
+// Read what has arrived, up to SERVER_MAX_READ_PER_EVENT. The loop is level
+// triggered, so the rest wakes it again. Return false if the connection
+// failed.
+bool KVServer::read_requests(Connection* connection) {
+  char buff[SERVER_READ_BYTES];
+  size_t total = 0;
+  while (total < SERVER_MAX_READ_PER_EVENT) {
+    ssize_t n = read(connection->fd, buff, sizeof(buff));
+    if (n > 0) {
+      connection->in.append(buff, n);
+      total += n;
+    } else if (n == 0) {
+      connection->eof = true;
+      break;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      break;
+    } else if (errno != EINTR) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Run the complete requests read from a connection until its output backs up.
+// Return true if any ran.
+bool KVServer::run_requests(Connection* connection) {
+  size_t unread = connection->in.size();
+  if (protocol == SERVER_RESP) {
+    run_resp_commands(connection);
+  } else {
+    run_binary_requests(connection);
+  }
+  // Answer what the client sent before closing its side
+  if (connection->eof && connection->pending() < SERVER_MAX_PENDING_OUTPUT) {
+    connection->closing = true;
+  }
+  return connection->in.size() < unread;
+}
+
+// Runs of PUT and DEL requests are applied with one DB::write_batch, before
+// the next request that reads and before their responses are written
+void KVServer::run_binary_requests(Connection* connection) {
+  size_t offset = 0;
+  vector<KVPair> writes;
+  while (!connection->closing &&
+         connection->pending() < SERVER_MAX_PENDING_OUTPUT) {
+    Request request;
+    long size = decode_request(connection->in.data() + offset,
+                               connection->in.size() - offset, &request);
+    if (size == 0) {
+      break;
+    }
+    Response response;
+    if (size < 0) {
+      response.status = PROTO_ERROR;
+      encode_response(0, response, &connection->out);
+      connection->closing = true;
+      break;
+    }
+    if (request.op == PROTO_PUT) {
+      for (size_t i = 0; i < request.keys.size(); i++) {
+        writes.push_back({request.keys[i], request.values[i]});
+      }
+    } else if (request.op == PROTO_DEL) {
+      for (uint64_t key : request.keys) {
+        writes.push_back({key, TOMBSTONE});
+      }
+    } else {
+      db->write_batch(writes);
+      writes.clear();
+      execute(request, &response);
+    }
+    encode_response(request.op, response, &connection->out);
+    offset += size;
+  }
+  db->write_batch(writes);
+  connection->in.erase(0, offset);
+}
+
+void KVServer::run_resp_commands(Connection* connection) {
+  size_t offset = 0;
+  vector<string> args;
+  vector<KVPair> writes;
+  while (!connection->closing &&
+         connection->pending() < SERVER_MAX_PENDING_OUTPUT) {
+    long size = decode_resp_command(connection->in.data() + offset,
+                                    connection->in.size() - offset, &args);
+    if (size == 0) {
+      break;
+    }
+    if (size < 0) {
+      resp_error("Protocol error", &connection->out);
+      connection->closing = true;
+      break;
+    }
+    connection->closing =
+        !execute_resp_command(db, args, &connection->out, &writes);
+    offset += size;
+  }
+  db->write_batch(writes);
+  connection->in.erase(0, offset);
+}
+
+void KVServer::execute(const Request& request, Response* response) {
+  switch (request.op) {
+    case PROTO_GET:
+      response->values.resize(request.keys.size());
+      response->found.resize(request.keys.size());
+      for (size_t i = 0; i < request.keys.size(); i++) {
+        try {
+          response->values[i] = db->get(request.keys[i]);
+          response->found[i] = 1;
+        } catch (const KeyException& e) {
+          response->values[i] = 0;
+          response->found[i] = 0;
+        }
+      }
+      break;
+    case PROTO_SCAN: {
+      // Longer scans are cut short; the client continues after the last key
+      vector<KVPair> kvpairs =
+          db->scan(request.keys[0], request.values[0], NULL, MAX_SCAN_RESULTS);
+      size_t count = kvpairs.size();
+      response->keys.resize(count);
+      response->values.resize(count);
+      for (size_t i = 0; i < count; i++) {
+        response->keys[i] = kvpairs[i].key;
+        response->values[i] = kvpairs[i].value;
+      }
+      break;
+    }
+  }
+}
+
+// Write as much of the pending output as the socket takes. Return false if
+// the connection failed, or is done once everything is written.
+bool KVServer::write_responses(Connection* connection) {
+  string& out = connection->out;
+  while (connection->written < out.size()) {
+    ssize_t n = send(connection->fd, out.data() + connection->written,
+                     out.size() - connection->written, MSG_NOSIGNAL);
+    if (n >= 0) {
+      connection->written += n;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      break;
+    } else if (errno != EINTR) {
+      return false;
+    }
+  }
+  if (connection->written == out.size()) {
+    out.clear();
+    connection->written = 0;
+    return !connection->closing;
+  }
+  if (connection->written > out.size() / 2) {
+    out.erase(0, connection->written);
+    connection->written = 0;
+  }
+  return true;
+}
+
+// Watch for input unless too much output is waiting, and for the socket
+// becoming writable while any is
+bool KVServer::watch(int epoll_fd, Connection* connection) {
+  size_t pending = connection->pending();
+  uint32_t events = 0;
+  if (!connection->closing && pending < SERVER_MAX_PENDING_OUTPUT) {
+    events |= EPOLLIN;
+  }
+  if (pending > 0) {
+    events |= EPOLLOUT;
+  }
+  if (events == connection->events) {
+    return true;
+  }
+  epoll_event event = {};
+  event.events = events;
+  event.data.ptr = connection;
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection->fd, &event) == -1) {
+    perror("epoll_ctl");
+    return false;
+  }
+  connection->events = events;
+  return true;
+}
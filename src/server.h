@@ -0,0 +1,68 @@
+#ifndef _SERVER_H
+#define _SERVER_H
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "db.h"
+#include "protocol.h"
+
+// Wire protocols a server can speak
+#define SERVER_BINARY 0  // protocol.h
+#define SERVER_RESP 1    // The Redis subset in resp.h
+
+// Serves a DB over TCP with one of the protocols above. Each event loop thread
+// has its own epoll instance and takes new connections from the shared
+// listening socket; a connection stays on the loop that accepted it. The
+// complete requests read from a connection are run before any of their
+// responses are written, so pipelined requests cost one write between them,
+// until SERVER_MAX_PENDING_OUTPUT is waiting; the rest run as it drains.
+struct KVServer {
+private:
+  struct Connection {
+    int fd;
+    std::string in;         // Bytes read but not yet decoded
+    std::string out;        // Responses not yet written
+    size_t written = 0;     // Bytes of out already written
+    uint32_t events = 0;    // What epoll is watching for
+    bool eof = false;       // The client closed its side
+    bool closing = false;   // Close once out is written
+
+    size_t pending() const { return out.size() - written; }
+  };
+
+  int listen_fd = -1;
+  int stop_fd = -1;  // An eventfd that wakes every loop to stop
+  std::vector<std::thread> loops;
+
+  void run_loop();
+  void accept_connections(int epoll_fd,
+                          std::unordered_set<Connection *> *connections);
+  bool read_requests(Connection *connection);
+  bool run_requests(Connection *connection);
+  void run_binary_requests(Connection *connection);
+  void run_resp_commands(Connection *connection);
+  void execute(const Request &request, Response *response); // Not PUT or DEL
+  bool write_responses(Connection *connection);
+  bool watch(int epoll_fd, Connection *connection);
+
+public:
+  DB *db = NULL;
+  int port = 0;  // The port listened on, chosen by the system if started with 0
+  int protocol = SERVER_BINARY;
+  bool start(DB *db, std::string host, int port, int threads = 1,
+             int protocol = SERVER_BINARY);
+  void stop();   // Safe to call from a signal handler
+  void wait();   // Block until the loops have stopped and closed every connection
+};
+
+const int SERVER_BACKLOG = 1024;
+const int SERVER_MAX_EVENTS = 256;   // Events handled per epoll_wait
+const size_t SERVER_READ_BYTES = 64 << 10;
+const size_t SERVER_MAX_READ_PER_EVENT = 1 << 20; // Bytes read from a connection per event, the rest on the next
+const size_t SERVER_MAX_PENDING_OUTPUT = 4 << 20; // Stop reading a connection with this much unsent
+
+#endif
@@ -0,0 +1,272 @@
+#include "sharded_db.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include "exceptions.h"
+
+using namespace std;
+
+void pin_to_cpu(int n);
+string shard_dir(string db_name, int shard);
+
+bool ShardedDB::open(string db_name, int num_shards, int memtable_size,
+                     int bp_policy, size_t bp_bytes, size_t row_cache_bytes) {
+  if (!this->name.empty()) {
+    fprintf(stderr, "ERROR: DB %s is already open. Close this DB first.\n",
+            this->name.c_str());
+    return false;
+  }
+
+  // The shard count is part of the key routing, so it can't change later
+  string shards_file = db_name + "/" + SHARDS_FILE;
+  struct stat statbuf;
+  if (stat(db_name.c_str(), &statbuf) == 0) {
+    int existing = 0;
+    ifstream(shards_file) >> existing;
+    if (existing <= 0) {
+      fprintf(stderr, "ERROR: %s is not a sharded database.\n",
+              db_name.c_str());
+      return false;
+    }
+    if (num_shards != 0 && num_shards != existing) {
+      fprintf(stderr, "ERROR: %s has %d shards, not %d.\n", db_name.c_str(),
+              existing, num_shards);
+      return false;
+    }
+    num_shards = existing;
+  } else {
+    if (num_shards <= 0) {
+      fprintf(stderr, "ERROR: A new sharded database needs a shard count.\n");
+      return false;
+    }
+    if (mkdir(db_name.c_str(), DIR_PERMISSIONS) == -1) {
+      fprintf(stderr, "ERROR: Could not create database %s. %s\n",
+              db_name.c_str(), strerror(errno));
+      return false;
+    }
+    ofstream out(shards_file);
+    out << num_shards << "\n";
+    if (!out.flush()) {
+      fprintf(stderr, "ERROR: Could not write %s.\n", shards_file.c_str());
+      return false;
+    }
+  }
+
+  for (int i = 0; i < num_shards; i++) {
+    shards.push_back(make_unique<Shard>());
+    if (!shards[i]->db.open(shard_dir(db_name, i), memtable_size, bp_policy,
+                            bp_bytes / num_shards,
+                            row_cache_bytes / num_shards)) {
+      shards.pop_back();
+      close();
+      return false;
+    }
+  }
+  for (int i = 0; i < num_shards; i++) {
+    Shard* shard = shards[i].get();
+    shard->worker = thread(&ShardedDB::serve, this, shard, i);
+  }
+  name = db_name;
+  return true;
+}
+
+bool ShardedDB::close() {
+  bool closed = true;
+  for (auto& shard : shards) {
+    if (shard->worker.joinable()) {
+      {
+        lock_guard<mutex> guard(shard->wake_lock);
+        shard->stop = true;
+      }
+      shard->wake.notify_one();
+      shard->worker.join();
+    }
+    closed = shard->db.close() && closed;
+  }
+  shards.clear();
+  name = "";
+  return closed;
+}
+
+void ShardedDB::put(uint64_t key, uint64_t value) {
+  ShardRequest request;
+  request.op = SHARD_PUT;
+  request.key = key;
+  request.value = value;
+  call(key, &request);
+}
+
+uint64_t ShardedDB::get(uint64_t key) {
+  ShardRequest request;
+  request.op = SHARD_GET;
+  request.key = key;
+  call(key, &request);
+  if (!request.found) {
+    throw KeyException("Key not in database");
+  }
+  return request.value;
+}
+
+void ShardedDB::del(uint64_t key) {
+  ShardRequest request;
+  request.op = SHARD_DEL;
+  request.key = key;
+  call(key, &request);
+}
+
+vector<KVPair> ShardedDB::scan(uint64_t key1, uint64_t key2) {
+  vector<ShardRequest> requests(shards.size());
+  for (size_t i = 0; i < shards.size(); i++) {
+    requests[i].op = SHARD_SCAN;
+    requests[i].key = key1;
+    requests[i].value = key2;
+    submit(shards[i].get(), &requests[i]);
+  }
+
+  // Each shard's results are sorted and no key is in two shards
+  vector<KVPair> output;
+  for (auto& request : requests) {
+    wait(&request);
+    size_t middle = output.size();
+    output.insert(output.end(), request.kvpairs.begin(),
+                  request.kvpairs.end());
+    inplace_merge(output.begin(), output.begin() + middle, output.end(),
+                  [](const KVPair& a, const KVPair& b) { return a.key < b.key; });
+  }
+  return output;
+}
+
+// Keys are mixed before taking the remainder so runs of sequential keys are
+// spread over every shard
+int ShardedDB::shard_of(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key % shards.size();
+}
+
+ShardRequest* ShardedDB::call(uint64_t key, ShardRequest* request) {
+  submit(shards[shard_of(key)].get(), request);
+  wait(request);
+  return request;
+}
+
+void ShardedDB::submit(Shard* shard, ShardRequest* request) {
+  request->next = shard->queue.load();
+  while (!shard->queue.compare_exchange_weak(request->next, request)) {
+  }
+  // The worker sets sleeping before its last look at the queue, so either it
+  // sees this request or this sees it sleeping
+  if (shard->sleeping) {
+    lock_guard<mutex> guard(shard->wake_lock);
+    shard->wake.notify_one();
+  }
+}
+
+void ShardedDB::wait(ShardRequest* request) {
+  unique_lock<mutex> guard(request->lock);
+  request->cv.wait(guard, [request]() { return request->done; });
+}
+
+void ShardedDB::serve(Shard* shard, int cpu) {
+  if (pin_threads) {
+    pin_to_cpu(cpu);
+  }
+  int idle = 0;
+  while (true) {
+    ShardRequest* stack = shard->queue.exchange(NULL);
+    if (stack == NULL) {
+      if (++idle < SHARD_SPIN) {
+        this_thread::yield();
+        continue;
+      }
+      unique_lock<mutex> guard(shard->wake_lock);
+      shard->sleeping = true;
+      shard->wake.wait(guard, [shard]() {
+        return shard->queue.load() != NULL || shard->stop;
+      });
+      shard->sleeping = false;
+      if (shard->queue.load() == NULL && shard->stop) {
+        return;
+      }
+      continue;
+    }
+    idle = 0;
+
+    // Reverse the stack to run requests in the order they were submitted
+    ShardRequest* oldest = NULL;
+    while (stack != NULL) {
+      ShardRequest* next = stack->next;
+      stack->next = oldest;
+      oldest = stack;
+      stack = next;
+    }
+    while (oldest != NULL) {
+      // The caller may free the request as soon as it is done
+      ShardRequest* next = oldest->next;
+      execute(shard, oldest);
+      oldest = next;
+    }
+  }
+}
+
+void ShardedDB::execute(Shard* shard, ShardRequest* request) {
+  switch (request->op) {
+    case SHARD_PUT:
+      shard->db.put(request->key, request->value);
+      break;
+    case SHARD_GET:
+      try {
+        request->value = shard->db.get(request->key);
+        request->found = true;
+      } catch (const KeyException& e) {
+        request->found = false;
+      }
+      break;
+    case SHARD_DEL:
+      shard->db.del(request->key);
+      break;
+    case SHARD_SCAN:
+      request->kvpairs = shard->db.scan(request->key, request->value);
+      break;
+  }
+  lock_guard<mutex> guard(request->lock);
+  request->done = true;
+  request->cv.notify_one();
+}
+
+// Pin the calling thread to the nth CPU it is allowed to run on
+void pin_to_cpu(int n) {
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+    perror("sched_getaffinity");
+    return;
+  }
+  n %= CPU_COUNT(&allowed);
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed) && n-- == 0) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+      int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+      if (err != 0) {
+        fprintf(stderr, "pthread_setaffinity_np: %s\n", strerror(err));
+      }
+      return;
+    }
+  }
+}
+
+string shard_dir(string db_name, int shard) {
+  return db_name + "/shard-" + to_string(shard);
+}
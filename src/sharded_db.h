@@ -0,0 +1,77 @@
+#ifndef _SHARDED_DB_H
+#define _SHARDED_DB_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "db.h"
+
+enum ShardOp { SHARD_PUT, SHARD_GET, SHARD_DEL, SHARD_SCAN };
+
+// One operation handed to a shard's worker. The caller owns it and waits for
+// done; the worker only touches it until it sets done.
+struct ShardRequest {
+  ShardOp op;
+  uint64_t key;
+  uint64_t value;  // The value to put, the end of a scan, or the value found
+  bool found = false;
+  std::vector<KVPair> kvpairs;  // Scan results
+  ShardRequest *next = NULL;    // Link in the submission queue
+  bool done = false;
+  std::mutex lock;
+  std::condition_variable cv;
+};
+
+// An independent DB in its own subdirectory, served by one worker thread.
+// Callers push requests onto a lock-free stack; the worker takes the whole
+// stack at once and runs it oldest first, so only the worker ever calls into
+// the DB and the shards share no locks.
+struct Shard {
+  DB db;
+  std::thread worker;
+  std::atomic<ShardRequest *> queue{NULL};  // Newest request first
+  std::atomic<bool> sleeping{false};        // Worker is waiting on wake
+  std::atomic<bool> stop{false};
+  std::mutex wake_lock;
+  std::condition_variable wake;
+};
+
+// A database split by key hash into shards that scale with cores instead of
+// contending on one DB's locks. Point operations go to one shard. A scan runs
+// on every shard in parallel and the results are merged; it is not atomic
+// across shards, and snapshots are not supported. The shard count is fixed
+// when the database is created.
+struct ShardedDB {
+private:
+  void submit(Shard *shard, ShardRequest *request);
+  void wait(ShardRequest *request);
+  void serve(Shard *shard, int cpu);
+  void execute(Shard *shard, ShardRequest *request);
+  ShardRequest *call(uint64_t key, ShardRequest *request);
+
+public:
+  std::string name;
+  std::vector<std::unique_ptr<Shard>> shards;
+  bool pin_threads = true; // Pin each worker to its own CPU, set before open
+  bool open(std::string db_name, int num_shards = 0,
+            int memtable_size = DEFAULT_MEMTABLE_SIZE, int bp_policy = CLOCK,
+            size_t bp_bytes = DEFAULT_BUFFER_POOL_BYTES,
+            size_t row_cache_bytes = 0); // num_shards 0 reopens with the existing count; cache sizes are totals split evenly
+  bool close();
+  void put(uint64_t key, uint64_t value);
+  uint64_t get(uint64_t key); // Throws KeyException if the key is missing
+  void del(uint64_t key);
+  std::vector<KVPair> scan(uint64_t key1, uint64_t key2); // Sorted by key
+  int shard_of(uint64_t key);
+};
+
+const std::string SHARDS_FILE = "shards"; // The shard count of a sharded database
+const int SHARD_SPIN = 1000; // Times an idle worker polls its queue before sleeping
+
+#endif
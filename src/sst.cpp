@@ -8,74 +8,279 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cmath>
+#include <fstream>
 #include <string>
 
 #include "exceptions.h"
+#include "perf_context.h"
 
 using namespace std;
 
-int kv_pairs_to_btree(void **, vector<KVPair> &);
+size_t kv_pairs_to_btree(void **, vector<KVPair> &);
+bool pwrite_all(int, const void *, size_t, off_t);
+void summarize_pages(const vector<KVPair> &, size_t, PageSummary *);
 bool read_sst_page(std::string, KVPair *, int);
 
-int find_lower_bound_page(int, uint64_t, KVPair **);
-int find_key_page(int, std::string, uint64_t, KVPair **, BufferPool *);
+KVPair *fetch_page(int, string, int, KVPair *, BufferPool *, int, int *,
+                   Statistics *);
+void page_read_done(string, int, KVPair *, int, BufferPool *, int,
+                    Statistics *);
+int find_lower_bound_page(int, string, uint64_t, KVPair *, BufferPool *,
+                          Statistics *);
+vector<KVPair> sst_scan_reverse(string, uint64_t, uint64_t, BufferPool *,
+                                Statistics *, size_t);
+int find_key_page(int, std::string, uint64_t, uint64_t, KVPair **,
+                  BufferPool *, Statistics *);
 int find_key_page_btree(int, std::string, uint64_t, KVPair **, BufferPool *);
-uint64_t get_in_page(KVPair *, uint64_t, int);
+uint64_t get_in_page(KVPair *, uint64_t, uint64_t, int);
+int find_in_page(KVPair *, uint64_t, uint64_t, int);
 
 int get_num_pages(int);
+uint64_t sst_magic(string);
 int page_num_entries(KVPair *, bool);
 int round_up(int, int);
 
-void write_sst(vector<KVPair> kv_pairs, string filename) {
+bool write_sst(vector<KVPair> kv_pairs, string filename) {
   int fd =
-      open(filename.c_str(), O_CREAT | O_WRONLY | O_DIRECT, FILE_PERMISSIONS);
+      open(filename.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_DIRECT,
+           FILE_PERMISSIONS);
 
   if (fd < 0) {
     perror("open");
+    return false;
   }
 
   void *buff;
-  int buff_size = kv_pairs_to_btree(&buff, kv_pairs);
+  size_t buff_size = kv_pairs_to_btree(&buff, kv_pairs);
+  bool written = pwrite_all(fd, buff, buff_size, 0);
+  free(buff);
+  if (written && fsync(fd) == -1) {
+    perror("fsync");
+    written = false;
+  }
+  close(fd);
+  return written;
+}
+
+// pwrite all of buff, which one call may not. Return false on an error.
+bool pwrite_all(int fd, const void *buff, size_t size, off_t offset) {
+  size_t written = 0;
+  while (written < size) {
+    ssize_t n = pwrite(fd, (const char *)buff + written, size - written,
+                       offset + written);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      perror("pwrite");
+      return false;
+    }
+    written += n;
+  }
+  return true;
+}
+
+// An empty page at MAX_KEY, as summarize_pages leaves one
+PageSummary empty_summary() {
+  PageSummary summary = {};
+  summary.min_key = MAX_KEY;
+  summary.max_key = MAX_KEY;
+  summary.flags = PAGE_DISTINCT;
+  summary.min_value = MAX_KEY;
+  return summary;
+}
+
+SSTWriter::SSTWriter(string filename)
+    : summary(empty_summary()), filename(filename) {}
+
+SSTWriter::~SSTWriter() {
+  free(page);
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+// The file is created with the first pair, so a writer given none leaves none
+bool SSTWriter::add(uint64_t key, uint64_t value) {
+  if (closed || (num_pairs > 0 && key <= last_key) || value >= TOMBSTONE) {
+    return false;
+  }
+  if (fd < 0) {
+    fd = open(filename.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_DIRECT,
+              FILE_PERMISSIONS);
+    if (fd < 0) {
+      perror("open");
+      closed = true;
+      return false;
+    }
+    if (posix_memalign((void **)&page, BLOCK_SIZE, _PAGE_SIZE) != 0) {
+      perror("posix_memalign");
+      closed = true;
+      return false;
+    }
+    memset(page, 0, _PAGE_SIZE);
+  }
+  // The keys are distinct and the values no tombstones, so every page is
+  // PAGE_DISTINCT
+  if (summary.count == 0) {
+    summary.min_key = key;
+  }
+  summary.max_key = key;
+  summary.count++;
+  summary.sum += value;
+  summary.min_value = min(summary.min_value, value);
+  summary.max_value = max(summary.max_value, value);
+  num_pairs++;
+  last_key = key;
+  // Sequence 0, until DB::ingest_files gives the pairs one if they need it
+  return append({key, value, 0});
+}
 
-  int ret = pwrite(fd, buff, buff_size, 0);
-  if (ret == -1) {
-    perror("pwrite");
+// Put a pair in the page, and write the page out once it is full
+bool SSTWriter::append(const KVPair &kvpair) {
+  page[num_entries++] = kvpair;
+  if (num_entries < SST_PAGE_ENTRIES) {
+    return true;
   }
+  if (last_keys.size() < B - 2) {
+    last_keys.push_back(kvpair.key);
+  }
+  summaries.push_back(summary);
+  summary = empty_summary();
+  closed = !pwrite_all(fd, page, _PAGE_SIZE,
+                       NODE_SIZE + (off_t)num_pages * _PAGE_SIZE);
+  memset(page, 0, _PAGE_SIZE);
+  num_entries = 0;
+  num_pages++;
+  return !closed;
+}
+
+// Lay the rest out as kv_pairs_to_btree does: the NULL_PAIR ending the pairs,
+// the summaries and last the header
+bool SSTWriter::finish() {
+  if (num_pairs == 0 || closed || !append(NULL_PAIR)) {
+    return false;
+  }
+  closed = true;
+  if (num_entries > 0) {
+    summaries.push_back(summary);
+    if (!pwrite_all(fd, page, _PAGE_SIZE,
+                    NODE_SIZE + (off_t)num_pages * _PAGE_SIZE)) {
+      return false;
+    }
+    num_pages++;
+  }
+
+  // At least a page, so the header is written from the same buffer after
+  size_t summaries_size = (summaries.size() + SST_PAGE_SUMMARIES - 1) /
+                          SST_PAGE_SUMMARIES * _PAGE_SIZE;
+  void *buff;
+  if (posix_memalign(&buff, BLOCK_SIZE, summaries_size) != 0) {
+    perror("posix_memalign");
+    return false;
+  }
+  memset(buff, 0, summaries_size);
+  memcpy(buff, summaries.data(), summaries.size() * sizeof(PageSummary));
+  bool written = pwrite_all(fd, buff, summaries_size,
+                            NODE_SIZE + (off_t)num_pages * _PAGE_SIZE);
+
+  uint64_t *header = (uint64_t *)buff;
+  memset(header, 0, NODE_SIZE);
+  header[0] = (num_pairs + 1) / SST_PAGE_ENTRIES;
+  copy(last_keys.begin(), last_keys.end(), header + 1);
+  header[B - 1] = SST_MAGIC;
+  written = written && pwrite_all(fd, header, NODE_SIZE, 0);
   free(buff);
+  if (written && fsync(fd) == -1) {
+    perror("fsync");
+    written = false;
+  }
   close(fd);
+  fd = -1;
+  return written;
 }
 
-int kv_pairs_to_btree(void **buff, vector<KVPair> &kv_pairs) {
+// Lay out an SST: a header of B words, then pages of SST_PAGE_ENTRIES pairs
+// each, then a PageSummary for each page, SST_PAGE_SUMMARIES to a page. The
+// header holds the index of the last page of pairs, the last key of each page
+// as far as there is room, and SST_MAGIC in its last word.
+size_t kv_pairs_to_btree(void **buff, vector<KVPair> &kv_pairs) {
   // Add special KV Pair at the end to indicate the end of the written block in
   // the file
   kv_pairs.push_back(NULL_PAIR);
 
-  int buff_size =
-      round_up_page_size(sizeof(KVPair) * kv_pairs.size() + NODE_SIZE);
+  // The pages after the header are all whole, so none of them is padding
+  size_t num_pages =
+      (kv_pairs.size() + SST_PAGE_ENTRIES - 1) / SST_PAGE_ENTRIES;
+  size_t num_summary_pages =
+      (num_pages + SST_PAGE_SUMMARIES - 1) / SST_PAGE_SUMMARIES;
+  size_t buff_size =
+      NODE_SIZE + (num_pages + num_summary_pages) * _PAGE_SIZE;
   int ret = posix_memalign(buff, BLOCK_SIZE, buff_size);
   if (ret != 0) {
     perror("posix_memalign");
   }
+  memset(*buff, 0, buff_size);
 
   uint64_t *key_buff = (uint64_t *)*buff;
-  KVPair *kvpair_buff = (KVPair *)(*buff + NODE_SIZE);
-
-  key_buff[0] = kv_pairs.size() / B;
-  for (int i = 0, j = 1; i < kv_pairs.size(); i++) {
-    kvpair_buff[i].key = kv_pairs[i].key;
-    kvpair_buff[i].value = kv_pairs[i].value;
+  key_buff[0] = kv_pairs.size() / SST_PAGE_ENTRIES;
+  key_buff[B - 1] = SST_MAGIC;
+  for (size_t i = 0, j = 1; i < kv_pairs.size(); i++) {
+    KVPair *page = (KVPair *)((char *)*buff + NODE_SIZE +
+                              i / SST_PAGE_ENTRIES * _PAGE_SIZE);
+    page[i % SST_PAGE_ENTRIES] = kv_pairs[i];
 
-    if (i % B == B - 1) {
+    if (i % SST_PAGE_ENTRIES == SST_PAGE_ENTRIES - 1 && j < B - 1) {
       key_buff[j] = kv_pairs[i].key;
       j++;
     }
   }
+  summarize_pages(kv_pairs, kv_pairs.size() - 1,
+                  (PageSummary *)((char *)*buff + NODE_SIZE +
+                                  num_pages * _PAGE_SIZE));
 
   return buff_size;
 }
 
-vector<KVPair> read_sst(string filename) {
+// Fill in a summary for each page of the first n pairs. A page holding only
+// the NULL_PAIR that ends the file is summarized as an empty page at MAX_KEY.
+void summarize_pages(const vector<KVPair> &kv_pairs, size_t n,
+                     PageSummary *summaries) {
+  for (size_t first = 0; first <= n; first += SST_PAGE_ENTRIES) {
+    size_t last = min(first + SST_PAGE_ENTRIES, n);
+    PageSummary &summary = summaries[first / SST_PAGE_ENTRIES];
+    summary.min_key = first < last ? kv_pairs[first].key : MAX_KEY;
+    summary.max_key = first < last ? kv_pairs[last - 1].key : MAX_KEY;
+    summary.flags = PAGE_DISTINCT;
+    summary.min_value = MAX_KEY;
+    for (size_t i = first; i < last; i++) {
+      const KVPair &kvpair = kv_pairs[i];
+      summary.max_sequence = max(summary.max_sequence, kvpair.sequence());
+      bool shared = (i > 0 && kv_pairs[i - 1].key == kvpair.key) ||
+                    (i + 1 < n && kv_pairs[i + 1].key == kvpair.key);
+      if (kvpair.is_operand()) {
+        summary.flags |= PAGE_OPERANDS;
+      }
+      if (shared || kvpair.is_operand() || kvpair.value == TOMBSTONE) {
+        summary.flags &= ~PAGE_DISTINCT;
+      }
+      if (kvpair.value == TOMBSTONE) {
+        continue;
+      }
+      summary.count++;
+      summary.sum += kvpair.value;
+      summary.min_value = min(summary.min_value, kvpair.value);
+      summary.max_value = max(summary.max_value, kvpair.value);
+    }
+  }
+}
+
+// Read every pair in an SST. Pages already in the buffer pool are copied from
+// it; pages read from disk are not cached, so reading a whole file doesn't evict
+// the working set.
+vector<KVPair> read_sst(string filename, BufferPool *bp, Statistics *stats) {
   vector<KVPair> kv_pairs;
   int fd = open(filename.c_str(), O_RDONLY | O_DIRECT, FILE_PERMISSIONS);
 
@@ -89,31 +294,31 @@ vector<KVPair> read_sst(string filename) {
   if (ret != 0) {
     perror("posix_memalign");
   }
-  KVPair *kvpair_buff = (KVPair *)buff;
+  KVPair *scratch = (KVPair *)buff;
 
   int i = 0;
   int bytes;
-  // Read file block-by-block
-  while ((bytes = pread(fd, kvpair_buff, buff_size,
-                        NODE_SIZE + i * buff_size)) > 0) {
-    if (bytes == -1) {
-      perror("pread");
-    }
+  KVPair *kvpair_buff;
+  // Read file page-by-page
+  while ((kvpair_buff = fetch_page(fd, filename, i, scratch, bp, BP_BYPASS,
+                                   &bytes, stats)) != NULL) {
     int pairs_in_block = bytes / sizeof(KVPair);
+    bool end_of_data = false;
     for (int j = 0; j < pairs_in_block; j++) {
       // Check if we reached the end of the block
       if (kvpair_buff[j].key == NULL_PAIR.key &&
           kvpair_buff[j].value == NULL_PAIR.value) {
+        end_of_data = true;
         break;
       }
-      KVPair kv_pair;
-      kv_pair.key = kvpair_buff[j].key;
-      kv_pair.value = kvpair_buff[j].value;
-      kv_pairs.push_back(kv_pair);
+      kv_pairs.push_back(kvpair_buff[j]);
+    }
+    if (end_of_data) {
+      break;
     }
     i++;
   }
-  free(kvpair_buff);
+  free(scratch);
   close(fd);
 
   return kv_pairs;
@@ -122,42 +327,269 @@ vector<KVPair> read_sst(string filename) {
 int read_sst_page(int fd, int page_index, KVPair **buffer) {
   int bytes;
   if ((bytes = pread(fd, (void *)*buffer, _PAGE_SIZE,
-                     NODE_SIZE + page_index * _PAGE_SIZE)) == -1) {
+                     NODE_SIZE + (off_t)page_index * _PAGE_SIZE)) == -1) {
     perror("pread");
   }
   return bytes;
 }
 
-vector<KVPair> sst_scan(string filename, uint64_t key1, uint64_t key2) {
+// Read a page of an SST into scratch and return it. A cached page is copied
+// from the buffer pool; otherwise the page is read from disk and, unless the
+// hint is BP_BYPASS, a copy is cached as the hint says. Return NULL past the
+// end of the file.
+KVPair *fetch_page(int fd, string filename, int page_index, KVPair *scratch,
+                   BufferPool *bp, int hint, int *bytes, Statistics *stats) {
+  if (bp != NULL) {
+    // Copied out so another thread can evict the page while it is being read
+    *bytes = bp->get_copy(filename, page_index, scratch, hint);
+    if (*bytes > 0) {
+      PERF_ADD(pages_from_pool, 1);
+      return scratch;
+    }
+  }
+
+  {
+    StopWatch timer(stats, SST_PAGE_READ);
+    PerfTimer perf_timer(&perf_context.page_read_nanos);
+    *bytes = read_sst_page(fd, page_index, &scratch);
+  }
+  if (*bytes <= 0) {
+    return NULL;
+  }
+  page_read_done(filename, page_index, scratch, *bytes, bp, hint, stats);
+  return scratch;
+}
+
+// Count a page read from disk and cache a copy of it as the hint says
+void page_read_done(string filename, int page_index, KVPair *page, int bytes,
+                    BufferPool *bp, int hint, Statistics *stats) {
+  PERF_ADD(pages_from_disk, 1);
+  PERF_ADD(bytes_read, bytes);
+  if (stats != NULL) {
+    stats->add(SST_BYTES_READ, bytes);
+  }
+  if (bp != NULL && hint != BP_BYPASS) {
+    KVPair *buffer_pool_page;
+    if (posix_memalign((void **)&buffer_pool_page, BLOCK_SIZE, bytes) != 0) {
+      perror("posix_memalign");
+    }
+    memcpy(buffer_pool_page, page, bytes);
+    bp->put(filename, page_index, buffer_pool_page, bytes, hint);
+  }
+}
+
+// Read a page into the buffer pool ahead of any request for it. Return false
+// if the pool has no room left for it without evicting.
+bool prefetch_sst_page(string filename, int page_index, BufferPool *bp,
+                       Statistics *stats) {
+  int fd = open(filename.c_str(), O_RDONLY | O_DIRECT, FILE_PERMISSIONS);
+  if (fd < 0) {
+    return true;  // The file was removed since the page was cached
+  }
+
+  KVPair *page;
+  if (posix_memalign((void **)&page, BLOCK_SIZE, _PAGE_SIZE) != 0) {
+    perror("posix_memalign");
+  }
+  int bytes;
+  {
+    StopWatch timer(stats, SST_PAGE_READ);
+    bytes = read_sst_page(fd, page_index, &page);
+  }
+  close(fd);
+  if (bytes <= 0) {
+    free(page);
+    return true;
+  }
+  if (stats != NULL) {
+    stats->add(SST_BYTES_READ, bytes);
+  }
+  if (!bp->put_if_room(filename, page_index, page, bytes)) {
+    free(page);
+    return false;
+  }
+  return true;
+}
+
+// Read the summary of every page of pairs in an SST. Return false if it can't
+// be read.
+bool read_page_summaries(string filename, vector<PageSummary> *summaries) {
+  int fd = open(filename.c_str(), O_RDONLY | O_DIRECT, FILE_PERMISSIONS);
+  if (fd < 0) {
+    perror("open");
+    return false;
+  }
+  int num_pages = get_num_pages(fd);
+  int buff_size =
+      (num_pages + SST_PAGE_SUMMARIES - 1) / SST_PAGE_SUMMARIES * _PAGE_SIZE;
+  PageSummary *buff;
+  if (posix_memalign((void **)&buff, BLOCK_SIZE, buff_size) != 0) {
+    perror("posix_memalign");
+  }
+  ssize_t bytes = pread(fd, buff, buff_size,
+                        NODE_SIZE + (off_t)num_pages * _PAGE_SIZE);
+  if (bytes == -1) {
+    perror("pread");
+  }
+  bool read = bytes == buff_size;
+  if (read) {
+    summaries->assign(buff, buff + num_pages);
+  }
+  free(buff);
+  close(fd);
+  return read;
+}
+
+// Every pair with a key in [key1, key2] in the given pages of an SST, in
+// storage order if the pages are given in order. Pages are cached at the cold
+// end, as by a scan.
+vector<KVPair> sst_read_pages(string filename, const vector<int> &pages,
+                              uint64_t key1, uint64_t key2, BufferPool *bp,
+                              Statistics *stats) {
+  vector<KVPair> kvpairs;
+  if (pages.empty()) {
+    return kvpairs;
+  }
+  int fd = open(filename.c_str(), O_RDONLY | O_DIRECT, FILE_PERMISSIONS);
+  if (fd < 0) {
+    perror("open");
+  }
+
+  KVPair *scratch;
+  if (posix_memalign((void **)&scratch, BLOCK_SIZE,
+                     round_up_page_size(sizeof(KVPair))) != 0) {
+    perror("posix_memalign");
+  }
+  int num_pages = get_num_pages(fd);
+  for (int i : pages) {
+    int bytes;
+    KVPair *buff =
+        fetch_page(fd, filename, i, scratch, bp, BP_COLD, &bytes, stats);
+    if (buff == NULL) {
+      continue;
+    }
+    int num_entries = page_num_entries(buff, i == num_pages - 1);
+    for (int j = 0; j < num_entries; j++) {
+      if (key1 <= buff[j].key && buff[j].key <= key2) {
+        kvpairs.push_back(buff[j]);
+      }
+    }
+  }
+
+  free(scratch);
+  close(fd);
+  return kvpairs;
+}
+
+SSTCursor::SSTCursor(string filename, const vector<int> *pages, uint64_t key1,
+                     uint64_t key2, BufferPool *bp, Statistics *stats)
+    : filename(filename), key1(key1), key2(key2), bp(bp), stats(stats) {
+  fd = open(filename.c_str(), O_RDONLY | O_DIRECT, FILE_PERMISSIONS);
+  if (fd < 0) {
+    perror("open");
+  }
+  if (posix_memalign((void **)&scratch, BLOCK_SIZE,
+                     round_up_page_size(sizeof(KVPair))) != 0) {
+    perror("posix_memalign");
+  }
+  num_pages = get_num_pages(fd);
+  if (pages != NULL) {
+    this->pages = *pages;
+  } else {
+    int first = find_lower_bound_page(fd, filename, key1, scratch, bp, stats);
+    for (int i = first; first != -1 && i < num_pages; i++) {
+      this->pages.push_back(i);
+    }
+  }
+  read_page();
+}
+
+SSTCursor::~SSTCursor() {
+  free(scratch);
+  close(fd);
+}
+
+void SSTCursor::next() {
+  if (++position == page.size()) {
+    read_page();
+  }
+}
+
+// Move to the next page with pairs in range. The pages after one ending past
+// key2 have none.
+void SSTCursor::read_page() {
+  page.clear();
+  position = 0;
+  while (page.empty() && next_page < pages.size()) {
+    int i = pages[next_page++];
+    int bytes;
+    KVPair *buff =
+        fetch_page(fd, filename, i, scratch, bp, BP_COLD, &bytes, stats);
+    if (buff == NULL) {
+      continue;
+    }
+    int num_entries = page_num_entries(buff, i == num_pages - 1);
+    for (int j = 0; j < num_entries; j++) {
+      if (key1 <= buff[j].key && buff[j].key <= key2) {
+        page.push_back(buff[j]);
+      }
+    }
+    if (num_entries > 0 && buff[num_entries - 1].key > key2) {
+      next_page = pages.size();
+    }
+  }
+}
+
+// Every pair with a key in [key1, key2], older writes and tombstones included,
+// in storage order. With a limit only the pairs of the first limit keys are
+// returned, or of the last ones if reverse, which then come highest key first
+// and still newest first.
+vector<KVPair> sst_scan(string filename, uint64_t key1, uint64_t key2,
+                        BufferPool *bp, Statistics *stats, size_t limit,
+                        bool reverse) {
+  if (reverse) {
+    return sst_scan_reverse(filename, key1, key2, bp, stats, limit);
+  }
   int fd = open(filename.c_str(), O_RDONLY | O_DIRECT, FILE_PERMISSIONS);
   if (fd < 0) {
     perror("open");
   }
 
   int buff_size = round_up_page_size(sizeof(KVPair));
-  KVPair *buff;
-  if (posix_memalign((void **)&buff, BLOCK_SIZE, buff_size) != 0) {
+  KVPair *scratch;
+  if (posix_memalign((void **)&scratch, BLOCK_SIZE, buff_size) != 0) {
     perror("posix_memalign");
   }
 
   vector<KVPair> kvpairs;
   // Find the page containing the smallest key greater or equal to key1
-  int lower_page_index = find_lower_bound_page(fd, key1, &buff);
+  int lower_page_index =
+      find_lower_bound_page(fd, filename, key1, scratch, bp, stats);
 
   if (lower_page_index == -1) {
-    free(buff);
+    free(scratch);
     close(fd);
     return kvpairs;
   }
 
-  // Walk until we encounter a key outside of the range
+  // Walk until we encounter a key outside of the range, or past the limit.
+  // Pages are cached at the cold end so a large scan can't flush the point
+  // lookup working set.
   int num_pages = get_num_pages(fd);
+  size_t keys = 0;
   for (int i = lower_page_index; i < num_pages; i++) {
-    if (read_sst_page(fd, i, &buff) > 0) {
+    int bytes;
+    KVPair *buff =
+        fetch_page(fd, filename, i, scratch, bp, BP_COLD, &bytes, stats);
+    if (buff != NULL) {
       int num_entries = page_num_entries(buff, i == num_pages - 1);
       for (int j = 0; j < num_entries; j++) {
-        if (key1 <= buff[j].key && buff[j].key <= key2 &&
-            buff[j].value != TOMBSTONE) {
+        if (key1 <= buff[j].key && buff[j].key <= key2) {
+          if (kvpairs.empty() || kvpairs.back().key != buff[j].key) {
+            if (keys++ == limit) {
+              goto end;
+            }
+          }
           kvpairs.push_back(buff[j]);
         } else if (buff[j].key > key2) {
           goto end;
@@ -167,15 +599,90 @@ vector<KVPair> sst_scan(string filename, uint64_t key1, uint64_t key2) {
   }
 
 end:
-  free(buff);
+  free(scratch);
   close(fd);
   return kvpairs;
 }
 
+// sst_scan from key2 down. The walk starts at the last page when it holds key2
+// or lower keys, as when reading the newest keys of a file, and otherwise at
+// the page a search finds.
+vector<KVPair> sst_scan_reverse(string filename, uint64_t key1, uint64_t key2,
+                                BufferPool *bp, Statistics *stats,
+                                size_t limit) {
+  int fd = open(filename.c_str(), O_RDONLY | O_DIRECT, FILE_PERMISSIONS);
+  if (fd < 0) {
+    perror("open");
+  }
+
+  KVPair *scratch;
+  if (posix_memalign((void **)&scratch, BLOCK_SIZE,
+                     round_up_page_size(sizeof(KVPair))) != 0) {
+    perror("posix_memalign");
+  }
+
+  vector<KVPair> kvpairs;
+  int num_pages = get_num_pages(fd);
+  int bytes;
+  KVPair *buff = fetch_page(fd, filename, num_pages - 1, scratch, bp, BP_COLD,
+                            &bytes, stats);
+  int upper_page_index = num_pages - 1;
+  bool searched = false;
+  if (buff != NULL && page_num_entries(buff, true) > 0 && key2 < buff[0].key) {
+    // The page of the first key above key2, which may hold lower ones too
+    upper_page_index = find_lower_bound_page(fd, filename, key2 + 1, scratch,
+                                             bp, stats);
+    searched = true;
+  }
+
+  size_t keys = 0;
+  for (int i = upper_page_index; i >= 0; i--) {
+    if (searched || i != num_pages - 1) {
+      buff = fetch_page(fd, filename, i, scratch, bp, BP_COLD, &bytes, stats);
+    }
+    if (buff == NULL) {
+      continue;
+    }
+    for (int j = page_num_entries(buff, i == num_pages - 1) - 1; j >= 0;
+         j--) {
+      if (key1 <= buff[j].key && buff[j].key <= key2) {
+        if (kvpairs.empty() || kvpairs.back().key != buff[j].key) {
+          if (keys++ == limit) {
+            goto end;
+          }
+        }
+        kvpairs.push_back(buff[j]);
+      } else if (buff[j].key < key1) {
+        goto end;
+      }
+    }
+  }
+
+end:
+  free(scratch);
+  close(fd);
+  reverse_key_order(kvpairs);
+  return kvpairs;
+}
+
+// Put the pairs of each key, read oldest first by a backward walk, newest
+// first again
+void reverse_key_order(vector<KVPair> &kvpairs) {
+  for (size_t i = 0; i < kvpairs.size();) {
+    size_t j = i;
+    while (j < kvpairs.size() && kvpairs[j].key == kvpairs[i].key) {
+      j++;
+    }
+    reverse(kvpairs.begin() + i, kvpairs.begin() + j);
+    i = j;
+  }
+}
+
 // Return the index of the page containing the first key greater or equal to the
-// given key The buffer will also be filled with the contents of the page.
-// Return -1 if all keys in the page are smaller than the given key.
-int find_lower_bound_page(int fd, uint64_t key, KVPair **buff) {
+// given key. Return -1, or the last page if it holds no pairs, if all keys in
+// the file are smaller than the given key.
+int find_lower_bound_page(int fd, string filename, uint64_t key,
+                          KVPair *scratch, BufferPool *bp, Statistics *stats) {
   int num_pages = get_num_pages(fd);
   int low = 0;
   int high = num_pages;  // Not num_pages - 1
@@ -183,9 +690,15 @@ int find_lower_bound_page(int fd, uint64_t key, KVPair **buff) {
 
   while (low < high) {
     mid = (high + low) / 2;
-    if (read_sst_page(fd, mid, buff) > 0) {
-      int num_entries = page_num_entries(*buff, mid == num_pages - 1);
-      if (key <= (*buff)[num_entries - 1].key) {
+    int bytes;
+    KVPair *buff =
+        fetch_page(fd, filename, mid, scratch, bp, BP_COLD, &bytes, stats);
+    if (buff != NULL) {
+      int num_entries = page_num_entries(buff, mid == num_pages - 1);
+      PERF_ADD(key_comparisons, 1);
+      // Only the last page can be empty, holding just the NULL_PAIR that ends
+      // the file, and no key lies past it
+      if (num_entries == 0 || key <= buff[num_entries - 1].key) {
         high = mid;
       } else {
         low = mid + 1;
@@ -195,107 +708,131 @@ int find_lower_bound_page(int fd, uint64_t key, KVPair **buff) {
     }
   }
 
-  return mid == num_pages ? -1 : mid;
+  return low == num_pages ? -1 : low;
 }
 
+// Return the newest value of a key visible at snapshot, TOMBSTONE if that
+// write was a delete, and its seq if seq isn't NULL. Throw KeyException if the
+// file has no such write.
 uint64_t sst_get(string filename, uint64_t key, BufferPool *bp,
-                 bool use_btree) {
+                 bool use_btree, Statistics *stats, uint64_t snapshot,
+                 uint64_t *seq) {
   int fd = open(filename.c_str(), O_RDONLY | O_DIRECT, FILE_PERMISSIONS);
   if (fd < 0) {
     perror("open");
   }
 
   int buff_size = round_up_page_size(sizeof(KVPair));
-  KVPair *buff;
-  if (posix_memalign((void **)&buff, BLOCK_SIZE, buff_size) != 0) {
+  KVPair *scratch;
+  if (posix_memalign((void **)&scratch, BLOCK_SIZE, buff_size) != 0) {
     perror("posix_memalign");
   }
 
-  int page_index = use_btree ? find_key_page_btree(fd, filename, key, &buff, bp)
-                             : find_key_page(fd, filename, key, &buff, bp);
+  KVPair *buff = scratch;
+  int page_index =
+      use_btree ? find_key_page_btree(fd, filename, key, &buff, bp)
+                : find_key_page(fd, filename, key, snapshot, &buff, bp, stats);
 
   if (page_index == -1) {
-    // free(buff); Don't free this because it points to a page in the buffer
-    // pool
+    free(scratch);
     close(fd);
     throw KeyException("Key not found in sst");
   }
 
   bool is_last_page = page_index == get_num_pages(fd) - 1 ? true : false;
   int num_entries = page_num_entries(buff, is_last_page);
-  uint64_t value = get_in_page(buff, key, num_entries);
-  // free(buff); Don't free this because it points to a page in the buffer pool
+  int index = find_in_page(buff, key, snapshot, num_entries);
+  KVPair found = index == -1 ? NULL_PAIR : buff[index];
+  free(scratch);
   close(fd);
-  return value;
+  if (index == -1) {
+    throw KeyException("Key not found in sst");
+  }
+  if (seq != NULL) {
+    *seq = found.seq;
+  }
+  return found.value;
 }
 
-// Find the value of a key in a page buffer. This function assumes the key
-// exists in the page.
-uint64_t get_in_page(KVPair *page, uint64_t key, int num_entries) {
-  int res = NULL_PAIR.value;
+// Find the newest value of a key visible at snapshot in a page buffer
+uint64_t get_in_page(KVPair *page, uint64_t key, uint64_t snapshot,
+                     int num_entries) {
+  int index = find_in_page(page, key, snapshot, num_entries);
+  if (index == -1) {
+    throw KeyException("Key not found in page");
+  }
+  return page[index].value;
+}
+
+// Return the index of the newest pair of a key visible at snapshot in a page
+// buffer, -1 if there is none
+int find_in_page(KVPair *page, uint64_t key, uint64_t snapshot,
+                 int num_entries) {
   int low = 0;
-  int high = num_entries - 1;
-  int mid;
+  int high = num_entries;
 
-  while (low <= high) {
+  while (low < high) {
     int mid = (high + low) / 2;
-    if (page[mid].key == key && page[mid].value == TOMBSTONE) {
-      break;
-    } else if (page[mid].key == key) {
-      return page[mid].value;
-    } else if (page[mid].key > key) {
-      high = mid - 1;
-    } else {
+    PERF_ADD(key_comparisons, 1);
+    if (precedes(page[mid], key, snapshot)) {
       low = mid + 1;
+    } else {
+      high = mid;
     }
   }
-  throw KeyException("Key not found in page");
+  if (low == num_entries || page[low].key != key) {
+    return -1;
+  }
+  return low;
 }
 
-// Return the index of the page containing a key. The buffer will also be filled
-// with the contents of the page.
-int find_key_page(int fd, string filename, uint64_t key, KVPair **buff,
-                  BufferPool *bp) {
+// Return the index of the first page whose last pair doesn't precede the
+// newest write to key visible at snapshot; that write is in this page if it is
+// in the file. The buffer will also be filled with the contents of the page.
+// Return -1, or the last page if it holds no pairs, if every pair precedes it.
+int find_key_page(int fd, string filename, uint64_t key, uint64_t snapshot,
+                  KVPair **buff, BufferPool *bp, Statistics *stats) {
   int num_pages = get_num_pages(fd);
+  KVPair *scratch = *buff;
 
   int low = 0;
-  int high = num_pages - 1;
-  int mid;
+  int high = num_pages;  // Not num_pages - 1
+  int loaded = -1;
 
-  while (low <= high) {
-    mid = (high + low) / 2;
-    KVPair *in_memory = bp->get(filename, mid);
+  while (low < high) {
+    int mid = (high + low) / 2;
     int bytes = 0;
-    if (in_memory != NULL) {
-      *buff = in_memory;
-      bytes = _PAGE_SIZE;
-    } else {
-      bytes = read_sst_page(fd, mid, buff);
-      if (bytes > 0) {
-        KVPair *buffer_pool_page;
-        if (posix_memalign((void **)&buffer_pool_page, BLOCK_SIZE, bytes) !=
-            0) {
-          perror("posix_memalign");
-        }
-        memcpy(buffer_pool_page, *buff, bytes);
-        bp->put(filename, mid, buffer_pool_page);
-      }
-    }
+    *buff =
+        fetch_page(fd, filename, mid, scratch, bp, BP_FILL, &bytes, stats);
+    loaded = mid;
     if (bytes > 0) {
       int num_entries = page_num_entries(*buff, mid == num_pages - 1);
-      if (key < (*buff)[0].key) {
-        high = mid - 1;
-      } else if (key > (*buff)[num_entries - 1].key) {
-        low = mid + 1;
+      PERF_ADD(key_comparisons, 1);
+      // Only the last page can be empty, holding just the NULL_PAIR that ends
+      // the file, and no key lies past it
+      if (num_entries == 0 ||
+          !precedes((*buff)[num_entries - 1], key, snapshot)) {
+        high = mid;
       } else {
-        return mid;
+        low = mid + 1;
       }
     } else {
-      high = mid - 1;
+      high = mid;
     }
   }
 
-  return -1;
+  if (low == num_pages) {
+    return -1;
+  }
+  if (loaded != low) {
+    int bytes = 0;
+    *buff =
+        fetch_page(fd, filename, low, scratch, bp, BP_FILL, &bytes, stats);
+    if (bytes <= 0) {
+      return -1;
+    }
+  }
+  return low;
 }
 
 // Return the index of the page containing a key. The buffer will also be filled
@@ -358,7 +895,10 @@ int page_num_entries(KVPair *page, bool is_last_page) {
   return i;
 }
 
-// Return the number of pages in an open file given its file descriptor
+// Return the number of pages of pairs in an open file given its file
+// descriptor. They are followed by a page of summaries for every
+// SST_PAGE_SUMMARIES of them, so of every SST_PAGE_SUMMARIES + 1 pages after
+// the header, started or not, one holds summaries.
 int get_num_pages(int fd) {
   double size_bytes = lseek(fd, 0, SEEK_END);
   if (size_bytes < 0) {
@@ -367,7 +907,8 @@ int get_num_pages(int fd) {
   if (lseek(fd, 0, SEEK_SET) < 0) {
     perror("lseek");
   }
-  return ceil(size_bytes / _PAGE_SIZE);
+  int pages = ceil((size_bytes - NODE_SIZE) / _PAGE_SIZE);
+  return pages - (pages + SST_PAGE_SUMMARIES) / (SST_PAGE_SUMMARIES + 1);
 }
 
 int round_up_block_size(int n) { return round_up(n, BLOCK_SIZE); }
@@ -382,3 +923,231 @@ int round_up(int n, int m) {
   int r = n % m;
   return r == 0 ? r : n + m - r;
 }
+
+uint64_t sst_magic(string filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    perror("open");
+    return 0;
+  }
+  uint64_t magic = 0;
+  if (pread(fd, &magic, sizeof(magic), (B - 1) * sizeof(uint64_t)) == -1) {
+    perror("pread");
+  }
+  close(fd);
+  return magic;
+}
+
+// Whether an SST stores sequence numbers with its pairs, which files written
+// before them don't
+bool sst_has_sequences(string filename) {
+  uint64_t magic = sst_magic(filename);
+  return magic == SST_MAGIC || magic == SST_MAGIC_V2;
+}
+
+// Whether an SST ends with page summaries. Page counts are only right for
+// files that do.
+bool sst_has_summaries(string filename) {
+  return sst_magic(filename) == SST_MAGIC;
+}
+
+// Read every pair of an SST written before pairs carried sequence numbers.
+// Their sequence numbers are left 0.
+vector<KVPair> read_sst_v1(string filename) {
+  vector<KVPair> kv_pairs;
+  ifstream file(filename, ios::binary);
+  file.seekg(NODE_SIZE);
+  uint64_t pair[2];
+  while (file.read((char *)pair, sizeof(pair)) &&
+         (pair[0] != NULL_PAIR.key || pair[1] != NULL_PAIR.value)) {
+    kv_pairs.push_back({pair[0], pair[1], 0});
+  }
+  return kv_pairs;
+}
+
+// The async versions of the lookups above. They read pages the same way, but a
+// page missing from the buffer pool is read by the IOService while the
+// coroutine is suspended, and the coroutine resumes on the executor.
+
+Task<KVPair *> fetch_page_async(int fd, string filename, int page_index,
+                                KVPair *scratch, BufferPool *bp, int hint,
+                                int *bytes, Statistics *stats, IOService *io,
+                                Executor *executor) {
+  if (bp != NULL) {
+    *bytes = bp->get_copy(filename, page_index, scratch, hint);
+    if (*bytes > 0) {
+      PERF_ADD(pages_from_pool, 1);
+      co_return scratch;
+    }
+  }
+
+  // Not timed into the perf context, which belongs to whichever thread runs
+  // the coroutine and may change while it is suspended
+  {
+    StopWatch timer(stats, SST_PAGE_READ);
+    PageRead read{io, executor, fd, scratch, _PAGE_SIZE,
+                  (off_t)NODE_SIZE + (off_t)page_index * _PAGE_SIZE};
+    *bytes = co_await read;
+  }
+  if (*bytes <= 0) {
+    co_return NULL;
+  }
+  page_read_done(filename, page_index, scratch, *bytes, bp, hint, stats);
+  co_return scratch;
+}
+
+Task<int> find_key_page_async(int fd, string filename, uint64_t key,
+                              uint64_t snapshot, KVPair **buff, BufferPool *bp,
+                              Statistics *stats, IOService *io,
+                              Executor *executor) {
+  int num_pages = get_num_pages(fd);
+  KVPair *scratch = *buff;
+
+  int low = 0;
+  int high = num_pages;
+  int loaded = -1;
+
+  while (low < high) {
+    int mid = (high + low) / 2;
+    int bytes = 0;
+    *buff = co_await fetch_page_async(fd, filename, mid, scratch, bp, BP_FILL,
+                                      &bytes, stats, io, executor);
+    loaded = mid;
+    if (bytes > 0) {
+      int num_entries = page_num_entries(*buff, mid == num_pages - 1);
+      PERF_ADD(key_comparisons, 1);
+      // Only the last page can be empty, holding just the NULL_PAIR that ends
+      // the file, and no key lies past it
+      if (num_entries == 0 ||
+          !precedes((*buff)[num_entries - 1], key, snapshot)) {
+        high = mid;
+      } else {
+        low = mid + 1;
+      }
+    } else {
+      high = mid;
+    }
+  }
+
+  if (low == num_pages) {
+    co_return -1;
+  }
+  if (loaded != low) {
+    int bytes = 0;
+    *buff = co_await fetch_page_async(fd, filename, low, scratch, bp, BP_FILL,
+                                      &bytes, stats, io, executor);
+    if (bytes <= 0) {
+      co_return -1;
+    }
+  }
+  co_return low;
+}
+
+Task<int> find_lower_bound_page_async(int fd, string filename, uint64_t key,
+                                      KVPair *scratch, BufferPool *bp,
+                                      Statistics *stats, IOService *io,
+                                      Executor *executor) {
+  int num_pages = get_num_pages(fd);
+  int low = 0;
+  int high = num_pages;
+
+  while (low < high) {
+    int mid = (high + low) / 2;
+    int bytes;
+    KVPair *buff = co_await fetch_page_async(
+        fd, filename, mid, scratch, bp, BP_COLD, &bytes, stats, io, executor);
+    if (buff != NULL) {
+      int num_entries = page_num_entries(buff, mid == num_pages - 1);
+      PERF_ADD(key_comparisons, 1);
+      // Only the last page can be empty, holding just the NULL_PAIR that ends
+      // the file, and no key lies past it
+      if (num_entries == 0 || key <= buff[num_entries - 1].key) {
+        high = mid;
+      } else {
+        low = mid + 1;
+      }
+    } else {
+      high = mid;
+    }
+  }
+
+  co_return low == num_pages ? -1 : low;
+}
+
+Task<uint64_t> sst_get_async(string filename, uint64_t key, BufferPool *bp,
+                             IOService *io, Executor *executor,
+                             Statistics *stats, uint64_t snapshot,
+                             uint64_t *seq) {
+  int fd = open(filename.c_str(), O_RDONLY | O_DIRECT, FILE_PERMISSIONS);
+  if (fd < 0) {
+    perror("open");
+  }
+
+  KVPair *scratch;
+  if (posix_memalign((void **)&scratch, BLOCK_SIZE,
+                     round_up_page_size(sizeof(KVPair))) != 0) {
+    perror("posix_memalign");
+  }
+
+  KVPair *buff = scratch;
+  int page_index = co_await find_key_page_async(
+      fd, filename, key, snapshot, &buff, bp, stats, io, executor);
+  int index = -1;
+  if (page_index != -1) {
+    int num_entries =
+        page_num_entries(buff, page_index == get_num_pages(fd) - 1);
+    index = find_in_page(buff, key, snapshot, num_entries);
+  }
+  KVPair found = index == -1 ? NULL_PAIR : buff[index];
+  free(scratch);
+  close(fd);
+  if (index == -1) {
+    throw KeyException("Key not found in sst");
+  }
+  if (seq != NULL) {
+    *seq = found.seq;
+  }
+  co_return found.value;
+}
+
+Task<vector<KVPair>> sst_scan_async(string filename, uint64_t key1,
+                                    uint64_t key2, BufferPool *bp,
+                                    IOService *io, Executor *executor,
+                                    Statistics *stats) {
+  int fd = open(filename.c_str(), O_RDONLY | O_DIRECT, FILE_PERMISSIONS);
+  if (fd < 0) {
+    perror("open");
+  }
+
+  KVPair *scratch;
+  if (posix_memalign((void **)&scratch, BLOCK_SIZE,
+                     round_up_page_size(sizeof(KVPair))) != 0) {
+    perror("posix_memalign");
+  }
+
+  vector<KVPair> kvpairs;
+  int lower_page_index = co_await find_lower_bound_page_async(
+      fd, filename, key1, scratch, bp, stats, io, executor);
+  int num_pages = lower_page_index == -1 ? 0 : get_num_pages(fd);
+  bool done = false;
+  for (int i = max(lower_page_index, 0); i < num_pages && !done; i++) {
+    int bytes;
+    KVPair *buff = co_await fetch_page_async(
+        fd, filename, i, scratch, bp, BP_COLD, &bytes, stats, io, executor);
+    if (buff == NULL) {
+      continue;
+    }
+    int num_entries = page_num_entries(buff, i == num_pages - 1);
+    for (int j = 0; j < num_entries && !done; j++) {
+      if (key1 <= buff[j].key && buff[j].key <= key2) {
+        kvpairs.push_back(buff[j]);
+      } else if (buff[j].key > key2) {
+        done = true;
+      }
+    }
+  }
+
+  free(scratch);
+  close(fd);
+  co_return kvpairs;
+}
@@ -9,12 +9,117 @@
 
 #include "kvpair.h"
 #include "buffer_pool.h"
+#include "statistics.h"
+#include "io_service.h"
+#include "task.h"
 
-void write_sst(std::vector<KVPair> kv_pairs, std::string filename);
-std::vector<KVPair> read_sst(std::string);
+// Summary of one SST page, kept after the pages so that a read covering the
+// page can use it instead of the page
+struct PageSummary {
+  uint64_t min_key;
+  uint64_t max_key;
+  uint64_t max_sequence;  // Without the operand flag
+  uint64_t flags;
+  uint64_t count;      // Of the values, tombstones not counted
+  uint64_t sum;        // Of the values, wrapping around
+  uint64_t min_value;  // MAX_KEY without any values
+  uint64_t max_value;
+};
 
-uint64_t sst_get(std::string, uint64_t, BufferPool*, bool);
-std::vector<KVPair> sst_scan(std::string, uint64_t, uint64_t);
+#define PAGE_DISTINCT 1 // Every pair is a value, and the only pair of its key in the file
+#define PAGE_OPERANDS 2 // Some pairs are merge operands
+
+// Write an SST and sync it, false if that fails
+bool write_sst(std::vector<KVPair> kv_pairs, std::string filename);
+
+// Builds an SST outside of any DB, for DB::ingest_files, from pairs added in
+// increasing key order. Each page is written as it fills; the summaries and
+// then the header follow in finish, so a file left unfinished is no SST.
+// Writers share nothing, so the files of disjoint key ranges can be built on
+// as many threads.
+struct SSTWriter {
+private:
+  int fd = -1;
+  KVPair *page = NULL;                // The page being filled
+  size_t num_entries = 0;             // In page
+  size_t num_pages = 0;               // Written
+  size_t num_pairs = 0;
+  uint64_t last_key = 0;
+  PageSummary summary;                // Of page
+  std::vector<PageSummary> summaries; // Of the pages written
+  std::vector<uint64_t> last_keys;    // Of the pages written, while the header has room
+  bool closed = false;                // By finish or a failed write
+
+  bool append(const KVPair &kvpair);
+
+public:
+  std::string filename;
+
+  SSTWriter(std::string filename);
+  SSTWriter(const SSTWriter &) = delete;
+  ~SSTWriter();
+  bool add(uint64_t key, uint64_t value); // False unless key is above the last one and value below TOMBSTONE, or if a write failed
+  bool finish(); // Write the rest of the file and sync it, false if it would be empty or a write failed
+};
+
+std::vector<KVPair> read_sst(std::string, BufferPool* bp = NULL,
+                             Statistics* stats = NULL);
+
+uint64_t sst_get(std::string, uint64_t, BufferPool*, bool,
+                 Statistics* stats = NULL, uint64_t snapshot = MAX_SEQUENCE,
+                 uint64_t* seq = NULL);
+std::vector<KVPair> sst_scan(std::string, uint64_t, uint64_t,
+                             BufferPool* bp = NULL, Statistics* stats = NULL,
+                             size_t limit = SIZE_MAX, bool reverse = false);
+// Like sst_get and sst_scan, suspending while pages missing from the buffer
+// pool are read and resuming on the executor
+Task<uint64_t> sst_get_async(std::string, uint64_t, BufferPool *, IOService *,
+                             Executor *, Statistics *stats = NULL,
+                             uint64_t snapshot = MAX_SEQUENCE,
+                             uint64_t *seq = NULL);
+Task<std::vector<KVPair>> sst_scan_async(std::string, uint64_t, uint64_t,
+                                         BufferPool *, IOService *, Executor *,
+                                         Statistics *stats = NULL);
+bool read_page_summaries(std::string, std::vector<PageSummary>*);
+std::vector<KVPair> sst_read_pages(std::string, const std::vector<int>&,
+                                   uint64_t, uint64_t, BufferPool* bp = NULL,
+                                   Statistics* stats = NULL);
+// The pairs in [key1, key2] of some pages of an SST in storage order, read a
+// page at a time. Without pages it reads like sst_scan.
+struct SSTCursor {
+private:
+  std::string filename;
+  int fd;
+  KVPair *scratch = NULL;
+  int num_pages = 0;
+  std::vector<int> pages;
+  size_t next_page = 0;
+  uint64_t key1;
+  uint64_t key2;
+  BufferPool *bp;
+  Statistics *stats;
+  std::vector<KVPair> page;  // The pairs in range of the page being read
+  size_t position = 0;
+
+  void read_page();
+
+public:
+  SSTCursor(std::string filename, const std::vector<int> *pages,
+            uint64_t key1, uint64_t key2, BufferPool *bp = NULL,
+            Statistics *stats = NULL);
+  SSTCursor(const SSTCursor &) = delete;
+  ~SSTCursor();
+  bool valid() const { return position < page.size(); }
+  const KVPair &get() const { return page[position]; }
+  void next();
+};
+
+bool prefetch_sst_page(std::string, int, BufferPool*,
+                       Statistics* stats = NULL);
+bool sst_has_sequences(std::string);
+bool sst_has_summaries(std::string);
+std::vector<KVPair> read_sst_v1(std::string);
+void reverse_key_order(std::vector<KVPair>&);
 
 int round_up_block_size(int);
 int round_up_page_size(int);
@@ -25,6 +130,10 @@ const unsigned int BLOCK_SIZE = 512;
 const unsigned int B = 256;
 const unsigned int NODE_SIZE = B * sizeof(uint64_t);
 const unsigned int _PAGE_SIZE = 4096;
+const unsigned int SST_PAGE_ENTRIES = _PAGE_SIZE / sizeof(KVPair);
+const unsigned int SST_PAGE_SUMMARIES = _PAGE_SIZE / sizeof(PageSummary);
+const uint64_t SST_MAGIC = 0x3376747373766b; // "kvsstv3", last word of the header
+const uint64_t SST_MAGIC_V2 = 0x3276747373766b; // "kvsstv2", before page summaries
 const std::string SST_EXTENSION = ".sst";
 
 #endif
@@ -0,0 +1,263 @@
+#include "statistics.h"
+
+#include <math.h>
+
+#include <sstream>
+#include <unordered_map>
+
+using namespace std;
+
+const char* HISTOGRAM_NAMES[HISTOGRAM_TYPES] = {
+    "db.put",        "db.get",       "db.delete",      "db.scan",
+    "db.merge",      "db.aggregate", "db.ingest",      "memtable.flush",
+    "sst.write",     "sst.page_read", "compaction"};
+
+const char* TICKER_NAMES[TICKER_TYPES] = {
+    "user.bytes_written", "user.bytes_read", "sst.bytes_written",
+    "sst.bytes_read"};
+
+int histogram_bucket(uint64_t value) {
+  if (value < (uint64_t)HISTOGRAM_SUB_BUCKETS) {
+    return value;
+  }
+  int magnitude = 63 - __builtin_clzll(value);
+  int shift = magnitude - HISTOGRAM_SUB_BUCKET_BITS;
+  return (shift + 1) * HISTOGRAM_SUB_BUCKETS +
+         (int)((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+}
+
+// Smallest value that falls in a bucket
+uint64_t histogram_bucket_low(int bucket) {
+  if (bucket < HISTOGRAM_SUB_BUCKETS) {
+    return bucket;
+  }
+  int shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+  return (uint64_t)(HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS)
+         << shift;
+}
+
+uint64_t histogram_bucket_width(int bucket) {
+  if (bucket < HISTOGRAM_SUB_BUCKETS) {
+    return 1;
+  }
+  return (uint64_t)1 << (bucket / HISTOGRAM_SUB_BUCKETS - 1);
+}
+
+Histogram::Histogram() : counts(HISTOGRAM_BUCKETS, 0) { clear(); }
+
+void Histogram::clear() {
+  fill(counts.begin(), counts.end(), 0);
+  count = 0;
+  sum = 0;
+  min = 0;
+  max = 0;
+}
+
+void Histogram::record(uint64_t value) {
+  counts[histogram_bucket(value)]++;
+  if (count == 0 || value < min) {
+    min = value;
+  }
+  if (value > max) {
+    max = value;
+  }
+  count++;
+  sum += value;
+}
+
+void Histogram::merge(const Histogram& other) {
+  if (other.count == 0) {
+    return;
+  }
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    counts[i] += other.counts[i];
+  }
+  if (count == 0 || other.min < min) {
+    min = other.min;
+  }
+  if (other.max > max) {
+    max = other.max;
+  }
+  count += other.count;
+  sum += other.sum;
+}
+
+// The largest value that is equivalent, within the bucket resolution, to the
+// value at the given percentile
+uint64_t Histogram::percentile(double p) const {
+  if (count == 0) {
+    return 0;
+  }
+  uint64_t rank = (uint64_t)ceil(p / 100.0 * count);
+  if (rank == 0) {
+    rank = 1;
+  }
+  uint64_t seen = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      uint64_t value = histogram_bucket_low(i) + histogram_bucket_width(i) - 1;
+      return value < min ? min : value > max ? max : value;
+    }
+  }
+  return max;
+}
+
+double Histogram::mean() const {
+  return count == 0 ? 0 : (double)sum / count;
+}
+
+// Each field of a thread's histograms is written only by that thread, so
+// relaxed loads and stores are enough and report() can read them at any time
+struct AtomicHistogram {
+  atomic<uint64_t> counts[HISTOGRAM_BUCKETS];
+  atomic<uint64_t> count;
+  atomic<uint64_t> sum;
+  atomic<uint64_t> min;
+  atomic<uint64_t> max;
+};
+
+struct Statistics::ThreadHistograms {
+  AtomicHistogram histograms[HISTOGRAM_TYPES];
+  atomic<uint64_t> tickers[TICKER_TYPES];
+};
+
+static void add_relaxed(atomic<uint64_t>& a, uint64_t n) {
+  a.store(a.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+// Histograms of this thread for every Statistics it has recorded into. The
+// last one used is cached since a thread usually records into a single DB.
+struct LocalHistograms {
+  uint64_t cached_id = 0;
+  Statistics::ThreadHistograms* cached = NULL;
+  unordered_map<uint64_t, weak_ptr<Statistics::ThreadHistograms>> by_id;
+};
+static thread_local LocalHistograms local_histograms;
+
+static atomic<uint64_t> next_statistics_id(1);
+
+Statistics::Statistics() { id = next_statistics_id++; }
+
+Statistics::ThreadHistograms* Statistics::local() {
+  LocalHistograms& local = local_histograms;
+  if (local.cached_id == id) {
+    return local.cached;
+  }
+
+  shared_ptr<ThreadHistograms> histograms;
+  auto it = local.by_id.find(id);
+  if (it != local.by_id.end()) {
+    histograms = it->second.lock();
+  }
+  if (histograms == NULL) {
+    histograms = make_shared<ThreadHistograms>();
+    {
+      lock_guard<mutex> guard(lock);
+      threads.push_back(histograms);
+    }
+    // Forget histograms of Statistics that have been destroyed
+    for (auto entry = local.by_id.begin(); entry != local.by_id.end();) {
+      entry = entry->second.expired() ? local.by_id.erase(entry) : next(entry);
+    }
+    local.by_id[id] = histograms;
+  }
+  local.cached_id = id;
+  local.cached = histograms.get();
+  return local.cached;
+}
+
+void Statistics::record(int type, uint64_t nanos) {
+  AtomicHistogram& h = local()->histograms[type];
+  add_relaxed(h.counts[histogram_bucket(nanos)], 1);
+  if (h.count.load(memory_order_relaxed) == 0 ||
+      nanos < h.min.load(memory_order_relaxed)) {
+    h.min.store(nanos, memory_order_relaxed);
+  }
+  if (nanos > h.max.load(memory_order_relaxed)) {
+    h.max.store(nanos, memory_order_relaxed);
+  }
+  add_relaxed(h.sum, nanos);
+  add_relaxed(h.count, 1);
+}
+
+void Statistics::add(int ticker, uint64_t n) {
+  add_relaxed(local()->tickers[ticker], n);
+}
+
+StatisticsReport Statistics::report() {
+  StatisticsReport report;
+  lock_guard<mutex> guard(lock);
+  Histogram snapshot;
+  for (auto& thread : threads) {
+    for (int type = 0; type < HISTOGRAM_TYPES; type++) {
+      AtomicHistogram& h = thread->histograms[type];
+      snapshot.clear();
+      // The count is taken from the buckets so percentiles stay consistent
+      // with them while the thread keeps recording
+      for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        snapshot.counts[i] = h.counts[i].load(memory_order_relaxed);
+        snapshot.count += snapshot.counts[i];
+      }
+      snapshot.sum = h.sum.load(memory_order_relaxed);
+      snapshot.min = h.min.load(memory_order_relaxed);
+      snapshot.max = h.max.load(memory_order_relaxed);
+      report.histograms[type].merge(snapshot);
+    }
+    for (int ticker = 0; ticker < TICKER_TYPES; ticker++) {
+      report.tickers[ticker] +=
+          thread->tickers[ticker].load(memory_order_relaxed);
+    }
+  }
+  return report;
+}
+
+// One line per histogram and ticker, times in nanoseconds
+string StatisticsReport::to_string() const {
+  ostringstream out;
+  for (int type = 0; type < HISTOGRAM_TYPES; type++) {
+    const Histogram& h = histograms[type];
+    out << HISTOGRAM_NAMES[type] << " count: " << h.count
+        << " mean: " << (uint64_t)h.mean() << " p50: " << h.percentile(50)
+        << " p95: " << h.percentile(95) << " p99: " << h.percentile(99)
+        << " p99.9: " << h.percentile(99.9) << " max: " << h.max << "\n";
+  }
+  for (int ticker = 0; ticker < TICKER_TYPES; ticker++) {
+    out << TICKER_NAMES[ticker] << " " << tickers[ticker] << "\n";
+  }
+  return out.str();
+}
+
+string StatisticsReport::to_json() const {
+  ostringstream out;
+  out << "{";
+  for (int type = 0; type < HISTOGRAM_TYPES; type++) {
+    const Histogram& h = histograms[type];
+    out << (type == 0 ? "" : ", ") << "\"" << HISTOGRAM_NAMES[type] << "\": {"
+        << "\"count\": " << h.count << ", \"mean_ns\": " << (uint64_t)h.mean()
+        << ", \"min_ns\": " << h.min << ", \"p50_ns\": " << h.percentile(50)
+        << ", \"p95_ns\": " << h.percentile(95)
+        << ", \"p99_ns\": " << h.percentile(99)
+        << ", \"p999_ns\": " << h.percentile(99.9) << ", \"max_ns\": " << h.max
+        << "}";
+  }
+  for (int ticker = 0; ticker < TICKER_TYPES; ticker++) {
+    out << ", \"" << TICKER_NAMES[ticker] << "\": " << tickers[ticker];
+  }
+  out << "}";
+  return out.str();
+}
+
+StopWatch::StopWatch(Statistics* stats, int type) : stats(stats), type(type) {
+  if (stats != NULL) {
+    start = chrono::steady_clock::now();
+  }
+}
+
+StopWatch::~StopWatch() {
+  if (stats != NULL) {
+    stats->record(type, chrono::duration_cast<chrono::nanoseconds>(
+                            chrono::steady_clock::now() - start)
+                            .count());
+  }
+}
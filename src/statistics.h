@@ -0,0 +1,110 @@
+#ifndef _STATISTICS_H
+#define _STATISTICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Values below HISTOGRAM_SUB_BUCKETS get a bucket each. Above that every power
+// of 2 range is split into HISTOGRAM_SUB_BUCKETS equal buckets, so a recorded
+// value is known to within 1 / HISTOGRAM_SUB_BUCKETS (about 3%) over the whole
+// uint64_t range.
+const int HISTOGRAM_SUB_BUCKET_BITS = 5;
+const int HISTOGRAM_SUB_BUCKETS = 1 << HISTOGRAM_SUB_BUCKET_BITS;
+const int HISTOGRAM_BUCKETS =
+    (64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS;
+
+int histogram_bucket(uint64_t value);
+uint64_t histogram_bucket_low(int bucket);
+uint64_t histogram_bucket_width(int bucket);
+
+// A log-linear (HDR style) histogram of non-negative values
+struct Histogram {
+  std::vector<uint64_t> counts;
+  uint64_t count;
+  uint64_t sum;
+  uint64_t min;
+  uint64_t max;
+
+  Histogram();
+  void record(uint64_t value);
+  void merge(const Histogram& other);
+  void clear();
+  uint64_t percentile(double p) const;  // p in [0, 100]
+  double mean() const;
+};
+
+// Operations and internal events whose latency (in nanoseconds) is tracked
+enum HistogramType {
+  DB_PUT,
+  DB_GET,
+  DB_DELETE,
+  DB_SCAN,
+  DB_MERGE,
+  DB_AGGREGATE,
+  DB_INGEST,
+  MEMTABLE_FLUSH,
+  SST_WRITE,
+  SST_PAGE_READ,  // One page read from disk, pages found in the pool excluded
+  COMPACTION,
+  HISTOGRAM_TYPES
+};
+
+extern const char* HISTOGRAM_NAMES[HISTOGRAM_TYPES];
+
+// Running totals
+enum TickerType {
+  USER_BYTES_WRITTEN,  // Key value pairs passed to put and del
+  USER_BYTES_READ,     // Key value pairs returned by get and scan
+  SST_BYTES_WRITTEN,
+  SST_BYTES_READ,  // Read from disk, pages found in the pool excluded
+  TICKER_TYPES
+};
+
+extern const char* TICKER_NAMES[TICKER_TYPES];
+
+// Histograms and tickers merged from every thread at one point in time
+struct StatisticsReport {
+  std::vector<Histogram> histograms;
+  std::vector<uint64_t> tickers;
+
+  StatisticsReport() : histograms(HISTOGRAM_TYPES), tickers(TICKER_TYPES, 0) {}
+  std::string to_string() const;
+  std::string to_json() const;
+};
+
+// Latency histograms and tickers for a DB. Each thread records into histograms
+// of its own, so recording takes no locks and no atomic read-modify-writes.
+// report() merges them. The histograms of a thread are kept after it exits.
+struct Statistics {
+  struct ThreadHistograms;
+
+  Statistics();
+  void record(int type, uint64_t nanos);
+  void add(int ticker, uint64_t n);
+  StatisticsReport report();
+
+ private:
+  ThreadHistograms* local();
+
+  uint64_t id;  // Unique for the life of the process, never reused
+  std::mutex lock;
+  std::vector<std::shared_ptr<ThreadHistograms>> threads;
+};
+
+// Record the time from construction to destruction. Does nothing when stats is
+// NULL.
+struct StopWatch {
+  Statistics* stats;
+  int type;
+  std::chrono::steady_clock::time_point start;
+
+  StopWatch(Statistics* stats, int type);
+  ~StopWatch();
+};
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef _TASK_H
+#define _TASK_H
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+// Where suspended coroutines are resumed once the I/O they wait on is done.
+// An event loop can queue them and resume them between its other work.
+struct Executor {
+  virtual ~Executor() {}
+  virtual void schedule(std::coroutine_handle<> handle) = 0;
+};
+
+// Resume on the thread that completed the I/O
+struct InlineExecutor : Executor {
+  void schedule(std::coroutine_handle<> handle) override { handle.resume(); }
+};
+
+// Hold coroutines until an event loop resumes them with run_pending, so
+// thousands of lookups can share the loop's thread
+struct QueueExecutor : Executor {
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<std::coroutine_handle<>> ready;
+
+  void schedule(std::coroutine_handle<> handle) override {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      ready.push_back(handle);
+    }
+    cv.notify_one();
+  }
+
+  // Resume the coroutines queued so far, first waiting up to timeout for one
+  // if none is. Return how many were resumed.
+  size_t run_pending(std::chrono::milliseconds timeout =
+                         std::chrono::milliseconds(0)) {
+    std::deque<std::coroutine_handle<>> batch;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      cv.wait_for(guard, timeout, [this]() { return !ready.empty(); });
+      batch.swap(ready);
+    }
+    for (auto handle : batch) {
+      handle.resume();
+    }
+    return batch.size();
+  }
+};
+
+// A coroutine producing a T. It starts when awaited and resumes its awaiter
+// when it finishes, handing over its value or rethrowing its exception.
+template <typename T>
+struct Task {
+  struct promise_type {
+    std::optional<T> value;
+    std::exception_ptr error;
+    std::coroutine_handle<> awaiter;
+
+    struct FinalAwaiter {
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(
+          std::coroutine_handle<promise_type> handle) noexcept {
+        std::coroutine_handle<> awaiter = handle.promise().awaiter;
+        return awaiter ? awaiter : std::noop_coroutine();
+      }
+      void await_resume() noexcept {}
+    };
+
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void return_value(T result) { value = std::move(result); }
+    void unhandled_exception() { error = std::current_exception(); }
+  };
+
+  std::coroutine_handle<promise_type> handle;
+
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+  Task(Task &&other) : handle(std::exchange(other.handle, nullptr)) {}
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+  ~Task() {
+    if (handle) {
+      handle.destroy();
+    }
+  }
+
+  bool await_ready() { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) {
+    handle.promise().awaiter = awaiter;
+    return handle;
+  }
+  T await_resume() {
+    if (handle.promise().error) {
+      std::rethrow_exception(handle.promise().error);
+    }
+    return std::move(*handle.promise().value);
+  }
+};
+
+// A coroutine nobody awaits, which frees itself when it finishes
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+// Start a task from code that isn't a coroutine. It runs on the calling
+// thread until it first suspends; done(value, error) is called when it
+// finishes, with error set if it threw.
+template <typename T, typename Callback>
+Detached spawn(Task<T> task, Callback done) {
+  std::optional<T> value;
+  std::exception_ptr error;
+  try {
+    value = co_await task;
+  } catch (...) {
+    error = std::current_exception();
+  }
+  done(value ? std::move(*value) : T(), error);
+}
+
+// Run a task and block until it finishes. Its coroutines must be resumed by
+// other threads, as with an InlineExecutor.
+template <typename T>
+T sync_wait(Task<T> task) {
+  std::mutex lock;
+  std::condition_variable cv;
+  bool done = false;
+  T value;
+  std::exception_ptr error;
+  spawn(std::move(task), [&](T result, std::exception_ptr e) {
+    std::lock_guard<std::mutex> guard(lock);
+    value = std::move(result);
+    error = e;
+    done = true;
+    cv.notify_one();
+  });
+  std::unique_lock<std::mutex> guard(lock);
+  cv.wait(guard, [&]() { return done; });
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return value;
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sst.h"
+
+using namespace std;
+
+bool TraceWriter::open(string filename) {
+  fd = ::open(filename.c_str(), O_CREAT | O_TRUNC | O_WRONLY, FILE_PERMISSIONS);
+  if (fd < 0) {
+    fprintf(stderr, "ERROR: Could not create trace %s. %s\n", filename.c_str(),
+            strerror(errno));
+    return false;
+  }
+  TraceHeader header;
+  memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+  header.version = TRACE_VERSION;
+  header.record_size = sizeof(TraceRecord);
+  if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+    perror("write");
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+  buffer.reserve(TRACE_BUFFER_RECORDS);
+  start = chrono::steady_clock::now();
+  return true;
+}
+
+void TraceWriter::record(uint32_t op, uint64_t key, uint64_t arg) {
+  TraceRecord record;
+  record.timestamp = chrono::duration_cast<chrono::nanoseconds>(
+                         chrono::steady_clock::now() - start)
+                         .count();
+  record.op = op;
+  record.unused = 0;
+  record.key = key;
+  record.arg = arg;
+
+  lock_guard<mutex> guard(lock);
+  if (fd < 0) {
+    return;  // Closed while the operation was running
+  }
+  buffer.push_back(record);
+  if (buffer.size() >= TRACE_BUFFER_RECORDS) {
+    write_buffer();
+  }
+}
+
+bool TraceWriter::write_buffer() {
+  size_t bytes = buffer.size() * sizeof(TraceRecord);
+  bool written = write(fd, buffer.data(), bytes) == (ssize_t)bytes;
+  if (!written) {
+    perror("write");
+  }
+  buffer.clear();
+  return written;
+}
+
+bool TraceWriter::close() {
+  lock_guard<mutex> guard(lock);
+  if (fd < 0) {
+    return true;
+  }
+  bool written = write_buffer();
+  ::close(fd);
+  fd = -1;
+  return written;
+}
+
+bool TraceReader::open(string filename) {
+  file = fopen(filename.c_str(), "rb");
+  if (file == NULL) {
+    fprintf(stderr, "ERROR: Could not open trace %s. %s\n", filename.c_str(),
+            strerror(errno));
+    return false;
+  }
+  TraceHeader header;
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != TRACE_VERSION ||
+      header.record_size != sizeof(TraceRecord)) {
+    fprintf(stderr, "ERROR: %s is not a version %u trace\n", filename.c_str(),
+            TRACE_VERSION);
+    close();
+    return false;
+  }
+  return true;
+}
+
+// A record cut short by a crash while tracing ends the trace
+bool TraceReader::next(TraceRecord *record) {
+  return file != NULL && fread(record, sizeof(TraceRecord), 1, file) == 1;
+}
+
+void TraceReader::close() {
+  if (file != NULL) {
+    fclose(file);
+    file = NULL;
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdio.h>
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Operations recorded in a trace
+#define TRACE_PUT 0
+#define TRACE_GET 1
+#define TRACE_DEL 2
+#define TRACE_SCAN 3
+#define TRACE_MERGE 4
+#define TRACE_DEL_RANGE 5
+
+// A trace file is a TraceHeader followed by fixed size TraceRecords in the
+// order the operations were called, in host byte order.
+struct TraceHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+};
+
+struct TraceRecord {
+  uint64_t timestamp;  // Nanoseconds since the trace was started
+  uint32_t op;
+  uint32_t unused;
+  uint64_t key;  // The key, or the lower bound of a scan
+  uint64_t arg;  // The value of a put, the operand of a merge, the upper bound of a scan or range deletion, otherwise 0
+};
+
+// Records the calls made to a DB. Records are collected in memory and written
+// a buffer at a time, so tracing costs a clock read and a copy per operation.
+struct TraceWriter {
+  int fd = -1;
+  std::vector<TraceRecord> buffer;
+  std::mutex lock;
+  std::chrono::steady_clock::time_point start;
+
+  bool open(std::string filename);
+  void record(uint32_t op, uint64_t key, uint64_t arg);
+  bool close();
+
+ private:
+  bool write_buffer();
+};
+
+struct TraceReader {
+  FILE *file = NULL;
+
+  bool open(std::string filename);
+  bool next(TraceRecord *record);  // Return false at the end of the trace
+  void close();
+};
+
+const char TRACE_MAGIC[8] = {'K', 'V', 'T', 'R', 'A', 'C', 'E', 0};
+const uint32_t TRACE_VERSION = 1;
+const size_t TRACE_BUFFER_RECORDS = 4096;
+
+#endif
@@ -0,0 +1,43 @@
+#include "version.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+using namespace std;
+
+SSTFile::~SSTFile() {
+  if (obsolete && unlink(path.c_str()) == -1) {
+    perror("unlink");
+  }
+}
+
+int Version::num_files_at_level(int level) const {
+  int count = 0;
+  for (auto& file : files) {
+    count += file->meta.level == level;
+  }
+  return count;
+}
+
+bool Version::overlaps(uint64_t min_key, uint64_t max_key) const {
+  for (auto& file : files) {
+    if (min_key <= file->meta.max_key && file->meta.min_key <= max_key) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Live keys in the SSTs, estimated from their entry counts. A tombstone is
+// assumed to hide one older entry, and keys written to several SSTs are
+// counted once per SST.
+uint64_t Version::estimate_live_keys() const {
+  uint64_t keys = 0;
+  for (auto& file : files) {
+    const FileMeta& meta = file->meta;
+    keys += meta.num_entries - min(meta.num_entries, 2 * meta.num_deletions);
+  }
+  return keys;
+}
@@ -0,0 +1,45 @@
+#ifndef _VERSION_H
+#define _VERSION_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "avl_tree.h"
+#include "manifest.h"
+#include "sst.h"
+
+// A live SST. Every Version listing the file holds a reference to it. Once a
+// compaction has replaced the file it is marked obsolete, and it is deleted
+// when the last Version holding it is released, so a read that started before
+// the compaction can still finish on it.
+struct SSTFile {
+  FileMeta meta;
+  std::string path;
+  std::atomic<bool> obsolete{false};
+  std::vector<PageSummary> summaries;  // Read by DB::page_summaries on first use
+  std::once_flag summaries_read;
+
+  SSTFile(const FileMeta& meta, std::string path) : meta(meta), path(path) {}
+  ~SSTFile();
+};
+
+// The state a read runs against: the memtable and the live SSTs at one point
+// in time. The file list of a Version never changes. A flush or a compaction
+// installs a new Version instead, and readers keep the one they started with
+// alive through their shared_ptr. Only the memtable of the current Version is
+// still written, under DB::memtable_lock.
+struct Version {
+  std::shared_ptr<Tree> memtable;
+  std::vector<std::shared_ptr<SSTFile>> files;  // Live SSTs, oldest first
+  std::vector<RangeTombstone> range_tombstones;  // Flushed range deletions, oldest first
+
+  int num_files_at_level(int level) const;
+  bool overlaps(uint64_t min_key, uint64_t max_key) const;  // Some file's key range does
+  uint64_t estimate_live_keys() const;
+};
+
+#endif
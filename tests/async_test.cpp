@@ -0,0 +1,154 @@
+#include <cassert>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#include "../src/db.h"
+#include "../src/exceptions.h"
+#include "../src/task.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+void cleanup() {
+  fs::remove_all("TEST_ASYNC");
+  fs::remove_all("TEST_ASYNC_QUEUE");
+}
+
+Task<int> square(int n) { co_return n * n; }
+
+Task<int> fail(int n) {
+  if (n > 0) {
+    throw runtime_error("fail");
+  }
+  co_return n;
+}
+
+Task<int> sum_of_squares(int n) {
+  int sum = 0;
+  for (int i = 1; i <= n; i++) {
+    sum += co_await square(i);
+  }
+  co_return sum;
+}
+
+void test_task() {
+  assert(sync_wait(square(7)) == 49);
+  assert(sync_wait(sum_of_squares(10)) == 385);
+
+  try {
+    sync_wait(fail(1));
+    assert(false);
+  } catch (const runtime_error& e) {
+  }
+  assert(sync_wait(fail(0)) == 0);
+
+  // A task doesn't run until it is awaited
+  bool ran = false;
+  auto lazy = [&]() -> Task<int> {
+    ran = true;
+    co_return 1;
+  };
+  Task<int> task = lazy();
+  assert(!ran);
+  assert(sync_wait(std::move(task)) == 1);
+  assert(ran);
+}
+
+// Read through a buffer pool a few pages big, so most page reads suspend
+void test_get_async() {
+  DB db;
+  db.open("TEST_ASYNC", 500, CLOCK, 4 * _PAGE_SIZE);
+  for (uint64_t i = 0; i < 3000; i++) {
+    db.put(i * 2, i);
+  }
+  for (uint64_t i = 0; i < 3000; i += 10) {
+    db.del(i * 2);
+  }
+  const Snapshot* snapshot = db.get_snapshot();
+  for (uint64_t i = 0; i < 3000; i += 3) {
+    db.put(i * 2, i + 1);
+  }
+
+  for (uint64_t key = 0; key < 6000; key += 7) {
+    bool found = true;
+    uint64_t value = 0;
+    try {
+      value = db.get(key);
+    } catch (const KeyException& e) {
+      found = false;
+    }
+    try {
+      assert(sync_wait(db.get_async(key)) == value);
+      assert(found);
+    } catch (const KeyException& e) {
+      assert(!found);
+    }
+  }
+
+  assert(sync_wait(db.get_async(6)) == 4);
+  assert(sync_wait(db.get_async(6, NULL, snapshot)) == 3);
+  try {
+    sync_wait(db.get_async(7));
+    assert(false);
+  } catch (const KeyException& e) {
+  }
+
+  assert(sync_wait(db.scan_async(100, 3000)) == db.scan(100, 3000));
+  assert(sync_wait(db.scan_async(0, 6000, NULL, snapshot)) ==
+         db.scan(0, 6000, snapshot));
+  assert(sync_wait(db.scan_async(7000, 8000)).empty());
+  db.release_snapshot(snapshot);
+  db.close();
+}
+
+// Many lookups in flight at once, all resumed by the thread running the queue
+void test_queue_executor() {
+  DB db;
+  db.open("TEST_ASYNC_QUEUE", 500, CLOCK, 4 * _PAGE_SIZE);
+  for (uint64_t i = 0; i < 3000; i++) {
+    db.put(i, i + 1);
+  }
+
+  QueueExecutor executor;
+  thread::id loop_thread = this_thread::get_id();
+  const int lookups = 2000;
+  int done = 0;
+  int missing = 0;
+  int expected_missing = 0;
+  for (int i = 0; i < lookups; i++) {
+    uint64_t key = (i * 7919) % 4000;
+    expected_missing += key >= 3000;
+    spawn(db.get_async(key, &executor),
+          [&, key](uint64_t value, exception_ptr error) {
+            assert(this_thread::get_id() == loop_thread);
+            if (error) {
+              assert(key >= 3000);
+              missing++;
+            } else {
+              assert(value == key + 1);
+            }
+            done++;
+          });
+  }
+  assert(done < lookups);  // Some are waiting on page reads
+  while (done < lookups) {
+    executor.run_pending(chrono::milliseconds(100));
+  }
+  assert(missing == expected_missing);
+  db.close();
+}
+
+int main() {
+  cleanup();
+
+  test_task();
+  test_get_async();
+  test_queue_executor();
+
+  cleanup();
+  cout << "Async tests passed!\n";
+  return 0;
+}
@@ -1,6 +1,7 @@
 #include "../src/avl_tree.h"
 
 #include <cassert>
+#include <cmath>
 #include <iostream>
 
 #include "../src/exceptions.h"
@@ -28,6 +29,16 @@ void test_get_put() {
   assert(!memtable.put(3, 6));
 }
 
+void test_size() {
+  Tree memtable(10);
+  assert(memtable.size() == 0);
+  memtable.put(4, 4);
+  memtable.put(2, 5);
+  memtable.put(4, 6);  // Updates don't add keys
+  assert(memtable.size() == 2);
+  assert(memtable.memory_usage() > 0);
+}
+
 void test_scan() {
   Tree memtable(5);
   vector<KVPair> sorted_kv_pairs = {
@@ -68,9 +79,101 @@ void test_scan() {
   }
 }
 
+void test_scan_skips_left_of_range() {
+  Tree memtable(10);
+  for (uint64_t key : {5, 2, 8, 3}) {
+    memtable.put(key, key * 10);
+  }
+  // 3 is in the right subtree of 2, which is below the range
+  vector<KVPair> scanned = memtable.scan(3, 10);
+  vector<KVPair> expected = {{3, 30}, {5, 50}, {8, 80}};
+  assert(scanned == expected);
+}
+
+void test_versions() {
+  Tree memtable(10);
+  memtable.put(1, 10, 1);
+  memtable.put(2, 20, 2);
+  memtable.put(1, 11, 3);
+  memtable.put(2, TOMBSTONE, 4);
+  assert(memtable.size() == 2);
+
+  uint64_t value;
+  assert(memtable.find(1, 3, &value) && value == 11);
+  assert(memtable.find(1, 2, &value) && value == 10);
+  assert(!memtable.find(1, 0, &value));
+  assert(memtable.find(2, 4, &value) && value == TOMBSTONE);
+  assert(memtable.find(2, 3, &value) && value == 20);
+  assert(!memtable.find(3, 4, &value));
+  try {
+    memtable.get(2);
+    assert(0);  // shouldn't get here
+  } catch (KeyException& e) {
+  }
+
+  vector<KVPair> versions = memtable.versions(MIN_KEY, MAX_KEY);
+  vector<KVPair> expected = {{1, 11}, {1, 10}, {2, TOMBSTONE}, {2, 20}};
+  assert(versions == expected);
+  assert(versions[0].seq == 3 && versions[1].seq == 1);
+  assert(memtable.scan(MIN_KEY, MAX_KEY).size() == 1);
+}
+
+void test_reverse_and_limit() {
+  Tree memtable(10);
+  for (uint64_t key = 1; key <= 8; key++) {
+    memtable.put(key, key * 10, key);
+  }
+  memtable.put(3, 31, 9);
+  memtable.put(6, TOMBSTONE, 10);
+
+  vector<KVPair> expected = {{8, 80}, {7, 70}, {5, 50}, {4, 40}};
+  assert(memtable.scan(2, 8, 5, true) == expected);  // 6 counts against the limit
+  expected = {{2, 20}, {3, 31}};
+  assert(memtable.scan(2, 8, 2) == expected);
+  assert(memtable.scan(2, 8, 0).empty());
+  assert(memtable.scan(9, 20, 3, true).empty());
+
+  expected = {{4, 40}, {3, 31}, {3, 30}};
+  vector<KVPair> versions = memtable.versions(1, 4, 2, true);
+  assert(versions == expected);
+  assert(versions[1].seq == 9 && versions[2].seq == 3);
+  expected = {{6, TOMBSTONE}, {6, 60}, {7, 70}};
+  assert(memtable.versions(6, MAX_KEY, 2) == expected);
+}
+
+void test_append() {
+  Tree memtable(200000);
+  for (uint64_t key = 1000; key < 100000; key++) {
+    memtable.put(key, key);
+  }
+  // Appends stay balanced, within the AVL bound of 1.44 log2(n)
+  assert(memtable.height() <= 1.44 * log2(memtable.size()));
+
+  // Out of order and repeated keys after appends
+  for (uint64_t key = 0; key < 1000; key++) {
+    memtable.put(key, key);
+  }
+  memtable.put(99999, 1, 1);
+  memtable.put(100000, 2, 2);
+  assert(memtable.size() == 100001);
+  assert(memtable.height() <= 1.44 * log2(memtable.size()));
+  vector<KVPair> scanned = memtable.scan(MIN_KEY, MAX_KEY);
+  assert(scanned.size() == 100001);
+  for (uint64_t key = 0; key < 99999; key++) {
+    assert(scanned[key] == KVPair({key, key}));
+  }
+  assert(memtable.get(99999) == 1 && memtable.get(100000) == 2);
+  assert(memtable.versions(99999, 99999).size() == 2);
+}
+
 int main() {
   test_get_put();
+  test_size();
+  test_scan_skips_left_of_range();
+  test_versions();
   test_scan();
+  test_reverse_and_limit();
+  test_append();
   cout << "AVL tree tests passed!\n";
   return 0;
 }
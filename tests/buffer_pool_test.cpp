@@ -37,6 +37,18 @@ void test_put_get() {
   }
 }
 
+void test_get_copy() {
+  BufferPool bp = BufferPool(4, 4);
+  KVPair* page = dummy_page(1, 10);
+  bp.put("sst", 0, page, 512);
+
+  KVPair* copy = (KVPair*)malloc(_PAGE_SIZE);
+  assert(bp.get_copy("sst", 0, copy) == 512);
+  compare_pages(copy, page);
+  assert(bp.get_copy("sst", 1, copy) == 0);
+  free(copy);
+}
+
 void test_rehash() {
   int capacity = 256;
   int max_capacity = capacity * 2;
@@ -139,6 +151,84 @@ void test_shrink() {
   assert(num_pages == bp.num_pages);
 }
 
+void test_byte_budget() {
+  size_t budget = 16 * _PAGE_SIZE;
+  BufferPool bp = BufferPool(4, 16, DEFAULT_EXTEND_THRESHOLD, LRU, budget);
+
+  for (int i = 0; i < 64; i++) {
+    bp.put("sst", i, dummy_page(i + 1, (i + 1) * 10), _PAGE_SIZE);
+    assert(bp.used_bytes <= budget);
+  }
+  assert(bp.num_pages == 16);
+  assert(bp.used_bytes == budget);
+
+  // LRU keeps the most recently inserted pages
+  for (int i = 0; i < 48; i++) {
+    assert(bp.get("sst", i) == NULL);
+  }
+  for (int i = 48; i < 64; i++) {
+    assert(bp.get("sst", i)[0].key == (uint64_t)i + 1);
+  }
+  assert(bp.memory_usage() >= bp.used_bytes);
+}
+
+void test_shrink_bytes_incremental() {
+  size_t budget = 64 * _PAGE_SIZE;
+  BufferPool bp = BufferPool(4, 64, DEFAULT_EXTEND_THRESHOLD, CLOCK, budget);
+
+  for (int i = 0; i < 64; i++) {
+    bp.put("sst", i, dummy_page(i + 1, (i + 1) * 10));
+  }
+  assert(bp.used_bytes == budget);
+
+  // Shrinking evicts a bounded batch of pages and returns
+  bp.resize_bytes(8 * _PAGE_SIZE);
+  assert(bp.is_resizing());
+  assert(bp.num_pages == 64 - RESIZE_STEP_PAGES);
+
+  // Later operations finish the shrink
+  int ops = 0;
+  while (bp.is_resizing()) {
+    bp.get("sst", 0);
+    ops++;
+  }
+  assert(ops > 1);
+  assert(bp.used_bytes <= 8 * _PAGE_SIZE);
+
+  // Growing takes effect immediately and lets the directory extend further
+  bp.resize_bytes(256 * _PAGE_SIZE);
+  assert(!bp.is_resizing());
+  assert(bp.max_capacity == 256);
+  for (int i = 64; i < 256; i++) {
+    bp.put("sst", i, dummy_page(i + 1, (i + 1) * 10));
+  }
+  assert(bp.used_bytes <= 256 * _PAGE_SIZE);
+  assert(bp.get("sst", 255)[0].key == 256);
+}
+
+void test_cold_insert(int policy) {
+  BufferPool bp = BufferPool(8, 8, DEFAULT_EXTEND_THRESHOLD, policy);
+
+  // Point lookups warm a few pages
+  for (int i = 0; i < 4; i++) {
+    bp.put("hot", i, dummy_page(i + 1, (i + 1) * 10));
+    assert(bp.get("hot", i) != NULL);
+  }
+
+  // A scan streams many more pages than fit through the cold end
+  for (int i = 0; i < 32; i++) {
+    bp.put("scan", i, dummy_page(i + 1, (i + 1) * 10), _PAGE_SIZE, BP_COLD);
+  }
+  assert(bp.num_pages == 8);
+  for (int i = 0; i < 4; i++) {
+    assert(bp.get("hot", i) != NULL);
+  }
+
+  // Bypass reads see cached pages without promoting them
+  assert(bp.get("scan", 31, BP_BYPASS) != NULL);
+  assert(bp.get("scan", 30, BP_BYPASS) == NULL);
+}
+
 void test_lru_access() {
   LRUReplacer lru = LRUReplacer();
   vector<KVPair*> pages;
@@ -239,9 +329,14 @@ void test_clock_evict() {
 
 int main() {
   test_put_get();
+  test_get_copy();
   test_rehash();
   test_extend();
   test_shrink();
+  test_byte_budget();
+  test_shrink_bytes_incremental();
+  test_cold_insert(LRU);
+  test_cold_insert(CLOCK);
   cout << "Buffer pool tests passed!\n";
   test_lru_access();
   test_lru_evict();
@@ -1,13 +1,19 @@
 #include "../src/db.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <set>
+#include <thread>
 
 #include "../src/exceptions.h"
+#include "../src/perf_context.h"
 
 using namespace std;
 namespace fs = std::filesystem;
@@ -21,6 +27,30 @@ void cleanup() {
   fs::remove_all("SORTED_SSTS");
   fs::remove_all("TEST_BIG_ONE_SST");
   fs::remove_all("TEST_BIG_MANY_SSTS");
+  fs::remove_all("TEST_ROW_CACHE");
+  fs::remove_all("TEST_WARM_RESTART");
+  fs::remove_all("TEST_LEGACY");
+  fs::remove_all("TEST_STATISTICS");
+  fs::remove_all("TEST_PERF_CONTEXT");
+  fs::remove_all("TEST_PROPERTIES");
+  fs::remove_all("TEST_TRACE");
+  fs::remove("TEST_TRACE.trace");
+  fs::remove_all("TEST_CONCURRENT");
+  fs::remove_all("TEST_WRITE_BATCH");
+  fs::remove_all("TEST_FAILED_FLUSH");
+  fs::remove_all("TEST_COMPACTION");
+  fs::remove_all("TEST_AUTO_COMPACTION");
+  fs::remove_all("TEST_APPEND_ONLY");
+  fs::remove_all("TEST_SNAPSHOT");
+  fs::remove_all("TEST_CONCURRENT_SNAPSHOTS");
+  fs::remove_all("TEST_DELETE");
+  fs::remove_all("TEST_MERGE");
+  fs::remove_all("TEST_DELETE_RANGE");
+  fs::remove_all("TEST_AGGREGATE");
+  fs::remove_all("TEST_SCAN_FILTERED");
+  fs::remove_all("TEST_REVERSE_SCAN");
+  fs::remove_all("TEST_INGEST");
+  fs::remove_all("TEST_INGEST_FILES");
 }
 
 void test_open_close() {
@@ -50,7 +80,7 @@ void test_open_close() {
 
   assert(db.close());
 
-  assert(fs::exists("TEST_DB/" + METADATA_FILE));
+  assert(fs::exists("TEST_DB/" + MANIFEST_FILE));
   assert(fs::exists(sst_name));
 
   DB db2;
@@ -251,6 +281,1164 @@ void test_big_data_many_ssts() {
   db.close();
 }
 
+void test_row_cache() {
+  DB db;
+  db.open("TEST_ROW_CACHE", 4, CLOCK, DEFAULT_BUFFER_POOL_BYTES, 1 << 20);
+  assert(db.row_cache != NULL);
+
+  for (uint64_t i = 0; i < 40; i++) {
+    db.put(i, i * 10);
+  }
+
+  // First lookups fill the cache, later ones are served from it
+  uint64_t value;
+  assert(db.get(5) == 50);
+  assert(db.row_cache->get(5, &value) == ROW_FOUND && value == 50);
+  assert(db.get(5) == 50);
+
+  try {
+    db.get(1000);
+    assert(0);  // shouldn't get here
+  } catch (KeyException& e) {
+  }
+  assert(db.row_cache->get(1000, &value) == ROW_ABSENT);
+
+  // Writes invalidate cached rows
+  db.put(5, 51);
+  assert(db.row_cache->get(5, &value) == ROW_MISS);
+  assert(db.get(5) == 51);
+  db.put(1000, 1);
+  assert(db.get(1000) == 1);
+
+  db.close();
+}
+
+void test_warm_restart() {
+  DB db;
+  int memtable_size = 256;
+  db.open("TEST_WARM_RESTART", memtable_size);
+
+  for (uint64_t i = 0; i < 20 * memtable_size; i++) {
+    db.put(i, i + 1);
+  }
+  for (uint64_t i = 0; i < 20 * memtable_size; i += memtable_size) {
+    db.get(i);
+  }
+  auto cached = db.buffer_pool->resident_by_hotness();
+  assert(cached.size() > 0);
+  assert(db.close());
+  assert(fs::exists("TEST_WARM_RESTART/" + BUFFER_POOL_STATE_FILE));
+
+  // The same pages are cached again after reopening, before any reads
+  assert(db.open("TEST_WARM_RESTART"));
+  db.wait_for_prefetch();
+  assert(db.buffer_pool->num_pages == (int)cached.size());
+  for (auto& page : cached) {
+    assert(db.buffer_pool->get(page.first, page.second, BP_BYPASS) != NULL);
+  }
+  assert(db.get(memtable_size) == memtable_size + 1);
+
+  // Requests are served while the pool is still warming up
+  assert(db.close());
+  assert(db.open("TEST_WARM_RESTART"));
+  assert(db.get(0) == 1);
+  assert(db.close());
+}
+
+// Write an SST the way it was laid out before pairs carried sequence numbers
+void write_legacy_sst(vector<KVPair> kvpairs, string filename) {
+  ofstream file(filename, ios::binary);
+  vector<char> header(NODE_SIZE, 0);
+  file.write(header.data(), header.size());
+  kvpairs.push_back(NULL_PAIR);
+  for (auto& kvpair : kvpairs) {
+    uint64_t pair[2] = {kvpair.key, kvpair.value};
+    file.write((char*)pair, sizeof(pair));
+  }
+}
+
+void test_legacy_upgrade() {
+  // Lay out a database the way it was written before manifests: a metadata
+  // block and SSTs whose order is only known from their file numbers
+  fs::create_directory("TEST_LEGACY");
+  int legacy_metadata[BLOCK_SIZE / sizeof(int)] = {2, 3, 6};
+  ofstream metadata_file("TEST_LEGACY/" + METADATA_FILE, ios::binary);
+  metadata_file.write((char*)legacy_metadata, sizeof(legacy_metadata));
+  metadata_file.close();
+  write_legacy_sst({{.key = 5, .value = 1}, {.key = 6, .value = 1}},
+                   "TEST_LEGACY/2.sst");
+  write_legacy_sst({{.key = 1, .value = 1}, {.key = 2, .value = 1}},
+                   "TEST_LEGACY/0.sst");
+  write_legacy_sst({{.key = 3, .value = 2}, {.key = 4, .value = 1}},
+                   "TEST_LEGACY/1.sst");
+
+  DB db;
+  assert(db.open("TEST_LEGACY"));
+  assert(db.metadata.memtable_size == 2);
+  assert(db.metadata.next_sst_id == 3);
+  assert(db.metadata.num_elems == 6);
+  assert(db.sst_names.size() == 3);
+  for (int i = 0; i < 3; i++) {
+    assert(db.sst_names[i] == "TEST_LEGACY/" + to_string(i) + SST_EXTENSION);
+  }
+  assert(db.manifest.files[1].min_key == 3 && db.manifest.files[1].max_key == 4);
+  assert(db.get(3) == 2);
+  assert(db.get(4) == 1);
+  // The SSTs were rewritten with increasing sequence numbers
+  for (int i = 0; i < 3; i++) {
+    assert(sst_has_sequences(db.sst_names[i]));
+  }
+  assert(db.manifest.files[0].max_sequence < db.manifest.files[1].max_sequence);
+  assert(db.manifest.files[1].max_sequence < db.manifest.files[2].max_sequence);
+  assert(db.metadata.last_sequence >= db.manifest.files[2].max_sequence);
+  assert(!fs::exists("TEST_LEGACY/" + METADATA_FILE));
+  assert(fs::exists("TEST_LEGACY/" + MANIFEST_FILE));
+  assert(db.close());
+
+  assert(db.open("TEST_LEGACY"));
+  assert(db.sst_names.size() == 3);
+  assert(db.close());
+}
+
+void test_statistics() {
+  DB db;
+  db.open("TEST_STATISTICS", 10);
+
+  for (uint64_t i = 0; i < 100; i++) {
+    db.put(i, i);
+  }
+  db.del(3);
+  for (uint64_t i = 0; i < 50; i++) {
+    db.get(i + 4);
+  }
+  db.scan(10, 20);
+
+  StatisticsReport report = db.get_statistics();
+  assert(report.histograms[DB_PUT].count == 100);
+  assert(report.histograms[DB_DELETE].count == 1);
+  assert(report.histograms[DB_GET].count == 50);
+  assert(report.histograms[DB_SCAN].count == 1);
+  assert(report.histograms[MEMTABLE_FLUSH].count == 10);
+  assert(report.histograms[SST_WRITE].count == 10);
+  assert(report.histograms[SST_PAGE_READ].count > 0);
+  assert(report.histograms[DB_GET].percentile(99) <=
+         report.histograms[DB_GET].max);
+  assert(report.to_json().find("\"db.get\": {\"count\": 50,") !=
+         string::npos);
+  db.close();
+}
+
+void test_perf_context() {
+  DB db;
+  db.open("TEST_PERF_CONTEXT", 10);
+  for (uint64_t i = 0; i < 100; i++) {
+    db.put(i, i);
+  }
+  PerfContext* context = get_perf_context();
+  set_perf_level(PERF_TIME);
+
+  // Key 5 is in the oldest SST, so every SST with a matching range is probed
+  context->reset();
+  assert(db.get(5) == 5);
+  assert(context->range_filter_positive + context->range_filter_negative ==
+         db.manifest.files.size());
+  assert(context->ssts_probed == context->range_filter_positive);
+  assert(context->pages_from_disk + context->pages_from_pool > 0);
+  assert(context->key_comparisons > 0);
+  assert(context->sst_nanos >= context->page_read_nanos);
+
+  // A second lookup finds the page in the buffer pool
+  context->reset();
+  assert(db.get(5) == 5);
+  assert(context->pages_from_disk == 0 && context->bytes_read == 0);
+  assert(context->pages_from_pool > 0);
+
+  // The newest key is served by the memtable alone
+  db.put(1000, 1);
+  context->reset();
+  assert(db.get(1000) == 1);
+  assert(context->ssts_probed == 0 && context->memtable_nanos > 0);
+
+  context->reset();
+  db.scan(0, 99);
+  assert(context->ssts_probed == db.sst_names.size());
+
+  set_perf_level(PERF_DISABLED);
+  db.close();
+}
+
+void test_properties() {
+  DB db;
+  db.open("TEST_PROPERTIES", 10, CLOCK, DEFAULT_BUFFER_POOL_BYTES, 1 << 16);
+  for (uint64_t i = 0; i < 50; i++) {
+    db.put(i, i);
+  }
+  // Ten updates of one key flush an SST with a single entry
+  for (int i = 0; i < 10; i++) {
+    db.put(0, i);
+  }
+  db.put(100, 1);
+
+  // Only that one overlaps the files before it
+  uint64_t value;
+  assert(db.get_int_property("kvdb.num-files", &value) && value == 6);
+  assert(db.get_int_property("kvdb.num-files-at-level0", &value) && value == 1);
+  assert(db.get_int_property("kvdb.num-files-at-level1", &value) && value == 5);
+  assert(!db.get_int_property("kvdb.num-files-at-levelx", &value));
+  assert(!db.get_int_property("kvdb.no-such-property", &value));
+  assert(db.get_int_property("kvdb.num-entries-memtable", &value) && value == 1);
+  assert(db.get_int_property("kvdb.estimate-num-keys", &value) && value == 52);
+  assert(db.metadata.num_elems == 51);
+
+  uint64_t sst_bytes = 0;
+  for (auto& sst : db.sst_names) {
+    sst_bytes += fs::file_size(sst);
+  }
+  assert(db.get_int_property("kvdb.total-sst-bytes", &value) &&
+         value == sst_bytes);
+
+  uint64_t total, part, parts = 0;
+  db.get_int_property("kvdb.memory.total", &total);
+  for (string name : {"memtable", "buffer-pool", "row-cache", "manifest"}) {
+    assert(db.get_int_property("kvdb.memory." + name, &part) && part > 0);
+    parts += part;
+  }
+  assert(total == parts);
+
+  string text;
+  assert(db.get_property("kvdb.num-files", &text) && text == "6");
+  assert(db.get_property("kvdb.sstables", &text));
+  assert(count(text.begin(), text.end(), '\n') == 7);
+  assert(text.find("\n5.sst 0 1 0 ") != string::npos);
+  uint64_t level0_bytes = fs::file_size(db.sst_names.back());
+  assert(db.get_property("kvdb.levelstats", &text) &&
+         text == "level files bytes\n0 1 " + to_string(level0_bytes) +
+                     "\n1 5 " + to_string(sst_bytes - level0_bytes) + "\n");
+
+  // Every user byte written went through a flush into an SST at least once
+  db.get_property("kvdb.write-amplification", &text);
+  assert(stod(text) >= 1.0);
+  db.get(25);
+  db.get_property("kvdb.read-amplification", &text);
+  assert(stod(text) > 1.0);
+  db.get_property("kvdb.space-amplification", &text);
+  assert(stod(text) > 1.0);
+  assert(db.get_property("kvdb.stats", &text));
+  assert(text.find("kvdb.estimate-num-keys: 52\n") != string::npos);
+  assert(text.find("kvdb.memory.total: ") != string::npos);
+  assert(!db.get_property("kvdb.no-such-property", &text));
+  db.close();
+}
+
+void test_trace() {
+  DB db;
+  db.open("TEST_TRACE", 10);
+  db.put(1, 10);  // Not traced
+  assert(db.start_trace("TEST_TRACE.trace"));
+  db.put(2, 20);
+  db.get(1);
+  try {
+    db.get(3);
+  } catch (KeyException& e) {
+  }
+  db.del(2);
+  db.scan(1, 5);
+  assert(db.end_trace());
+  db.put(4, 40);  // Not traced
+  db.close();
+
+  TraceReader reader;
+  assert(reader.open("TEST_TRACE.trace"));
+  TraceRecord expected[] = {{0, TRACE_PUT, 0, 2, 20},
+                            {0, TRACE_GET, 0, 1, 0},
+                            {0, TRACE_GET, 0, 3, 0},
+                            {0, TRACE_DEL, 0, 2, 0},
+                            {0, TRACE_SCAN, 0, 1, 5}};
+  TraceRecord record;
+  for (auto& e : expected) {
+    assert(reader.next(&record));
+    assert(record.op == e.op && record.key == e.key && record.arg == e.arg);
+  }
+  assert(!reader.next(&record));
+  reader.close();
+}
+
+// Writers update disjoint keys twice while readers check that every value
+// they see was written by one of the two passes
+void test_concurrent() {
+  DB db;
+  db.open("TEST_CONCURRENT", 64, CLOCK, DEFAULT_BUFFER_POOL_BYTES, 1 << 16);
+  const int num_writers = 4;
+  const uint64_t keys_per_writer = 500;
+  const uint64_t num_keys = num_writers * keys_per_writer;
+  atomic<int> writers_left(num_writers);
+  atomic<bool> bad_read(false);
+
+  vector<thread> threads;
+  for (int t = 0; t < num_writers; t++) {
+    threads.push_back(thread([&, t]() {
+      for (uint64_t pass = 2; pass <= 3; pass++) {
+        for (uint64_t i = 0; i < keys_per_writer; i++) {
+          uint64_t key = i * num_writers + t + 1;
+          db.put(key, key * pass);
+        }
+      }
+      writers_left--;
+    }));
+  }
+  for (int t = 0; t < 4; t++) {
+    threads.push_back(thread([&, t]() {
+      uint64_t key = t + 1;
+      while (writers_left > 0) {
+        key = key * 7 % num_keys + 1;
+        if (t % 2 == 0) {
+          try {
+            uint64_t value = db.get(key);
+            if (value != key * 2 && value != key * 3) {
+              bad_read = true;
+            }
+          } catch (KeyException& e) {
+          }
+        } else {
+          for (auto& kvpair : db.scan(key, key + 20)) {
+            if (kvpair.value != kvpair.key * 2 &&
+                kvpair.value != kvpair.key * 3) {
+              bad_read = true;
+            }
+          }
+        }
+      }
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  assert(!bad_read);
+
+  for (uint64_t key = 1; key <= num_keys; key++) {
+    assert(db.get(key) == key * 3);
+  }
+  assert(db.metadata.last_sequence == 2 * num_keys);
+  db.close();
+
+  db.open("TEST_CONCURRENT");
+  for (uint64_t key = 1; key <= num_keys; key++) {
+    assert(db.get(key) == key * 3);
+  }
+  db.close();
+}
+
+void test_write_batch() {
+  DB db;
+  db.open("TEST_WRITE_BATCH", 64);
+  // Groups longer than MAX_WRITE_BATCH from several threads, next to single
+  // puts, through many flushes
+  const int num_writers = 4;
+  const uint64_t keys_per_writer = 1000;
+  vector<thread> threads;
+  for (int t = 0; t < num_writers; t++) {
+    threads.push_back(thread([&, t]() {
+      uint64_t first = t * keys_per_writer + 1;
+      for (uint64_t key = first; key < first + keys_per_writer; key += 200) {
+        vector<KVPair> kvpairs;
+        for (uint64_t i = key; i < key + 200; i++) {
+          kvpairs.push_back({i, i});
+          // Later pairs in a batch win
+          kvpairs.push_back({i, i * 2});
+        }
+        db.write_batch(kvpairs);
+        db.put(key, key * 3);
+      }
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  const uint64_t num_keys = num_writers * keys_per_writer;
+  for (uint64_t key = 1; key <= num_keys; key++) {
+    assert(db.get(key) == (key % 200 == 1 ? key * 3 : key * 2));
+  }
+  assert(db.metadata.last_sequence == 2 * num_keys + num_keys / 200);
+
+  db.write_batch({{1, TOMBSTONE}, {2, 5}, {3, TOMBSTONE}});
+  db.write_batch({});
+  vector<KVPair> kvpairs = db.scan(1, 4);
+  assert(kvpairs.size() == 2);
+  assert(kvpairs[0].key == 2 && kvpairs[0].value == 5);
+  assert(kvpairs[1].key == 4 && kvpairs[1].value == 8);
+  db.close();
+}
+
+int count_ssts(string db_name) {
+  int count = 0;
+  for (auto& entry : fs::directory_iterator(db_name)) {
+    count += entry.path().extension() == SST_EXTENSION;
+  }
+  return count;
+}
+
+// A flush whose manifest edit can't be logged keeps the memtable
+void test_failed_flush() {
+  DB db;
+  db.open("TEST_FAILED_FLUSH", 64);
+  int manifest_fd = db.manifest.fd;
+  db.manifest.fd = open("TEST_FAILED_FLUSH/MANIFEST", O_RDONLY);
+  for (uint64_t key = 1; key <= 65; key++) {
+    db.put(key, key);
+  }
+  assert(count_ssts("TEST_FAILED_FLUSH") == 0);
+  assert(db.sst_names.empty());
+  for (uint64_t key = 1; key <= 65; key++) {
+    assert(db.get(key) == key);
+  }
+  close(db.manifest.fd);
+  db.manifest.fd = manifest_fd;
+  assert(db.manifest.checkpoint());
+  assert(db.close());
+
+  db.open("TEST_FAILED_FLUSH");
+  for (uint64_t key = 1; key <= 65; key++) {
+    assert(db.get(key) == key);
+  }
+  db.close();
+}
+
+void test_compaction() {
+  DB db;
+  db.open("TEST_COMPACTION", 10);
+  for (uint64_t pass = 1; pass <= 3; pass++) {
+    for (uint64_t i = 0; i < 100; i++) {
+      db.put(i, i * pass);
+    }
+  }
+  assert(db.sst_names.size() == 30);
+
+  // Scans keep running on the replaced files until they finish
+  atomic<bool> compacted(false);
+  atomic<bool> bad_scan(false);
+  thread scanner([&]() {
+    do {
+      set<uint64_t> keys;
+      vector<KVPair> kvpairs = db.scan(0, 99);
+      for (auto& kvpair : kvpairs) {
+        keys.insert(kvpair.key);
+        if (kvpair.value != kvpair.key * 3) {
+          bad_scan = true;
+        }
+      }
+      if (keys.size() != 100 || kvpairs.size() != 100) {
+        bad_scan = true;
+      }
+    } while (!compacted);
+  });
+  assert(db.compact());
+  compacted = true;
+  scanner.join();
+  assert(!bad_scan);
+
+  uint64_t value;
+  assert(db.sst_names.size() == 1);
+  assert(db.get_int_property("kvdb.num-files-at-level1", &value) && value == 1);
+  assert(db.get_int_property("kvdb.estimate-num-keys", &value) && value == 100);
+  assert(count_ssts("TEST_COMPACTION") == 1);
+  for (uint64_t i = 0; i < 100; i++) {
+    assert(db.get(i) == i * 3);
+  }
+  assert(db.scan(0, 99).size() == 100);
+
+  // Writes after the compaction land in newer files
+  for (uint64_t i = 0; i < 10; i++) {
+    db.put(i, i * 4);
+  }
+  assert(db.compact());
+  db.close();
+
+  // An SST the manifest doesn't list, such as the output of a compaction cut
+  // short by a crash, is removed on open
+  ofstream("TEST_COMPACTION/999.sst") << "partial";
+  db.open("TEST_COMPACTION");
+  assert(!fs::exists("TEST_COMPACTION/999.sst"));
+  assert(db.sst_names.size() == 1);
+  for (uint64_t i = 0; i < 100; i++) {
+    assert(db.get(i) == i * (i < 10 ? 4 : 3));
+  }
+  db.close();
+}
+
+void test_auto_compaction() {
+  DB db;
+  db.open("TEST_AUTO_COMPACTION", 10);
+  db.compaction_trigger = 4;
+  // Out of order, so the flushed files overlap
+  for (uint64_t i = 0; i < 1000; i++) {
+    db.put(i * 7919 % 1000, i * 7919 % 1000);
+  }
+  db.close();
+  assert(count_ssts("TEST_AUTO_COMPACTION") < 100);
+
+  db.open("TEST_AUTO_COMPACTION");
+  assert(db.sst_names.size() == count_ssts("TEST_AUTO_COMPACTION"));
+  for (uint64_t i = 0; i < 1000; i++) {
+    assert(db.get(i) == i);
+  }
+  db.close();
+}
+
+void test_snapshot() {
+  DB db;
+  db.open("TEST_SNAPSHOT", 10);
+  for (uint64_t i = 0; i < 50; i++) {
+    db.put(i, i);
+  }
+  const Snapshot* snapshot = db.get_snapshot();
+
+  // Overwrites, deletes and new keys, some still in the memtable and some
+  // flushed, are invisible to the snapshot
+  for (uint64_t i = 0; i < 50; i++) {
+    if (i % 5 == 0) {
+      db.del(i);
+    } else {
+      db.put(i, i + 100);
+    }
+  }
+  for (uint64_t i = 50; i < 55; i++) {
+    db.put(i, i);
+  }
+  for (uint64_t i = 0; i < 50; i++) {
+    assert(db.get(i, snapshot) == i);
+  }
+  try {
+    db.get(50, snapshot);
+    assert(false);
+  } catch (const KeyException& e) {
+  }
+  vector<KVPair> scanned = db.scan(0, 99, snapshot);
+  assert(scanned.size() == 50);
+  for (uint64_t i = 0; i < 50; i++) {
+    assert(scanned[i].key == i && scanned[i].value == i);
+  }
+
+  // The latest reads see the new writes
+  scanned = db.scan(0, 99);
+  assert(scanned.size() == 45);
+  for (size_t i = 1; i < scanned.size(); i++) {
+    assert(scanned[i - 1].key < scanned[i].key);
+  }
+  assert(db.get(1) == 101);
+
+  // Compaction keeps the versions the snapshot reads
+  assert(db.compact());
+  for (uint64_t i = 0; i < 50; i++) {
+    assert(db.get(i, snapshot) == i);
+  }
+  assert(db.scan(0, 99, snapshot).size() == 50);
+  assert(db.scan(0, 99).size() == 45);
+
+  // and drops them once it is released
+  uint64_t entries;
+  assert(db.get_int_property("kvdb.estimate-num-keys", &entries));
+  db.release_snapshot(snapshot);
+  for (uint64_t i = 0; i < 10; i++) {
+    db.put(i, i + 100);
+  }
+  assert(db.compact());
+  uint64_t released;
+  assert(db.get_int_property("kvdb.estimate-num-keys", &released));
+  assert(released < entries / 2);
+  db.close();
+
+  db.open("TEST_SNAPSHOT");
+  assert(db.scan(0, 99).size() == 47);
+  assert(db.get(5) == 105);
+  assert(db.get(12) == 112);
+  db.close();
+}
+
+// Snapshots taken while a writer overwrites keys, flushing and compacting as
+// it goes, each read at least the value written before they were taken, and
+// keep reading it
+void test_concurrent_snapshots() {
+  DB db;
+  db.open("TEST_CONCURRENT_SNAPSHOTS", 16);
+  db.compaction_trigger = 4;
+  const uint64_t num_keys = 16;
+  for (uint64_t key = 0; key < num_keys; key++) {
+    db.put(key, 0);
+  }
+  atomic<uint64_t> written(0);
+  atomic<bool> done(false);
+  thread writer([&]() {
+    for (uint64_t i = 1; i <= 5000; i++) {
+      db.put(i % num_keys, i);
+      written = i;
+    }
+    done = true;
+  });
+
+  atomic<bool> bad_read(false);
+  vector<thread> readers;
+  for (int t = 0; t < 4; t++) {
+    readers.push_back(thread([&]() {
+      while (!done) {
+        uint64_t before = written;
+        const Snapshot* snapshot = db.get_snapshot();
+        // The key written longest ago, so the next write replaces it
+        uint64_t key = (before + 1) % num_keys;
+        uint64_t oldest = before + 1 < num_keys ? 0 : before + 1 - num_keys;
+        try {
+          uint64_t value = db.get(key, snapshot);
+          this_thread::yield();
+          if (value < oldest || db.get(key, snapshot) != value) {
+            bad_read = true;
+          }
+        } catch (KeyException& e) {
+          bad_read = true;
+        }
+        db.release_snapshot(snapshot);
+      }
+    }));
+  }
+  for (auto& t : readers) {
+    t.join();
+  }
+  writer.join();
+  assert(!bad_read);
+  db.close();
+}
+
+void test_delete_persists() {
+  DB db;
+  db.open("TEST_DELETE", 10);
+  for (uint64_t i = 0; i < 20; i++) {
+    db.put(i, i);
+  }
+  // The tombstones are flushed to a newer SST than the values they hide
+  for (uint64_t i = 0; i < 20; i += 2) {
+    db.del(i);
+  }
+  for (uint64_t i = 20; i < 30; i++) {
+    db.put(i, i);
+  }
+  db.close();
+
+  db.open("TEST_DELETE");
+  for (uint64_t i = 0; i < 30; i++) {
+    if (i < 20 && i % 2 == 0) {
+      try {
+        db.get(i);
+        assert(false);
+      } catch (const KeyException& e) {
+      }
+    } else {
+      assert(db.get(i) == i);
+    }
+  }
+  assert(db.scan(0, 29).size() == 20);
+  db.close();
+}
+
+void test_merge() {
+  DB db;
+  db.open("TEST_MERGE", 10, CLOCK, DEFAULT_BUFFER_POOL_BYTES, 1 << 16);
+  // Counters whose increments are spread over many SSTs
+  for (int round = 0; round < 20; round++) {
+    for (uint64_t key = 0; key < 10; key++) {
+      db.merge(key, key + 1);
+    }
+  }
+  for (uint64_t key = 0; key < 10; key++) {
+    assert(db.get(key) == 20 * (key + 1));
+  }
+  // The row cache holds key 1 now, and must not hide a newer operand
+  db.merge(1, 1);
+  assert(db.get(1) == 41);
+
+  db.put(3, 100);
+  db.merge(3, 5);
+  assert(db.get(3) == 105);
+  db.del(4);
+  db.merge(4, 7);
+  assert(db.get(4) == 7);
+  try {
+    db.get(10);
+    assert(false);
+  } catch (const KeyException& e) {
+  }
+
+  const Snapshot* snapshot = db.get_snapshot();
+  for (int i = 0; i < 30; i++) {
+    db.merge(0, 100);
+  }
+  assert(db.get(0) == 3020);
+  assert(db.get(0, snapshot) == 20);
+  vector<KVPair> expected = {{0, 3020}, {1, 41},  {2, 60},  {3, 105},
+                             {4, 7},    {5, 120}, {6, 140}, {7, 160},
+                             {8, 180},  {9, 200}};
+  assert(db.scan(0, 100) == expected);
+  assert(db.scan(0, 0, snapshot) == vector<KVPair>({{0, 20}}));
+
+  // Compaction folds the operands, except where the snapshot needs them
+  assert(db.compact());
+  assert(db.scan(0, 100) == expected);
+  assert(db.get(0, snapshot) == 20);
+  db.release_snapshot(snapshot);
+  assert(db.compact());
+  assert(db.scan(0, 100) == expected);
+  db.close();
+
+  assert(db.open("TEST_MERGE"));
+  assert(db.scan(0, 100) == expected);
+  db.merge(5, 1);
+  assert(db.get(5) == 121);
+  assert(sync_wait(db.get_async(5)) == 121);
+
+  db.merge_operator = &MAX_OPERATOR;
+  db.merge(100, 5);
+  db.merge(100, 3);
+  assert(db.get(100) == 5);
+  db.close();
+}
+
+// Keys deleted by a range tombstone and written again, in the memtable, in
+// SSTs and after a compaction
+void test_delete_range() {
+  DB db;
+  db.open("TEST_DELETE_RANGE", 10, CLOCK, DEFAULT_BUFFER_POOL_BYTES, 1 << 16);
+  for (uint64_t i = 0; i < 100; i++) {
+    db.put(i, i);
+  }
+  assert(db.get(50) == 50);  // Now in the row cache
+  const Snapshot* snapshot = db.get_snapshot();
+  db.del_range(20, 59);
+  db.del_range(90, 80);  // Empty
+  db.merge(30, 5);
+  db.put(40, 1);
+
+  auto check = [&]() {
+    for (uint64_t i = 0; i < 100; i++) {
+      bool deleted = i >= 20 && i < 60 && i != 30 && i != 40;
+      try {
+        uint64_t value = db.get(i);
+        assert(!deleted);
+        assert(value == (i == 30 ? 5 : i == 40 ? 1 : i));
+        assert(sync_wait(db.get_async(i)) == value);
+      } catch (const KeyException& e) {
+        assert(deleted);
+      }
+    }
+    vector<KVPair> kvpairs = db.scan(0, 99);
+    assert(kvpairs.size() == 62);
+    assert(kvpairs[19] == KVPair({19, 19}));
+    assert(kvpairs[20] == KVPair({30, 5}));
+    assert(kvpairs[21] == KVPair({40, 1}));
+    assert(kvpairs[22] == KVPair({60, 60}));
+    assert(sync_wait(db.scan_async(0, 99)) == kvpairs);
+    assert(db.scan(20, 29).empty());
+    assert(db.get(50, snapshot) == 50);
+    assert(db.scan(0, 99, snapshot).size() == 100);
+  };
+  check();  // From the memtable
+  for (uint64_t i = 100; i < 120; i++) {
+    db.put(i, i);
+  }
+  check();  // From the SSTs
+
+  // Files wholly deleted by a range tombstone aren't read
+  db.del_range(0, 9);
+  for (uint64_t i = 120; i < 140; i++) {
+    db.put(i, i);
+  }
+  PerfContext* context = get_perf_context();
+  set_perf_level(PERF_COUNT);
+  context->reset();
+  assert(db.scan(0, 9).empty());
+  assert(context->ssts_probed < db.sst_names.size());
+  set_perf_level(PERF_DISABLED);
+  db.put(0, 7);
+  db.release_snapshot(snapshot);
+  db.close();
+
+  assert(db.open("TEST_DELETE_RANGE"));
+  assert(db.manifest.range_tombstones.size() == 2);
+  try {
+    db.get(5);
+    assert(false);
+  } catch (const KeyException& e) {
+  }
+  assert(db.get(0) == 7);
+  assert(db.scan(0, 139).size() == 93);
+
+  // A snapshot keeps what the tombstones deleted until it is released
+  snapshot = db.get_snapshot();
+  db.del_range(100, 109);
+  for (uint64_t i = 140; i < 160; i++) {
+    db.put(i, i);
+  }
+  assert(db.manifest.range_tombstones.size() == 3);
+  assert(db.compact());
+  assert(db.manifest.range_tombstones.empty());
+  assert(db.scan(0, 159).size() == 103);
+  assert(db.scan(0, 159, snapshot).size() == 93);
+  db.release_snapshot(snapshot);
+  assert(db.compact());
+  assert(db.scan(0, 159).size() == 103);
+  assert(db.get(30) == 5 && db.get(40) == 1);
+  db.close();
+
+  assert(db.open("TEST_DELETE_RANGE"));
+  assert(db.scan(0, 159).size() == 103);
+  db.close();
+}
+
+// What aggregate should return, from a scan
+uint64_t scan_aggregate(DB& db, uint64_t key1, uint64_t key2, int op,
+                        const Snapshot* snapshot = NULL) {
+  vector<KVPair> kvpairs = db.scan(key1, key2, snapshot);
+  uint64_t sum = 0, min_value = MAX_KEY, max_value = 0;
+  for (auto& kvpair : kvpairs) {
+    sum += kvpair.value;
+    min_value = min(min_value, kvpair.value);
+    max_value = max(max_value, kvpair.value);
+  }
+  if (op == AGGREGATE_COUNT) {
+    return kvpairs.size();
+  }
+  return op == AGGREGATE_SUM ? sum : op == AGGREGATE_MIN ? min_value : max_value;
+}
+
+void test_aggregate() {
+  DB db;
+  db.open("TEST_AGGREGATE", 100);
+  for (uint64_t i = 0; i < 5000; i++) {
+    db.put(i, i);
+  }
+  assert(db.compact());
+
+  // A range over one compacted SST is aggregated from its page summaries
+  PerfContext* context = get_perf_context();
+  set_perf_level(PERF_COUNT);
+  context->reset();
+  assert(db.aggregate(0, 4999, AGGREGATE_COUNT) == 5000);
+  assert(context->pages_summarized >= 5000 / SST_PAGE_ENTRIES);
+  assert(context->pages_from_disk + context->pages_from_pool <= 1);
+  assert(db.aggregate(0, 10000, AGGREGATE_SUM) == 4999 * 5000 / 2);
+  assert(db.aggregate(0, 10000, AGGREGATE_MIN) == 0);
+  assert(db.aggregate(0, 10000, AGGREGATE_MAX) == 4999);
+  // Only its end pages are read
+  context->reset();
+  uint64_t sum = db.aggregate(100, 3999, AGGREGATE_SUM);
+  assert(context->pages_from_disk + context->pages_from_pool <= 2);
+  assert(sum == scan_aggregate(db, 100, 3999, AGGREGATE_SUM));
+  set_perf_level(PERF_DISABLED);
+
+  // Newer writes in the memtable and in SSTs overlapping the compacted one
+  const Snapshot* snapshot = db.get_snapshot();
+  db.put(200, 0);
+  db.del(300);
+  db.merge(400, 10);
+  db.del_range(1000, 1099);
+  db.put(7000, 1);
+  for (uint64_t round = 0; round < 2; round++) {
+    for (int op = AGGREGATE_COUNT; op <= AGGREGATE_MAX; op++) {
+      for (auto range : vector<pair<uint64_t, uint64_t>>(
+               {{0, 10000}, {150, 450}, {990, 1100}, {990, 4000}})) {
+        assert(db.aggregate(range.first, range.second, op) ==
+               scan_aggregate(db, range.first, range.second, op));
+        assert(db.aggregate(range.first, range.second, op, snapshot) ==
+               scan_aggregate(db, range.first, range.second, op, snapshot));
+      }
+    }
+    for (uint64_t i = 0; i < 200; i++) {
+      db.put(i * 25, i);
+    }
+  }
+
+  try {
+    db.aggregate(1010, 1020, AGGREGATE_MIN);
+    assert(false);
+  } catch (const KeyException& e) {
+  }
+  assert(db.aggregate(1000, 1099, AGGREGATE_COUNT) == 4);
+  assert(db.aggregate(1000, 1099, AGGREGATE_SUM) == 40 + 41 + 42 + 43);
+  assert(db.aggregate(8000, 9000, AGGREGATE_COUNT) == 0);
+  try {
+    db.aggregate(8000, 9000, AGGREGATE_MIN);
+    assert(false);
+  } catch (const KeyException& e) {
+  }
+  db.release_snapshot(snapshot);
+  db.close();
+
+  // SSTs written before page summaries are rewritten with them on open
+  for (auto& entry : fs::directory_iterator("TEST_AGGREGATE")) {
+    string path = entry.path().string();
+    if (entry.path().extension() != SST_EXTENSION) {
+      continue;
+    }
+    vector<PageSummary> summaries;
+    assert(read_page_summaries(path, &summaries));
+    fs::resize_file(path, NODE_SIZE + summaries.size() * _PAGE_SIZE);
+    fstream file(path, ios::binary | ios::in | ios::out);
+    file.seekp((B - 1) * sizeof(uint64_t));
+    file.write((const char*)&SST_MAGIC_V2, sizeof(SST_MAGIC_V2));
+  }
+  assert(db.open("TEST_AGGREGATE"));
+  for (auto& sst : db.sst_names) {
+    assert(sst_has_summaries(sst));
+  }
+  assert(db.aggregate(0, 10000, AGGREGATE_SUM) ==
+         scan_aggregate(db, 0, 10000, AGGREGATE_SUM));
+  db.close();
+}
+
+// Values rising with their keys, like timestamps, filtered to a band
+void test_scan_filtered() {
+  DB db;
+  db.open("TEST_SCAN_FILTERED", 100);
+  for (uint64_t i = 0; i < 5000; i++) {
+    db.put(i, i / 10);
+  }
+  assert(db.compact());
+
+  ValuePredicate band = {100, 119};
+  PerfContext* context = get_perf_context();
+  set_perf_level(PERF_COUNT);
+  context->reset();
+  vector<KVPair> kvpairs = db.scan_filtered(0, 4999, band);
+  assert(context->pages_filtered >= 5000 / SST_PAGE_ENTRIES - 2);
+  set_perf_level(PERF_DISABLED);
+  assert(kvpairs.size() == 200);
+  assert(kvpairs.front() == KVPair({1000, 100}));
+  assert(kvpairs.back() == KVPair({1199, 119}));
+
+  // Writes that move keys into or out of the band, in the memtable and in
+  // SSTs newer than the compacted one
+  const Snapshot* snapshot = db.get_snapshot();
+  db.put(50, 105);
+  db.merge(60, 100);  // 6 + 100
+  db.merge(1010, 1000);
+  db.del(1100);
+  db.del_range(1150, 1160);
+  for (uint64_t round = 0; round < 2; round++) {
+    assert(db.scan_filtered(0, 4999, band) ==
+           filter_values(db.scan(0, 4999), band));
+    assert(db.scan_filtered(0, 4999, band, snapshot) ==
+           filter_values(db.scan(0, 4999, snapshot), band));
+    assert(db.scan_filtered(1105, 3000, {0, 110}) ==
+           filter_values(db.scan(1105, 3000), {0, 110}));
+    for (uint64_t i = 1000; i < 1400; i += 2) {
+      db.put(i, 500);
+    }
+  }
+  kvpairs = db.scan_filtered(0, 100, band);
+  assert(kvpairs == vector<KVPair>({{50, 105}, {60, 106}}));
+  assert(db.scan_filtered(0, 4999, {5000, 6000}).empty());
+  db.release_snapshot(snapshot);
+  db.close();
+}
+
+// Limited scans against the first or last keys of a full scan, forward and in
+// reverse
+void check_limited_scans(DB& db, uint64_t key1, uint64_t key2,
+                         const Snapshot* snapshot = NULL) {
+  vector<KVPair> all = db.scan(key1, key2, snapshot);
+  vector<KVPair> reversed(all.rbegin(), all.rend());
+  assert(db.scan(key1, key2, snapshot, SIZE_MAX, true) == reversed);
+  for (size_t limit : {0, 1, 10, 100, 1000}) {
+    size_t n = min(limit, all.size());
+    assert(db.scan(key1, key2, snapshot, limit) ==
+           vector<KVPair>(all.begin(), all.begin() + n));
+    assert(db.scan(key1, key2, snapshot, limit, true) ==
+           vector<KVPair>(reversed.begin(), reversed.begin() + n));
+  }
+}
+
+void test_reverse_scan() {
+  DB db;
+  db.open("TEST_REVERSE_SCAN", 100);
+  for (uint64_t i = 0; i < 3000; i++) {
+    db.put((i * 7919) % 3000, i);
+  }
+  assert(db.compact());
+  // A run of deleted keys, longer than the first rounds of a limited scan
+  // read, and newer writes in SSTs and the memtable
+  for (uint64_t i = 1000; i < 1500; i++) {
+    db.del(i);
+  }
+  const Snapshot* snapshot = db.get_snapshot();
+  db.del_range(2500, 2600);
+  for (uint64_t i = 0; i < 3000; i += 7) {
+    db.put(i, i);
+  }
+  db.merge(2990, 5);
+  db.del(2999);
+
+  check_limited_scans(db, MIN_KEY, MAX_KEY);
+  check_limited_scans(db, MIN_KEY, MAX_KEY, snapshot);
+  check_limited_scans(db, 900, 1600);
+  check_limited_scans(db, 2400, 2700, snapshot);
+  check_limited_scans(db, 2400, 2700);
+  check_limited_scans(db, 4000, 5000);
+
+  vector<KVPair> kvpairs = db.scan(1200, 2000, NULL, 3, true);
+  assert(kvpairs.size() == 3 && kvpairs[0].key == 2000 &&
+         kvpairs[2].key == 1998);
+  kvpairs = db.scan(900, 2000, NULL, 3);
+  assert(kvpairs.size() == 3 && kvpairs.back().key == 902);
+  // Only the keys put again since are left of the deleted run
+  kvpairs = db.scan(1000, 1499, NULL, 3, true);
+  assert(kvpairs == vector<KVPair>({{1498, 1498}, {1491, 1491}, {1484, 1484}}));
+  kvpairs = db.scan(1000, 1499, snapshot, 3, true);
+  assert(kvpairs.empty());
+
+  // The last keys of a compacted database are on its last few pages, of about 18
+  db.release_snapshot(snapshot);
+  assert(db.compact());
+  PerfContext* context = get_perf_context();
+  set_perf_level(PERF_COUNT);
+  context->reset();
+  kvpairs = db.scan(MIN_KEY, MAX_KEY, NULL, 100, true);
+  assert(kvpairs.size() == 100 && kvpairs[0].key == 2998);
+  assert(context->pages_from_disk + context->pages_from_pool <= 5);
+  set_perf_level(PERF_DISABLED);
+  db.close();
+}
+
+// Build an SST of the keys from first to last, stepping by step
+void build_sst(string filename, uint64_t first, uint64_t last, uint64_t step,
+               uint64_t value) {
+  SSTWriter writer(filename);
+  for (uint64_t key = first; key <= last; key += step) {
+    assert(writer.add(key, value));
+  }
+  assert(writer.finish());
+}
+
+int level_of(DB& db, string path) {
+  for (auto& entry : db.manifest.files) {
+    if (db.name + "/" + to_string(entry.first) + SST_EXTENSION == path) {
+      return entry.second.level;
+    }
+  }
+  return -1;
+}
+
+void test_ingest() {
+  DB db;
+  db.open("TEST_INGEST", 100);
+  for (uint64_t i = 0; i < 1000; i++) {
+    db.put(i, i);
+  }
+  fs::create_directory("TEST_INGEST_FILES");
+  vector<string> paths;
+  vector<thread> builders;
+  for (uint64_t i = 0; i < 4; i++) {
+    paths.push_back("TEST_INGEST_FILES/" + to_string(i) + SST_EXTENSION);
+    builders.push_back(thread(build_sst, paths.back(), 10000 + i * 2500,
+                              12499 + i * 2500, 1, i));
+  }
+  for (auto& builder : builders) {
+    builder.join();
+  }
+
+  // Keys nothing has written yet are linked in below the other files
+  size_t files = db.sst_names.size();
+  assert(db.ingest_files(paths));
+  assert(db.sst_names.size() == files + 4);
+  for (size_t i = 0; i < 4; i++) {
+    assert(fs::hard_link_count(paths[i]) == 2);
+    assert(level_of(db, db.sst_names[i]) == 1);
+  }
+  assert(db.get(10000) == 0 && db.get(19999) == 3 && db.get(500) == 500);
+  assert(db.scan(9000, 20000).size() == 10000);
+  assert(db.aggregate(0, MAX_KEY, AGGREGATE_COUNT) == 11000);
+
+  // Keys the database holds, in the memtable and in SSTs, read the ingested
+  // values but snapshots don't
+  const Snapshot* snapshot = db.get_snapshot();
+  db.put(550, 1);
+  build_sst("TEST_INGEST_FILES/4.sst", 500, 599, 1, 7);
+  build_sst("TEST_INGEST_FILES/5.sst", 30000, 30099, 1, 8);
+  assert(db.ingest_files({"TEST_INGEST_FILES/4.sst",
+                          "TEST_INGEST_FILES/5.sst"}));
+  assert(level_of(db, db.sst_names.back()) == 0);
+  assert(db.get(550) == 7 && db.get(500) == 7 && db.get(30000) == 8);
+  assert(db.get(550, snapshot) == 550);
+  try {
+    db.get(30000, snapshot);
+    assert(false);
+  } catch (const KeyException& e) {
+  }
+  db.release_snapshot(snapshot);
+  db.put(560, 9);
+  assert(db.get(560) == 9);
+
+  // A range deleted before is written again
+  db.del_range(40000, 50000);
+  build_sst("TEST_INGEST_FILES/6.sst", 40000, 40999, 1, 6);
+  assert(db.ingest_files({"TEST_INGEST_FILES/6.sst"}));
+  assert(db.get(40500) == 6);
+
+  assert(!db.ingest_files({"TEST_INGEST_FILES/missing.sst"}));
+  // Files with tombstones or sequence numbers come from a database
+  write_sst({{70000, TOMBSTONE, 0}}, "TEST_INGEST_FILES/9.sst");
+  write_sst({{70000, 1, 5}}, "TEST_INGEST_FILES/10.sst");
+  assert(!db.ingest_files({"TEST_INGEST_FILES/9.sst"}));
+  assert(!db.ingest_files({"TEST_INGEST_FILES/10.sst"}));
+  build_sst("TEST_INGEST_FILES/7.sst", 60000, 60100, 1, 1);
+  build_sst("TEST_INGEST_FILES/8.sst", 60100, 60200, 1, 1);
+  files = db.sst_names.size();
+  assert(!db.ingest_files({"TEST_INGEST_FILES/7.sst",
+                           "TEST_INGEST_FILES/8.sst"}));
+  assert(db.sst_names.size() == files);
+
+  vector<KVPair> expected = db.scan(MIN_KEY, MAX_KEY);
+  assert(expected.size() == 11000 + 100 + 1000);
+  db.close();
+  assert(db.open("TEST_INGEST"));
+  assert(db.scan(MIN_KEY, MAX_KEY) == expected);
+  assert(db.get(550) == 7 && db.get(560) == 9);
+  assert(db.compact());
+  assert(db.scan(MIN_KEY, MAX_KEY) == expected);
+  db.close();
+}
+
+// Keys that only grow are flushed to files that nothing merges or reads
+void test_append_only() {
+  DB db;
+  db.open("TEST_APPEND_ONLY", 10);
+  db.compaction_trigger = 4;
+  for (uint64_t i = 0; i < 1000; i++) {
+    db.put(i, i);
+  }
+  db.close();
+  assert(count_ssts("TEST_APPEND_ONLY") == 100);
+
+  db.open("TEST_APPEND_ONLY", 10);
+  db.compaction_trigger = 4;
+  for (uint64_t i = 1000; i < 2000; i++) {
+    db.put(i, i);
+  }
+  uint64_t value;
+  assert(db.get_int_property("kvdb.num-files-at-level0", &value) && value == 0);
+  assert(db.get_int_property("kvdb.num-files-at-level1", &value) && value == 200);
+  StatisticsReport report = db.get_statistics();
+  assert(report.histograms[COMPACTION].count == 0);
+  assert(report.tickers[SST_BYTES_READ] == 0);
+  for (uint64_t i = 0; i < 2000; i += 7) {
+    assert(db.get(i) == i);
+  }
+
+  // An older key makes the next flush overlap
+  db.put(5, 6);
+  for (uint64_t i = 2000; i < 2009; i++) {
+    db.put(i, i);
+  }
+  assert(db.get_int_property("kvdb.num-files-at-level0", &value) && value == 1);
+  assert(db.get(5) == 6);
+  db.close();
+}
+
 int main() {
   cleanup();
 
@@ -261,6 +1449,28 @@ int main() {
   test_sorted_ssts();
   test_big_data_one_sst();
   test_big_data_many_ssts();
+  test_row_cache();
+  test_warm_restart();
+  test_legacy_upgrade();
+  test_statistics();
+  test_perf_context();
+  test_properties();
+  test_trace();
+  test_concurrent();
+  test_write_batch();
+  test_failed_flush();
+  test_compaction();
+  test_auto_compaction();
+  test_append_only();
+  test_snapshot();
+  test_concurrent_snapshots();
+  test_delete_persists();
+  test_merge();
+  test_delete_range();
+  test_aggregate();
+  test_scan_filtered();
+  test_reverse_scan();
+  test_ingest();
 
   cleanup();
   cout << "DB tests passed!\n";
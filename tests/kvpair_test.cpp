@@ -4,6 +4,8 @@
 #include <iostream>
 #include <vector>
 
+#include "../src/merge_operator.h"
+
 using namespace std;
 
 void test_empty_both() {
@@ -61,6 +63,177 @@ void test_duplicate_and_longer2() {
   assert(actual == expected);
 }
 
+void test_tombstones() {
+  vector<KVPair> kvps1 = {{1, TOMBSTONE}, {3, TOMBSTONE}, {4, 40}};
+  vector<KVPair> kvps2 = {{2, TOMBSTONE}, {3, 30}, {4, TOMBSTONE}, {5, 50}};
+  vector<KVPair> expected = {{4, 40}, {5, 50}};
+  auto actual = merge(kvps1, kvps2);
+  assert(actual == expected);
+}
+
+// Several versions of keys 1 and 2 in storage order
+const vector<KVPair> VERSIONS = {{1, 13, 9}, {1, TOMBSTONE, 7}, {1, 11, 4},
+                                 {1, 10, 2}, {2, 21, 6},        {2, 20, 3}};
+
+void test_drop_hidden() {
+  assert(drop_hidden(VERSIONS, {}, false) ==
+         vector<KVPair>({{1, 13}, {2, 21}}));
+
+  // Snapshot 5 reads the value written at 4 and the one written at 3
+  vector<KVPair> expected = {{1, 13}, {1, 11}, {2, 21}, {2, 20}};
+  assert(drop_hidden(VERSIONS, {5}, false) == expected);
+
+  // Snapshots 7 and 8 both read the tombstone
+  expected = {{1, 13}, {1, TOMBSTONE}, {2, 21}};
+  assert(drop_hidden(VERSIONS, {7, 8}, false) == expected);
+
+  // Nothing is left for a trailing tombstone to hide
+  vector<KVPair> deleted = {{1, TOMBSTONE, 7}, {1, 11, 4}, {2, 21, 6}};
+  assert(drop_hidden(deleted, {}, false) ==
+         vector<KVPair>({{1, TOMBSTONE}, {2, 21}}));
+  assert(drop_hidden(deleted, {}, true) == vector<KVPair>({{2, 21}}));
+  assert(drop_hidden(deleted, {5}, true) ==
+         vector<KVPair>({{1, TOMBSTONE}, {1, 11}, {2, 21}}));
+}
+
+void test_visible_at() {
+  assert(visible_at(VERSIONS, MAX_SEQUENCE) ==
+         vector<KVPair>({{1, 13}, {2, 21}}));
+  assert(visible_at(VERSIONS, 8) == vector<KVPair>({{2, 21}}));
+  assert(visible_at(VERSIONS, 5) == vector<KVPair>({{1, 11}, {2, 20}}));
+  assert(visible_at(VERSIONS, 2) == vector<KVPair>({{1, 10}}));
+  assert(visible_at(VERSIONS, 1).empty());
+}
+
+void test_merge_operators() {
+  assert(ADD_OPERATOR.merge(2, 3) == 5);
+  assert(ADD_OPERATOR.merge(MAX_MERGE_VALUE - 1, 3) == MAX_MERGE_VALUE);
+  assert(MAX_OPERATOR.merge(2, 3) == 3);
+  assert(MIN_OPERATOR.merge(2, 3) == 2);
+  assert(OR_OPERATOR.merge(4, 3) == 7);
+  assert(OR_OPERATOR.merge(MAX_MERGE_VALUE, 2) == MAX_MERGE_VALUE);
+
+  MergeChain chain(&ADD_OPERATOR);
+  assert(!chain.add(1, true));
+  assert(!chain.add(2, true));
+  assert(chain.add(10, false));
+  assert(chain.result() == 13);
+
+  // Operands above a delete are merged onto nothing
+  MergeChain deleted(&ADD_OPERATOR);
+  assert(!deleted.add(1, true));
+  assert(deleted.add(TOMBSTONE, false));
+  assert(deleted.result() == 1);
+
+  MergeChain empty(&ADD_OPERATOR);
+  assert(empty.add(TOMBSTONE, false));
+  assert(empty.result() == TOMBSTONE);
+}
+
+const uint64_t M = MERGE_OPERAND;
+
+// Merge operands of keys 1 and 2 above values and a tombstone, in storage
+// order
+const vector<KVPair> OPERANDS = {
+    {1, 5, 9 | M},     {1, 3, 8 | M}, {1, 10, 6}, {1, 2, 4 | M},
+    {1, TOMBSTONE, 3}, {1, 7, 1},     {2, 4, 5 | M}, {2, 6, 2 | M}};
+
+void test_drop_hidden_operands() {
+  // The operands of key 1 are merged into the value below them. Key 2 has
+  // no value here, so its operands can only be merged with each other.
+  vector<KVPair> kept = drop_hidden(OPERANDS, {}, false, &ADD_OPERATOR);
+  assert(kept == vector<KVPair>({{1, 18}, {2, 10}}));
+  assert(kept[0].seq == 9 && kept[1].seq == (5 | M));
+
+  // With no older files left, operands without a value become one
+  kept = drop_hidden(OPERANDS, {}, true, &ADD_OPERATOR);
+  assert(kept == vector<KVPair>({{1, 18}, {2, 10}}));
+  assert(kept[1].seq == 5);
+
+  // Snapshot 4 reads 2 merged onto the delete, and key 2's operand at 2,
+  // which the newer operand is then read above
+  kept = drop_hidden(OPERANDS, {4}, false, &ADD_OPERATOR);
+  assert(kept == vector<KVPair>({{1, 18}, {1, 2}, {2, 4}, {2, 6}}));
+  assert(!kept[1].is_operand() && kept[2].is_operand() &&
+         kept[3].is_operand());
+
+  // Without an operator, the writes operands need are kept instead
+  kept = drop_hidden(OPERANDS, {}, false);
+  assert(kept == vector<KVPair>({{1, 5}, {1, 3}, {1, 10}, {2, 4}, {2, 6}}));
+}
+
+void test_visible_at_operands() {
+  assert(visible_at(OPERANDS, MAX_SEQUENCE, &ADD_OPERATOR) ==
+         vector<KVPair>({{1, 18}, {2, 10}}));
+  assert(visible_at(OPERANDS, 5, &ADD_OPERATOR) ==
+         vector<KVPair>({{1, 2}, {2, 10}}));
+  assert(visible_at(OPERANDS, 3, &ADD_OPERATOR) ==
+         vector<KVPair>({{2, 6}}));
+  assert(visible_at(OPERANDS, 1, &ADD_OPERATOR) ==
+         vector<KVPair>({{1, 7}}));
+  assert(visible_at(OPERANDS, MAX_SEQUENCE, &MAX_OPERATOR) ==
+         vector<KVPair>({{1, 10}, {2, 6}}));
+}
+
+// Keys 1 to 5 deleted at 5, and key 2 again at 8
+const vector<RangeTombstone> RANGES = {{1, 5, 5}, {2, 2, 8}};
+
+void test_range_tombstones() {
+  assert(deleted_at(RANGES, 2, MAX_SEQUENCE) == 8);
+  assert(deleted_at(RANGES, 2, 7) == 5);
+  assert(deleted_at(RANGES, 1, 4) == 0);
+  assert(deleted_at(RANGES, 6, MAX_SEQUENCE) == 0);
+
+  assert(range_deleted(RANGES, 1, 5, 4, MAX_SEQUENCE));
+  assert(!range_deleted(RANGES, 1, 5, 4, 4));  // Too old to see it
+  assert(!range_deleted(RANGES, 1, 5, 5, MAX_SEQUENCE));
+  assert(!range_deleted(RANGES, 0, 5, 4, MAX_SEQUENCE));
+  assert(range_deleted(RANGES, 2, 2, 7, MAX_SEQUENCE));
+
+  // Key 1's operand at 9 is merged onto nothing, key 2's value at 6 was
+  // deleted again at 8
+  vector<KVPair> kvpairs = {{1, 2, 9 | M}, {1, 13, 3}, {2, 21, 6},
+                            {2, 20, 3},    {6, 60, 1}};
+  vector<KVPair> deleted = kvpairs;
+  apply_range_tombstones(deleted, RANGES, MAX_SEQUENCE);
+  assert(visible_at(deleted, MAX_SEQUENCE, &ADD_OPERATOR) ==
+         vector<KVPair>({{1, 2}, {6, 60}}));
+  deleted = kvpairs;
+  apply_range_tombstones(deleted, RANGES, 7);
+  assert(visible_at(deleted, 7, &ADD_OPERATOR) ==
+         vector<KVPair>({{2, 21}, {6, 60}}));
+  deleted = kvpairs;
+  apply_range_tombstones(deleted, RANGES, 4);
+  assert(visible_at(deleted, 4, &ADD_OPERATOR) ==
+         vector<KVPair>({{1, 13}, {2, 20}, {6, 60}}));
+
+  // A point tombstone for each range tombstone newer than some of a key's
+  // writes, in storage order
+  vector<KVPair> expected = {{1, 2, 9 | M},      {1, TOMBSTONE, 5},
+                             {1, 13, 3},         {2, TOMBSTONE, 8},
+                             {2, 21, 6},         {2, TOMBSTONE, 5},
+                             {2, 20, 3},         {6, 60, 1}};
+  vector<KVPair> points = with_point_tombstones(kvpairs, RANGES);
+  assert(points == expected);
+  for (size_t i = 0; i < points.size(); i++) {
+    assert(points[i].seq == expected[i].seq);
+  }
+  assert(drop_hidden(points, {}, true, &ADD_OPERATOR) ==
+         vector<KVPair>({{1, 2}, {6, 60}}));
+  assert(drop_hidden(points, {4}, true, &ADD_OPERATOR) ==
+         vector<KVPair>({{1, 2}, {1, 13}, {2, TOMBSTONE}, {2, 20}, {6, 60}}));
+}
+
+void test_filter_values() {
+  vector<KVPair> kvpairs = {{1, 0}, {2, 5}, {3, 10}, {4, 11}, {5, MAX_KEY - 1}};
+  assert(filter_values(kvpairs, {5, 10}) ==
+         vector<KVPair>({{2, 5}, {3, 10}}));
+  assert(filter_values(kvpairs, {0, 0}) == vector<KVPair>({{1, 0}}));
+  assert(filter_values(kvpairs, {0, MAX_KEY}) == kvpairs);
+  assert(filter_values(kvpairs, {11, 5}).empty());
+  assert(filter_values({}, {0, 10}).empty());
+}
+
 int main() {
   test_empty_both();
   test_empty_1();
@@ -69,6 +242,14 @@ int main() {
   test_duplicate();
   test_duplicate_and_longer1();
   test_duplicate_and_longer2();
+  test_tombstones();
+  test_drop_hidden();
+  test_visible_at();
+  test_merge_operators();
+  test_drop_hidden_operands();
+  test_visible_at_operands();
+  test_range_tombstones();
+  test_filter_values();
   cout << "KVPair tests passed!\n";
   return 0;
 }
@@ -0,0 +1,239 @@
+#include "../src/manifest.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const string DIR_NAME = "TEST_MANIFEST";
+
+Metadata make_metadata(int next_sst_id, uint64_t last_sequence) {
+  Metadata metadata;
+  metadata.memtable_size = 10;
+  metadata.next_sst_id = next_sst_id;
+  metadata.num_elems = last_sequence;
+  metadata.last_sequence = last_sequence;
+  return metadata;
+}
+
+FileMeta make_file(int number, uint64_t min_key, uint64_t max_key) {
+  FileMeta file;
+  file.number = number;
+  file.level = 0;
+  file.min_key = min_key;
+  file.max_key = max_key;
+  file.max_sequence = number * 10;
+  file.num_entries = max_key - min_key + 1;
+  file.num_deletions = 1;
+  file.file_size = 4096 * (number + 1);
+  return file;
+}
+
+int count_lines(string filename) {
+  ifstream in(filename);
+  string line;
+  int lines = 0;
+  while (getline(in, line)) {
+    lines++;
+  }
+  return lines;
+}
+
+void test_log_and_recover() {
+  fs::remove_all(DIR_NAME);
+  fs::create_directory(DIR_NAME);
+
+  Manifest manifest;
+  assert(manifest.create(DIR_NAME, make_metadata(0, 0)));
+  assert(manifest.log_edit({make_file(0, 1, 50)}, {}, make_metadata(1, 10)));
+  assert(manifest.log_edit({make_file(1, 20, 90)}, {}, make_metadata(2, 20)));
+  assert(manifest.log_edit({make_file(2, 1, 90)}, {0, 1}, make_metadata(3, 20)));
+  manifest.close();
+
+  Manifest recovered;
+  assert(recovered.recover(DIR_NAME));
+  assert(recovered.metadata.next_sst_id == 3);
+  assert(recovered.metadata.last_sequence == 20);
+  assert(recovered.files.size() == 1);
+  FileMeta file = recovered.files.begin()->second;
+  assert(file.number == 2 && file.min_key == 1 && file.max_key == 90);
+  assert(file.max_sequence == 20);
+  assert(file.num_entries == 90 && file.num_deletions == 1);
+  assert(file.file_size == 3 * 4096);
+  recovered.close();
+
+  fs::remove_all(DIR_NAME);
+}
+
+void test_torn_edit_ignored() {
+  fs::remove_all(DIR_NAME);
+  fs::create_directory(DIR_NAME);
+
+  Manifest manifest;
+  assert(manifest.create(DIR_NAME, make_metadata(0, 0)));
+  assert(manifest.log_edit({make_file(0, 1, 50)}, {}, make_metadata(1, 10)));
+  manifest.close();
+
+  // Simulate a crash in the middle of writing an edit
+  ofstream log(DIR_NAME + "/" + MANIFEST_FILE, ios::app);
+  log << "meta 10 2 20 20\nadd 1 0 5 6 20\nremove 0\nadd 2 0";
+  log.close();
+
+  Manifest recovered;
+  assert(recovered.recover(DIR_NAME));
+  assert(recovered.metadata.next_sst_id == 1);
+  assert(recovered.files.size() == 1 && recovered.files.count(0) == 1);
+  recovered.close();
+
+  fs::remove_all(DIR_NAME);
+}
+
+void test_failed_append() {
+  fs::remove_all(DIR_NAME);
+  fs::create_directory(DIR_NAME);
+  string log_name = DIR_NAME + "/" + MANIFEST_FILE;
+
+  Manifest manifest;
+  assert(manifest.create(DIR_NAME, make_metadata(0, 0)));
+  assert(manifest.log_edit({make_file(0, 1, 50)}, {}, make_metadata(1, 10)));
+
+  // A short write is cut off the log before the next edit
+  signal(SIGXFSZ, SIG_IGN);
+  rlimit limit;
+  assert(getrlimit(RLIMIT_FSIZE, &limit) == 0);
+  rlimit lowered = limit;
+  lowered.rlim_cur = fs::file_size(log_name) + 10;
+  assert(setrlimit(RLIMIT_FSIZE, &lowered) == 0);
+  assert(!manifest.log_edit({make_file(1, 20, 90)}, {}, make_metadata(2, 20)));
+  assert(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+  assert(manifest.log_edit({make_file(2, 1, 90)}, {0}, make_metadata(3, 30)));
+  manifest.close();
+
+  Manifest recovered;
+  assert(recovered.recover(DIR_NAME));
+  assert(recovered.metadata.next_sst_id == 3);
+  assert(recovered.files.size() == 1 && recovered.files.count(2) == 1);
+  assert(recovered.files[2].max_sequence == 20);
+
+  // When it can't be cut, edits wait for a checkpoint
+  int log_fd = recovered.fd;
+  recovered.fd = open(log_name.c_str(), O_RDONLY);
+  assert(!recovered.log_edit({make_file(3, 1, 2)}, {}, make_metadata(4, 40)));
+  close(recovered.fd);
+  recovered.fd = log_fd;
+  assert(!recovered.log_edit({make_file(3, 1, 2)}, {}, make_metadata(4, 40)));
+  assert(recovered.checkpoint());
+  assert(recovered.log_edit({make_file(3, 1, 2)}, {}, make_metadata(4, 40)));
+  recovered.close();
+  assert(recovered.recover(DIR_NAME));
+  assert(recovered.files.size() == 2 && recovered.metadata.next_sst_id == 4);
+  recovered.close();
+
+  fs::remove_all(DIR_NAME);
+}
+
+void test_short_add_records() {
+  fs::remove_all(DIR_NAME);
+  fs::create_directory(DIR_NAME);
+
+  // Add records written before entry counts and file sizes were recorded
+  ofstream log(DIR_NAME + "/" + MANIFEST_FILE);
+  log << "meta 10 2 4 4\nadd 0 0 1 2 2\nadd 1 0 3 4 4\ncommit\n";
+  log.close();
+
+  Manifest recovered;
+  assert(recovered.recover(DIR_NAME));
+  assert(recovered.files.size() == 2);
+  assert(recovered.files[1].min_key == 3 && recovered.files[1].max_key == 4);
+  assert(recovered.files[1].num_entries == 0);
+  assert(recovered.files[1].file_size == 0);
+  recovered.close();
+
+  fs::remove_all(DIR_NAME);
+}
+
+void test_checkpoint() {
+  fs::remove_all(DIR_NAME);
+  fs::create_directory(DIR_NAME);
+  string log_name = DIR_NAME + "/" + MANIFEST_FILE;
+
+  Manifest manifest;
+  assert(manifest.create(DIR_NAME, make_metadata(0, 0)));
+  for (int i = 0; i < MANIFEST_CHECKPOINT_EDITS - 1; i++) {
+    assert(manifest.log_edit({make_file(i, i, i)}, {}, make_metadata(i + 1, i)));
+  }
+  int lines_before = count_lines(log_name);
+
+  // The next edit rewrites the log as one edit holding every live file
+  int last = MANIFEST_CHECKPOINT_EDITS - 1;
+  assert(manifest.log_edit({make_file(last, last, last)}, {},
+                           make_metadata(last + 1, last)));
+  int lines_after = count_lines(log_name);
+  assert(lines_after == MANIFEST_CHECKPOINT_EDITS + 2);
+  assert(lines_after < lines_before);
+  assert(!fs::exists(log_name + ".tmp"));
+  manifest.close();
+
+  Manifest recovered;
+  assert(recovered.recover(DIR_NAME));
+  assert((int)recovered.files.size() == MANIFEST_CHECKPOINT_EDITS);
+  assert(recovered.metadata.next_sst_id == MANIFEST_CHECKPOINT_EDITS);
+  recovered.close();
+
+  fs::remove_all(DIR_NAME);
+}
+
+void test_range_tombstones() {
+  fs::remove_all(DIR_NAME);
+  fs::create_directory(DIR_NAME);
+
+  Manifest manifest;
+  assert(manifest.create(DIR_NAME, make_metadata(0, 0)));
+  assert(manifest.log_edit({make_file(0, 1, 50)}, {}, make_metadata(1, 10),
+                           {{5, 9, 8}}));
+  assert(manifest.log_edit({}, {}, make_metadata(1, 20), {{1, 3, 15}}));
+  // A compaction drops the first one along with the file it deleted from
+  assert(manifest.log_edit({make_file(1, 1, 50)}, {0}, make_metadata(2, 20),
+                           {}, {8}));
+  assert(manifest.log_edit({}, {}, make_metadata(2, 30), {{40, 60, 25}}));
+  manifest.close();
+
+  Manifest recovered;
+  assert(recovered.recover(DIR_NAME));
+  assert(recovered.range_tombstones.size() == 2);
+  RangeTombstone first = recovered.range_tombstones[0];
+  assert(first.start == 1 && first.end == 3 && first.seq == 15);
+  assert(recovered.range_tombstones[1].seq == 25);
+  // And survive a checkpoint
+  assert(recovered.checkpoint());
+  recovered.close();
+
+  Manifest checkpointed;
+  assert(checkpointed.recover(DIR_NAME));
+  assert(checkpointed.range_tombstones.size() == 2);
+  assert(checkpointed.range_tombstones[1].start == 40);
+  assert(checkpointed.files.size() == 1);
+  checkpointed.close();
+
+  fs::remove_all(DIR_NAME);
+}
+
+int main() {
+  test_log_and_recover();
+  test_torn_edit_ignored();
+  test_failed_append();
+  test_short_add_records();
+  test_checkpoint();
+  test_range_tombstones();
+  cout << "Manifest tests passed!\n";
+  return 0;
+}
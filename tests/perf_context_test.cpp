@@ -0,0 +1,62 @@
+#include "../src/perf_context.h"
+
+#include <cassert>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+void test_levels() {
+  PerfContext* context = get_perf_context();
+  context->reset();
+
+  // Nothing is collected by default
+  assert(get_perf_level() == PERF_DISABLED);
+  PERF_ADD(ssts_probed, 1);
+  assert(context->ssts_probed == 0);
+
+  set_perf_level(PERF_COUNT);
+  PERF_ADD(ssts_probed, 2);
+  PERF_ADD(bytes_read, 4096);
+  { PerfTimer timer(&context->sst_nanos); }
+  assert(context->ssts_probed == 2 && context->bytes_read == 4096);
+  assert(context->sst_nanos == 0);
+
+  set_perf_level(PERF_TIME);
+  {
+    PerfTimer timer(&context->sst_nanos);
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+  assert(context->sst_nanos >= 1000000);
+
+  context->reset();
+  assert(context->ssts_probed == 0 && context->sst_nanos == 0);
+  assert(context->to_string().find("ssts_probed = 0,") != string::npos);
+  set_perf_level(PERF_DISABLED);
+}
+
+void test_thread_local() {
+  set_perf_level(PERF_COUNT);
+  get_perf_context()->reset();
+  PERF_ADD(pages_from_disk, 1);
+
+  // Another thread has its own level and counters
+  thread other([]() {
+    assert(get_perf_level() == PERF_DISABLED);
+    set_perf_level(PERF_COUNT);
+    assert(get_perf_context()->pages_from_disk == 0);
+    PERF_ADD(pages_from_disk, 5);
+    assert(get_perf_context()->pages_from_disk == 5);
+  });
+  other.join();
+
+  assert(get_perf_context()->pages_from_disk == 1);
+  set_perf_level(PERF_DISABLED);
+}
+
+int main() {
+  test_levels();
+  test_thread_local();
+  cout << "Perf context tests passed!\n";
+  return 0;
+}
@@ -0,0 +1,111 @@
+#include "../src/protocol.h"
+
+#include <string.h>
+
+#include <cassert>
+#include <iostream>
+
+#include "../src/kvpair.h"
+
+using namespace std;
+
+void test_request_round_trip() {
+  string frames;
+  encode_request({PROTO_GET, {1, 2, 3}, {}}, &frames);
+  encode_request({PROTO_PUT, {4, 5}, {40, 50}}, &frames);
+  encode_request({PROTO_SCAN, {6}, {9}}, &frames);
+
+  // Pipelined frames decode one after another
+  Request request;
+  size_t offset = 0;
+  long size = decode_request(frames.data(), frames.size(), &request);
+  assert(size == 4 + 1 + 4 + 3 * 8);
+  assert(request.op == PROTO_GET && request.keys == vector<uint64_t>({1, 2, 3}));
+  offset += size;
+  size = decode_request(frames.data() + offset, frames.size() - offset,
+                        &request);
+  assert(request.op == PROTO_PUT && request.keys == vector<uint64_t>({4, 5}) &&
+         request.values == vector<uint64_t>({40, 50}));
+  offset += size;
+  size = decode_request(frames.data() + offset, frames.size() - offset,
+                        &request);
+  assert(request.op == PROTO_SCAN && request.keys[0] == 6 &&
+         request.values[0] == 9);
+  assert(offset + size == frames.size());
+}
+
+void test_partial_frames() {
+  string frame;
+  encode_request({PROTO_DEL, {7, 8}, {}}, &frame);
+  Request request;
+  for (size_t size = 0; size < frame.size(); size++) {
+    assert(decode_request(frame.data(), size, &request) == 0);
+  }
+  assert(decode_request(frame.data(), frame.size(), &request) ==
+         (long)frame.size());
+}
+
+void test_malformed_requests() {
+  Request request;
+  // Unknown op
+  string frame;
+  encode_request({9, {1}, {}}, &frame);
+  assert(decode_request(frame.data(), frame.size(), &request) == -1);
+
+  // A count that disagrees with the body
+  frame.clear();
+  encode_request({PROTO_GET, {1, 2}, {}}, &frame);
+  uint32_t count = 3;
+  memcpy(&frame[5], &count, sizeof(count));
+  assert(decode_request(frame.data(), frame.size(), &request) == -1);
+
+  // PUT values TOMBSTONE and MAX_KEY are reserved
+  for (uint64_t value : {TOMBSTONE, MAX_KEY}) {
+    frame.clear();
+    encode_request({PROTO_PUT, {1, 2}, {10, value}}, &frame);
+    assert(decode_request(frame.data(), frame.size(), &request) == -1);
+  }
+
+  // Too large to buffer
+  uint32_t length = MAX_FRAME_BYTES + 1;
+  frame.assign((char*)&length, sizeof(length));
+  assert(decode_request(frame.data(), frame.size(), &request) == -1);
+}
+
+void test_response_round_trip() {
+  Response get;
+  get.values = {10, 0};
+  get.found = {1, 0};
+  Response scan;
+  scan.keys = {1, 2};
+  scan.values = {10, 20};
+  Response error;
+  error.status = PROTO_ERROR;
+  string frames;
+  encode_response(PROTO_GET, get, &frames);
+  encode_response(PROTO_SCAN, scan, &frames);
+  encode_response(PROTO_PUT, Response(), &frames);
+  encode_response(PROTO_GET, error, &frames);
+
+  Response response;
+  const char* next = frames.data();
+  const char* end = next + frames.size();
+  next += decode_response(PROTO_GET, next, end - next, &response);
+  assert(response.status == PROTO_OK && response.values == get.values &&
+         response.found == get.found);
+  next += decode_response(PROTO_SCAN, next, end - next, &response);
+  assert(response.keys == scan.keys && response.values == scan.values);
+  next += decode_response(PROTO_PUT, next, end - next, &response);
+  assert(response.status == PROTO_OK && response.values.empty());
+  next += decode_response(PROTO_GET, next, end - next, &response);
+  assert(response.status == PROTO_ERROR && next == end);
+}
+
+int main() {
+  test_request_round_trip();
+  test_partial_frames();
+  test_malformed_requests();
+  test_response_round_trip();
+  cout << "Protocol tests passed!\n";
+  return 0;
+}
@@ -0,0 +1,167 @@
+#include "../src/resp.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <filesystem>
+#include <iostream>
+
+#include "../src/server.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+void cleanup() { fs::remove_all("TEST_RESP"); }
+
+void test_decode() {
+  vector<string> args;
+  string command = "*3\r\n$3\r\nSET\r\n$2\r\n12\r\n$3\r\n345\r\n";
+  assert(decode_resp_command(command.data(), command.size(), &args) ==
+         (long)command.size());
+  assert(args == vector<string>({"SET", "12", "345"}));
+
+  // Partial commands wait for more bytes
+  for (size_t size = 0; size < command.size(); size++) {
+    assert(decode_resp_command(command.data(), size, &args) == 0);
+  }
+
+  // Inline commands, as typed into telnet
+  command = "GET  7\r\nPING\n";
+  long size = decode_resp_command(command.data(), command.size(), &args);
+  assert(size == 8 && args == vector<string>({"GET", "7"}));
+  assert(decode_resp_command(command.data() + size, command.size() - size,
+                             &args) == 5);
+  assert(args == vector<string>({"PING"}));
+
+  command = "*1\r\n#3\r\nGET\r\n";
+  assert(decode_resp_command(command.data(), command.size(), &args) == -1);
+  command = "*1\r\n$3\r\nGETX\r\n";
+  assert(decode_resp_command(command.data(), command.size(), &args) == -1);
+}
+
+void test_commands() {
+  DB db;
+  assert(db.open("TEST_RESP", 8));
+  string out;
+  auto run = [&](vector<string> args) {
+    out.clear();
+    return execute_resp_command(&db, args, &out);
+  };
+  run({"SET", "1", "10"});
+  assert(out == "+OK\r\n");
+  run({"get", "1"});
+  assert(out == "$2\r\n10\r\n");
+  run({"GET", "2"});
+  assert(out == "$-1\r\n");
+  run({"MSET", "2", "20", "3", "30", "4", "40"});
+  assert(out == "+OK\r\n");
+  run({"MGET", "1", "5", "3"});
+  assert(out == "*3\r\n$2\r\n10\r\n$-1\r\n$2\r\n30\r\n");
+  run({"DEL", "1", "5", "2"});
+  assert(out == ":2\r\n");
+  run({"RANGE", "0", "10"});
+  assert(out == "*4\r\n$1\r\n3\r\n$2\r\n30\r\n$1\r\n4\r\n$2\r\n40\r\n");
+  run({"SET", "key", "1"});
+  assert(out[0] == '-');
+  run({"SET", "1", "18446744073709551614"});  // TOMBSTONE is reserved
+  assert(out[0] == '-');
+  run({"SET", "1"});
+  assert(out[0] == '-');
+  run({"FLUSHALL"});
+  assert(out[0] == '-');
+  run({"PING"});
+  assert(out == "+PONG\r\n");
+  assert(!run({"QUIT"}) && out == "+OK\r\n");
+
+  // Batched, SETs wait for the next command that isn't one
+  vector<KVPair> writes;
+  out.clear();
+  execute_resp_command(&db, {"SET", "6", "60"}, &out, &writes);
+  execute_resp_command(&db, {"MSET", "7", "70", "6", "61"}, &out, &writes);
+  assert(out == "+OK\r\n+OK\r\n" && writes.size() == 3);
+  assert(db.scan(6, 7).empty());
+  execute_resp_command(&db, {"MGET", "6", "7"}, &out, &writes);
+  assert(writes.empty());
+  assert(out == "+OK\r\n+OK\r\n*2\r\n$2\r\n61\r\n$2\r\n70\r\n");
+  assert(db.close());
+}
+
+void test_range_cap() {
+  DB db;
+  assert(db.open("TEST_RESP", 2 * RESP_MAX_RANGE_PAIRS));
+  vector<KVPair> kvpairs;
+  for (uint64_t key = 0; key < RESP_MAX_RANGE_PAIRS + 10; key++) {
+    kvpairs.push_back({key, 1});
+  }
+  db.write_batch(kvpairs);
+
+  // Only the lowest pairs fit in a reply; the rest come from the next RANGE
+  string out;
+  execute_resp_command(&db, {"RANGE", "0", "18446744073709551615"}, &out);
+  assert(out.rfind("*" + to_string(2 * RESP_MAX_RANGE_PAIRS) + "\r\n", 0) == 0);
+  string last = "\r\n" + to_string(RESP_MAX_RANGE_PAIRS - 1) + "\r\n$1\r\n1\r\n";
+  assert(out.compare(out.size() - last.size(), last.size(), last) == 0);
+  out.clear();
+  execute_resp_command(&db, {"RANGE", to_string(RESP_MAX_RANGE_PAIRS),
+                             "18446744073709551615"}, &out);
+  assert(out.rfind("*20\r\n", 0) == 0);
+  assert(db.close());
+}
+
+void test_pipelined_server() {
+  DB db;
+  assert(db.open("TEST_RESP", 8));
+  KVServer server;
+  assert(server.start(&db, "127.0.0.1", 0, 1, SERVER_RESP));
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(server.port);
+  inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  assert(connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0);
+
+  // Many commands in one write, answered in order
+  string commands;
+  string expected;
+  for (int i = 0; i < 100; i++) {
+    commands += "*3\r\n$3\r\nSET\r\n$3\r\n" + to_string(100 + i) +
+                "\r\n$1\r\n7\r\n";
+    expected += "+OK\r\n";
+  }
+  commands += "*2\r\n$3\r\nGET\r\n$3\r\n150\r\nQUIT\r\n";
+  expected += "$1\r\n7\r\n+OK\r\n";
+  assert(write(fd, commands.data(), commands.size()) ==
+         (ssize_t)commands.size());
+  string replies;
+  char buff[4096];
+  ssize_t n;
+  while ((n = read(fd, buff, sizeof(buff))) > 0) {
+    replies.append(buff, n);
+  }
+  // The server closed the connection after QUIT
+  assert(n == 0 && replies == expected);
+  close(fd);
+
+  server.stop();
+  server.wait();
+  assert(db.close());
+}
+
+int main() {
+  cleanup();
+
+  test_decode();
+  test_commands();
+  cleanup();
+  test_range_cap();
+  cleanup();
+  test_pipelined_server();
+
+  cleanup();
+  cout << "RESP tests passed!\n";
+  return 0;
+}
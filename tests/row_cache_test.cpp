@@ -0,0 +1,86 @@
+#include "../src/row_cache.h"
+
+#include <cassert>
+#include <iostream>
+
+using namespace std;
+
+void test_get_put() {
+  RowCache cache(1 << 20);
+  uint64_t value;
+
+  assert(cache.get(1, &value) == ROW_MISS);
+  cache.put(1, 10);
+  assert(cache.get(1, &value) == ROW_FOUND && value == 10);
+
+  cache.put(1, 11);
+  assert(cache.get(1, &value) == ROW_FOUND && value == 11);
+
+  cache.put_absent(2);
+  assert(cache.get(2, &value) == ROW_ABSENT);
+
+  cache.erase(1);
+  cache.erase(2);
+  assert(cache.get(1, &value) == ROW_MISS);
+  assert(cache.get(2, &value) == ROW_MISS);
+}
+
+void test_byte_budget() {
+  size_t budget = 100 * ROW_CACHE_ENTRY_BYTES;
+  RowCache cache(budget, 1);
+  uint64_t value;
+
+  for (uint64_t i = 0; i < 1000; i++) {
+    cache.put(i, i * 10);
+  }
+  assert(cache.shards[0]->used_bytes <= budget);
+  assert(cache.shards[0]->lru.size() == 100);
+
+  // The least recently used rows were evicted first
+  assert(cache.get(0, &value) == ROW_MISS);
+  assert(cache.get(999, &value) == ROW_FOUND && value == 9990);
+  assert(cache.get(900, &value) == ROW_FOUND && value == 9000);
+}
+
+void test_shards() {
+  RowCache cache(1 << 20, 16);
+  for (uint64_t i = 0; i < 1600; i++) {
+    cache.put(i, i);
+  }
+
+  // Sequential keys should land in every shard
+  for (auto& shard : cache.shards) {
+    assert(shard->lru.size() > 0);
+  }
+  assert(cache.memory_usage() >= 1600 * ROW_CACHE_ENTRY_BYTES);
+}
+
+void test_erase_range() {
+  RowCache cache(1 << 20, 4);
+  uint64_t value;
+  for (uint64_t i = 0; i < 100; i++) {
+    cache.put(i, i);
+  }
+  cache.put_absent(100);
+
+  cache.erase_range(10, 19);
+  cache.erase_range(100, 200);
+  for (uint64_t i = 0; i <= 100; i++) {
+    bool erased = (i >= 10 && i <= 19) || i == 100;
+    assert(cache.get(i, &value) == (erased ? ROW_MISS : ROW_FOUND));
+  }
+  size_t used_bytes = 0;
+  for (auto& shard : cache.shards) {
+    used_bytes += shard->used_bytes;
+  }
+  assert(used_bytes == 90 * ROW_CACHE_ENTRY_BYTES);
+}
+
+int main() {
+  test_get_put();
+  test_byte_budget();
+  test_shards();
+  test_erase_range();
+  cout << "Row cache tests passed!\n";
+  return 0;
+}
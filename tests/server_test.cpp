@@ -0,0 +1,146 @@
+#include "../src/server.h"
+
+#include <cassert>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#include "../src/kv_client.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+void cleanup() { fs::remove_all("TEST_SERVER"); }
+
+void test_operations(int port) {
+  KVClient client;
+  assert(client.connect("127.0.0.1", port));
+  uint64_t value;
+  bool found;
+  assert(client.put(1, 10));
+  assert(client.get(1, &value, &found) && found && value == 10);
+  assert(client.del(1));
+  assert(client.get(1, &value, &found) && !found);
+
+  // Batches
+  vector<KVPair> kvpairs;
+  for (uint64_t i = 100; i < 200; i++) {
+    kvpairs.push_back({i, i * 2});
+  }
+  assert(client.multi_put(kvpairs));
+  assert(client.multi_del({100, 150}));
+  vector<uint64_t> values;
+  vector<uint8_t> founds;
+  assert(client.multi_get({99, 100, 101, 199}, &values, &founds));
+  assert(founds == vector<uint8_t>({0, 0, 1, 1}));
+  assert(values[2] == 202 && values[3] == 398);
+
+  vector<KVPair> scanned;
+  assert(client.scan(100, 199, &scanned));
+  assert(scanned.size() == 98);
+  assert(scanned.front().key == 101 && scanned.back().key == 199);
+  client.close();
+}
+
+void test_pipelining(int port) {
+  KVClient client;
+  assert(client.connect("127.0.0.1", port));
+  for (uint64_t i = 0; i < 1000; i++) {
+    client.send({PROTO_PUT, {1000 + i}, {i}});
+    client.send({PROTO_GET, {1000 + i}, {}});
+  }
+  assert(client.in_flight() == 2000);
+  Response response;
+  for (uint64_t i = 0; i < 1000; i++) {
+    assert(client.receive(&response));
+    assert(client.receive(&response));
+    assert(response.found[0] && response.values[0] == i);
+  }
+  assert(client.in_flight() == 0);
+  client.close();
+}
+
+void test_backed_up_output(int port) {
+  KVClient client;
+  assert(client.connect("127.0.0.1", port));
+  // More than SERVER_MAX_PENDING_OUTPUT of responses, sent before any is read
+  for (uint64_t i = 0; i < 4000; i++) {
+    client.send({PROTO_SCAN, {100}, {199}});
+  }
+  assert(client.flush());
+  Response response;
+  for (uint64_t i = 0; i < 4000; i++) {
+    assert(client.receive(&response));
+    assert(response.keys.size() == 98);
+  }
+  client.close();
+}
+
+void test_many_connections(int port) {
+  vector<thread> threads;
+  for (uint64_t t = 0; t < 32; t++) {
+    threads.push_back(thread([port, t]() {
+      KVClient client;
+      assert(client.connect("127.0.0.1", port));
+      for (uint64_t i = 0; i < 50; i++) {
+        uint64_t key = 10000 + t * 50 + i;
+        uint64_t value;
+        bool found;
+        assert(client.put(key, key + 1));
+        assert(client.get(key, &value, &found) && found && value == key + 1);
+      }
+      client.close();
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+void test_malformed_request(int port) {
+  KVClient client;
+  assert(client.connect("127.0.0.1", port));
+  client.send({9, {1}, {}});
+  Response response;
+  assert(!client.receive(&response) && response.status == PROTO_ERROR);
+  // The server closes the connection after answering
+  client.send({PROTO_GET, {1}, {}});
+  assert(!client.receive(&response));
+  client.close();
+
+  // A PUT of TOMBSTONE is refused rather than deleting the key
+  assert(client.connect("127.0.0.1", port));
+  assert(client.put(5000, 1));
+  client.send({PROTO_PUT, {5000}, {TOMBSTONE}});
+  assert(!client.receive(&response) && response.status == PROTO_ERROR);
+  client.close();
+  assert(client.connect("127.0.0.1", port));
+  uint64_t value;
+  bool found;
+  assert(client.get(5000, &value, &found) && found && value == 1);
+  client.close();
+}
+
+int main() {
+  cleanup();
+
+  DB db;
+  assert(db.open("TEST_SERVER", 64));
+  KVServer server;
+  assert(server.start(&db, "127.0.0.1", 0, 2));
+  assert(server.port > 0);
+
+  test_operations(server.port);
+  test_pipelining(server.port);
+  test_backed_up_output(server.port);
+  test_many_connections(server.port);
+  test_malformed_request(server.port);
+
+  server.stop();
+  server.wait();
+  assert(db.close());
+
+  cleanup();
+  cout << "Server tests passed!\n";
+  return 0;
+}
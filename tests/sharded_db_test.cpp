@@ -0,0 +1,100 @@
+#include "../src/sharded_db.h"
+
+#include <cassert>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#include "../src/exceptions.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+void cleanup() {
+  fs::remove_all("TEST_SHARDED");
+  fs::remove_all("TEST_SHARDED_CONCURRENT");
+  fs::remove_all("TEST_NOT_SHARDED");
+}
+
+void test_put_get_del() {
+  ShardedDB db;
+  assert(db.open("TEST_SHARDED", 4, 10));
+  assert(fs::is_directory("TEST_SHARDED/shard-3"));
+  for (uint64_t i = 0; i < 200; i++) {
+    db.put(i, i + 1);
+  }
+  for (uint64_t i = 0; i < 200; i += 3) {
+    db.del(i);
+  }
+  for (uint64_t i = 0; i < 200; i++) {
+    if (i % 3 == 0) {
+      try {
+        db.get(i);
+        assert(false);
+      } catch (const KeyException& e) {
+      }
+    } else {
+      assert(db.get(i) == i + 1);
+    }
+  }
+
+  // Sequential keys are spread over every shard
+  for (auto& shard : db.shards) {
+    assert(shard->db.sst_names.size() > 0);
+  }
+
+  // Scans merge the shards in key order
+  vector<KVPair> scanned = db.scan(10, 59);
+  assert(scanned.size() == 34);
+  for (size_t i = 1; i < scanned.size(); i++) {
+    assert(scanned[i - 1].key < scanned[i].key);
+  }
+  assert(db.close());
+
+  // The shard count is fixed when the database is created
+  assert(!db.open("TEST_SHARDED", 2));
+  assert(db.open("TEST_SHARDED"));
+  assert(db.shards.size() == 4);
+  assert(db.get(1) == 2);
+  assert(db.scan(0, 199).size() == 133);
+  assert(db.close());
+
+  DB plain;
+  assert(plain.open("TEST_NOT_SHARDED"));
+  assert(plain.close());
+  assert(!db.open("TEST_NOT_SHARDED"));
+}
+
+void test_concurrent() {
+  ShardedDB db;
+  db.pin_threads = false;
+  assert(db.open("TEST_SHARDED_CONCURRENT", 3, 50));
+  const uint64_t KEYS_PER_THREAD = 500;
+  vector<thread> threads;
+  for (uint64_t t = 0; t < 4; t++) {
+    threads.push_back(thread([&db, t, KEYS_PER_THREAD]() {
+      for (uint64_t i = 0; i < KEYS_PER_THREAD; i++) {
+        uint64_t key = t * KEYS_PER_THREAD + i;
+        db.put(key, key * 2);
+        assert(db.get(key) == key * 2);
+      }
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  assert(db.scan(0, 4 * KEYS_PER_THREAD).size() == 4 * KEYS_PER_THREAD);
+  assert(db.close());
+}
+
+int main() {
+  cleanup();
+
+  test_put_get_del();
+  test_concurrent();
+
+  cleanup();
+  cout << "Sharded DB tests passed!\n";
+  return 0;
+}
@@ -6,9 +6,13 @@
 
 #include <cassert>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <vector>
 
+#include "../src/exceptions.h"
+#include "../src/perf_context.h"
+
 using namespace std;
 namespace fs = std::filesystem;
 
@@ -25,7 +29,8 @@ void test_sst_read_write_newfile() {
       {.key = 5, .value = 6},
   };
 
-  write_sst(kv_pairs, filename);
+  assert(write_sst(kv_pairs, filename));
+  assert(!write_sst(kv_pairs, "no_such_directory/" + filename));
   vector<KVPair> result = read_sst(filename);
 
   for (int i = 0; i < kv_pairs.size(); i++) {
@@ -78,10 +83,271 @@ void test_sst_big() {
   fs::remove(filename);
 }
 
+void test_sst_scan_buffer_pool() {
+  string filename = "test_sst_scan_buffer_pool.sst";
+  uint64_t size = 10000;
+
+  vector<KVPair> pairs;
+  for (uint64_t i = 0; i < size; i++) {
+    pairs.push_back({.key = i, .value = i + size});
+  }
+  write_sst(pairs, filename);
+
+  BufferPool bp = BufferPool(4, 64);
+
+  // Whole-file reads never fill the pool
+  vector<KVPair> all = read_sst(filename, &bp);
+  assert(all.size() == size);
+  assert(bp.num_pages == 0);
+
+  vector<KVPair> expected = sst_scan(filename, 1000, 2999);
+  vector<KVPair> first = sst_scan(filename, 1000, 2999, &bp);
+  assert(bp.num_pages > 0);
+  int cached = bp.num_pages;
+
+  // The second scan is served from the pool
+  vector<KVPair> second = sst_scan(filename, 1000, 2999, &bp);
+  assert(bp.num_pages == cached);
+  assert(first.size() == 2000 && first == expected && second == expected);
+
+  // Bypass reads use cached pages and agree with the file
+  assert(read_sst(filename, &bp) == all);
+
+  fs::remove(filename);
+}
+
+void test_sst_versions() {
+  string filename = "test_sst_versions.sst";
+  // Five versions of each key, newest first, so some keys span two pages
+  vector<KVPair> pairs;
+  for (uint64_t key = 0; key < 100; key++) {
+    for (uint64_t version = 5; version >= 1; version--) {
+      uint64_t value = version == 5 && key % 10 == 0 ? TOMBSTONE : version;
+      pairs.push_back({.key = key, .value = value, .seq = key * 10 + version});
+    }
+  }
+  write_sst(pairs, filename);
+  assert(sst_has_sequences(filename));
+  assert(read_sst(filename).size() == pairs.size());
+
+  BufferPool bp = BufferPool(4, 64);
+  for (uint64_t key = 0; key < 100; key++) {
+    uint64_t newest = key % 10 == 0 ? TOMBSTONE : 5;
+    assert(sst_get(filename, key, NULL, false) == newest);
+    assert(sst_get(filename, key, &bp, false) == newest);
+    for (uint64_t version = 1; version <= 4; version++) {
+      assert(sst_get(filename, key, &bp, false, NULL, key * 10 + version) ==
+             version);
+    }
+    // Written after the snapshot
+    try {
+      sst_get(filename, key, &bp, false, NULL, key * 10);
+      assert(false);
+    } catch (const KeyException &e) {
+    }
+  }
+  assert(sst_scan(filename, 34, 35).size() == 10);
+
+  fs::remove(filename);
+}
+
+void test_page_summaries() {
+  string filename = "test_page_summaries.sst";
+  // Page 0 holds only values, page 1 a tombstone and two versions of a key
+  // that continues into page 2, which also holds an operand
+  vector<KVPair> pairs;
+  for (uint64_t key = 0; key < 3 * SST_PAGE_ENTRIES - 2; key++) {
+    pairs.push_back({.key = key, .value = key + 1, .seq = key + 1});
+  }
+  pairs[SST_PAGE_ENTRIES].value = TOMBSTONE;
+  pairs[2 * SST_PAGE_ENTRIES - 1].key = 2 * SST_PAGE_ENTRIES;
+  pairs[2 * SST_PAGE_ENTRIES].seq = 1;
+  pairs[2 * SST_PAGE_ENTRIES + 1].seq |= MERGE_OPERAND;
+  write_sst(pairs, filename);
+  assert(sst_has_summaries(filename));
+
+  vector<PageSummary> summaries;
+  assert(read_page_summaries(filename, &summaries));
+  assert(summaries.size() == 3);
+  uint64_t n = SST_PAGE_ENTRIES;
+  assert(summaries[0].flags == PAGE_DISTINCT);
+  assert(summaries[0].min_key == 0 && summaries[0].max_key == n - 1);
+  assert(summaries[0].count == n && summaries[0].sum == n * (n + 1) / 2);
+  assert(summaries[0].min_value == 1 && summaries[0].max_value == n);
+  assert(summaries[0].max_sequence == n);
+  assert(summaries[1].flags == 0);
+  assert(summaries[1].count == n - 1 && summaries[1].min_value == n + 2);
+  assert(summaries[2].flags == PAGE_OPERANDS);
+  assert(summaries[2].max_key == 3 * n - 3);
+
+  vector<KVPair> expected = sst_scan(filename, n - 1, 2 * n);
+  assert(sst_read_pages(filename, {0, 1, 2}, n - 1, 2 * n) == expected);
+  assert(sst_read_pages(filename, {1}, 0, MAX_KEY).size() == n);
+  // Cursors read the same pairs a page at a time
+  auto read_cursor = [&](const vector<int>* pages) {
+    vector<KVPair> read;
+    for (SSTCursor cursor(filename, pages, n - 1, 2 * n); cursor.valid();
+         cursor.next()) {
+      read.push_back(cursor.get());
+    }
+    return read;
+  };
+  assert(read_cursor(NULL) == expected);
+  vector<int> pages = {0, 2};
+  assert(read_cursor(&pages) == sst_read_pages(filename, pages, n - 1, 2 * n));
+  fs::remove(filename);
+
+  // Page counts stay right however many pages of summaries follow the pages
+  for (uint64_t size : {SST_PAGE_SUMMARIES * n - 1, SST_PAGE_SUMMARIES * n,
+                        (SST_PAGE_SUMMARIES + 1) * n}) {
+    pairs.clear();
+    for (uint64_t key = 0; key < size; key++) {
+      pairs.push_back({.key = key, .value = key, .seq = 1});
+    }
+    write_sst(pairs, filename);
+    assert(read_page_summaries(filename, &summaries));
+    assert(summaries.size() == size / n + 1);
+    assert(summaries.back().count == size % n);
+    assert(sst_get(filename, size - 1, NULL, false) == size - 1);
+    assert(sst_scan(filename, size - 2, MAX_KEY).size() == 2);
+    fs::remove(filename);
+  }
+}
+
+void test_sst_scan_reverse() {
+  string filename = "test_sst_scan_reverse.sst";
+  // Three versions of every even key, so some keys span two pages
+  vector<KVPair> pairs;
+  for (uint64_t key = 0; key < 2000; key += 2) {
+    for (uint64_t version = 3; version >= 1; version--) {
+      pairs.push_back({.key = key, .value = key + version, .seq = key + version});
+    }
+  }
+  write_sst(pairs, filename);
+
+  BufferPool bp = BufferPool(4, 64);
+  vector<KVPair> all = sst_scan(filename, MIN_KEY, MAX_KEY);
+  assert(all == pairs);
+  for (auto range : vector<pair<uint64_t, uint64_t>>{
+           {MIN_KEY, MAX_KEY}, {0, 0}, {7, 7}, {301, 1201}, {1000, 5000}}) {
+    for (size_t limit : {(size_t)0, (size_t)1, (size_t)57, SIZE_MAX}) {
+      vector<KVPair> forward, backward;
+      size_t keys = 0;
+      for (size_t i = 0; i < all.size(); i += 3) {
+        if (range.first <= all[i].key && all[i].key <= range.second &&
+            keys++ < limit) {
+          forward.insert(forward.end(), all.begin() + i, all.begin() + i + 3);
+        }
+      }
+      keys = 0;
+      for (size_t i = all.size(); i > 0; i -= 3) {
+        if (range.first <= all[i - 1].key && all[i - 1].key <= range.second &&
+            keys++ < limit) {
+          backward.insert(backward.end(), all.begin() + i - 3,
+                          all.begin() + i);
+        }
+      }
+      assert(sst_scan(filename, range.first, range.second, &bp, NULL, limit) ==
+             forward);
+      assert(sst_scan(filename, range.first, range.second, &bp, NULL, limit,
+                      true) == backward);
+    }
+  }
+
+  // The newest keys are on the last pages
+  PerfContext *context = get_perf_context();
+  set_perf_level(PERF_COUNT);
+  context->reset();
+  assert(sst_scan(filename, MIN_KEY, MAX_KEY, NULL, NULL, 10, true).size() ==
+         30);
+  assert(context->pages_from_disk == 1);
+  context->reset();
+  assert(sst_scan(filename, MIN_KEY, 999, NULL, NULL, 10, true).size() == 30);
+  assert(context->pages_from_disk < 20);
+  set_perf_level(PERF_DISABLED);
+
+  fs::remove(filename);
+}
+
+void test_sst_writer() {
+  string filename = "test_sst_writer.sst";
+  SSTWriter writer(filename);
+  assert(!writer.finish());
+  for (uint64_t key = 0; key < 1000; key++) {
+    assert(writer.add(key * 3, key));
+  }
+  assert(!writer.add(2997, 1));  // Not above the last key
+  assert(!writer.add(3000, TOMBSTONE));
+  assert(writer.finish());
+
+  assert(sst_has_summaries(filename));
+  vector<KVPair> pairs = read_sst(filename);
+  assert(pairs.size() == 1000);
+  for (uint64_t key = 0; key < 1000; key++) {
+    assert(pairs[key] == KVPair({key * 3, key}) && pairs[key].seq == 0);
+  }
+  vector<PageSummary> summaries;
+  assert(read_page_summaries(filename, &summaries));
+  assert(summaries[0].flags == PAGE_DISTINCT);
+  assert(sst_get(filename, 300, NULL, false) == 100);
+  assert(!writer.add(4000, 1));  // Finished
+
+  // The pages are streamed out, to the same file write_sst lays out
+  string expected_filename = "test_sst_writer_expected.sst";
+  for (uint64_t size : {1u, SST_PAGE_ENTRIES - 1, SST_PAGE_ENTRIES,
+                        2 * SST_PAGE_ENTRIES + 5, B * SST_PAGE_ENTRIES}) {
+    SSTWriter sized_writer(filename);
+    pairs.clear();
+    for (uint64_t key = 0; key < size; key++) {
+      assert(sized_writer.add(key * 2, key));
+      pairs.push_back({key * 2, key, 0});
+    }
+    assert(sized_writer.finish());
+    write_sst(pairs, expected_filename);
+    ifstream written(filename, ios::binary);
+    ifstream expected(expected_filename, ios::binary);
+    assert(string(istreambuf_iterator<char>(written), {}) ==
+           string(istreambuf_iterator<char>(expected), {}));
+  }
+  fs::remove(expected_filename);
+  fs::remove(filename);
+}
+
+// With whole pages of pairs, the NULL_PAIR ending the file is alone on the
+// last page, which searches must not take for one past every key
+void test_sst_whole_pages() {
+  string filename = "test_sst_whole_pages.sst";
+  for (uint64_t size : {SST_PAGE_ENTRIES, 5 * SST_PAGE_ENTRIES}) {
+    vector<KVPair> pairs;
+    for (uint64_t key = 0; key < size; key++) {
+      pairs.push_back({key * 2, key});
+    }
+    assert(write_sst(pairs, filename));
+    for (uint64_t key = 0; key < size; key++) {
+      assert(sst_get(filename, key * 2, NULL, false) == key);
+      assert(sst_scan(filename, key * 2, key * 2) ==
+             vector<KVPair>({{key * 2, key}}));
+    }
+    try {
+      sst_get(filename, size * 2, NULL, false);
+      assert(false);
+    } catch (const KeyException& e) {
+    }
+    assert(sst_scan(filename, size * 2, MAX_KEY).empty());
+  }
+  fs::remove(filename);
+}
+
 int main() {
   test_sst_read_write_newfile();
   test_sst_read_write_existing();
   test_sst_big();
+  test_sst_scan_buffer_pool();
+  test_sst_versions();
+  test_page_summaries();
+  test_sst_scan_reverse();
+  test_sst_writer();
+  test_sst_whole_pages();
   cout << "SST tests passed!\n";
   return 0;
 }
@@ -0,0 +1,131 @@
+#include "../src/statistics.h"
+
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+void test_buckets() {
+  // Small values are exact
+  for (uint64_t v = 0; v < (uint64_t)HISTOGRAM_SUB_BUCKETS; v++) {
+    assert(histogram_bucket(v) == (int)v);
+  }
+  // Every value falls in the bucket whose range contains it, and buckets are
+  // contiguous
+  uint64_t values[] = {32, 33, 63, 64, 65, 1000, 123456789, 1ULL << 40,
+                       0xffffffffffffffffULL};
+  for (uint64_t v : values) {
+    int bucket = histogram_bucket(v);
+    assert(bucket < HISTOGRAM_BUCKETS);
+    assert(histogram_bucket_low(bucket) <= v);
+    assert(v - histogram_bucket_low(bucket) < histogram_bucket_width(bucket));
+  }
+  for (int b = 1; b < HISTOGRAM_BUCKETS; b++) {
+    assert(histogram_bucket_low(b) ==
+           histogram_bucket_low(b - 1) + histogram_bucket_width(b - 1));
+  }
+}
+
+void test_percentiles() {
+  Histogram h;
+  assert(h.percentile(99) == 0 && h.mean() == 0);
+  for (uint64_t v = 1; v <= 10000; v++) {
+    h.record(v);
+  }
+  assert(h.count == 10000 && h.min == 1 && h.max == 10000);
+  assert(h.mean() == 5000.5);
+  // Within the bucket resolution of the exact percentile
+  uint64_t p50 = h.percentile(50);
+  uint64_t p99 = h.percentile(99);
+  assert(p50 >= 5000 && p50 <= 5000 + 5000 / HISTOGRAM_SUB_BUCKETS);
+  assert(p99 >= 9900 && p99 <= 9900 + 9900 / HISTOGRAM_SUB_BUCKETS);
+  assert(h.percentile(100) == 10000);
+  assert(h.percentile(0) == 1);
+
+  Histogram other;
+  other.record(1000000);
+  h.merge(other);
+  assert(h.count == 10001 && h.max == 1000000);
+  assert(h.percentile(100) == 1000000);
+}
+
+void test_threads_merged() {
+  Statistics stats;
+  vector<thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.push_back(thread([&stats, t]() {
+      for (int i = 0; i < 1000; i++) {
+        stats.record(DB_GET, 100 * (t + 1));
+      }
+      stats.record(DB_PUT, 7);
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  // Histograms of exited threads are kept
+  StatisticsReport report = stats.report();
+  assert(report.histograms[DB_GET].count == 4000);
+  assert(report.histograms[DB_GET].min == 100);
+  assert(report.histograms[DB_GET].max == 400);
+  assert(report.histograms[DB_PUT].count == 4);
+  assert(report.histograms[DB_SCAN].count == 0);
+
+  // A thread recording into two Statistics keeps them apart
+  Statistics other;
+  other.record(DB_GET, 1);
+  stats.record(DB_GET, 1);
+  assert(other.report().histograms[DB_GET].count == 1);
+  assert(stats.report().histograms[DB_GET].count == 4001);
+}
+
+void test_tickers() {
+  Statistics stats;
+  thread other([&stats]() { stats.add(SST_BYTES_READ, 4096); });
+  other.join();
+  stats.add(SST_BYTES_READ, 100);
+  stats.add(USER_BYTES_WRITTEN, 16);
+  StatisticsReport report = stats.report();
+  assert(report.tickers[SST_BYTES_READ] == 4196);
+  assert(report.tickers[USER_BYTES_WRITTEN] == 16);
+  assert(report.tickers[SST_BYTES_WRITTEN] == 0);
+  assert(report.to_json().find("\"sst.bytes_read\": 4196") != string::npos);
+  assert(report.to_string().find("user.bytes_written 16\n") != string::npos);
+}
+
+void test_stop_watch() {
+  Statistics stats;
+  {
+    StopWatch timer(&stats, SST_WRITE);
+    this_thread::sleep_for(chrono::milliseconds(2));
+  }
+  { StopWatch timer(NULL, SST_WRITE); }
+  StatisticsReport report = stats.report();
+  Histogram& h = report.histograms[SST_WRITE];
+  assert(h.count == 1 && h.min >= 2000000);
+}
+
+void test_dump() {
+  Statistics stats;
+  stats.record(DB_SCAN, 1500);
+  StatisticsReport report = stats.report();
+  string text = report.to_string();
+  assert(text.find("db.scan count: 1 ") != string::npos);
+  string json = report.to_json();
+  assert(json.front() == '{' && json.back() == '}');
+  assert(json.find("\"db.scan\": {\"count\": 1,") != string::npos);
+  assert(json.find("\"sst.page_read\": {\"count\": 0,") != string::npos);
+}
+
+int main() {
+  test_buckets();
+  test_percentiles();
+  test_threads_merged();
+  test_tickers();
+  test_stop_watch();
+  test_dump();
+  cout << "Statistics tests passed!\n";
+  return 0;
+}
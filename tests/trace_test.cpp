@@ -0,0 +1,73 @@
+#include "../src/trace.h"
+
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const string TRACE_NAME = "test_trace.trace";
+
+void test_round_trip() {
+  TraceWriter writer;
+  assert(writer.open(TRACE_NAME));
+  // More records than fit in one buffer
+  int num_records = TRACE_BUFFER_RECORDS + 10;
+  for (int i = 0; i < num_records; i++) {
+    writer.record(i % 4, i, i * 2);
+  }
+  assert(writer.close());
+
+  TraceReader reader;
+  assert(reader.open(TRACE_NAME));
+  TraceRecord record;
+  uint64_t last_timestamp = 0;
+  for (int i = 0; i < num_records; i++) {
+    assert(reader.next(&record));
+    assert(record.op == (uint32_t)i % 4);
+    assert(record.key == (uint64_t)i && record.arg == (uint64_t)i * 2);
+    assert(record.timestamp >= last_timestamp);
+    last_timestamp = record.timestamp;
+  }
+  assert(!reader.next(&record));
+  reader.close();
+  fs::remove(TRACE_NAME);
+}
+
+void test_torn_record_ends_trace() {
+  TraceWriter writer;
+  assert(writer.open(TRACE_NAME));
+  writer.record(TRACE_PUT, 1, 2);
+  writer.record(TRACE_GET, 1, 0);
+  assert(writer.close());
+  fs::resize_file(TRACE_NAME, fs::file_size(TRACE_NAME) - 5);
+
+  TraceReader reader;
+  assert(reader.open(TRACE_NAME));
+  TraceRecord record;
+  assert(reader.next(&record) && record.op == TRACE_PUT);
+  assert(!reader.next(&record));
+  reader.close();
+  fs::remove(TRACE_NAME);
+}
+
+void test_not_a_trace() {
+  ofstream out(TRACE_NAME);
+  out << "this is not a trace file";
+  out.close();
+
+  TraceReader reader;
+  assert(!reader.open(TRACE_NAME));
+  assert(!reader.open("no_such_file.trace"));
+  fs::remove(TRACE_NAME);
+}
+
+int main() {
+  test_round_trip();
+  test_torn_record_ends_trace();
+  test_not_a_trace();
+  cout << "Trace tests passed!\n";
+  return 0;
+}
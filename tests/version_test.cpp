@@ -0,0 +1,68 @@
+#include "../src/version.h"
+
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+namespace fs = std::filesystem;
+
+const string SST_NAME = "test_version.sst";
+
+FileMeta file_meta(int number, int level, uint64_t entries,
+                   uint64_t deletions) {
+  FileMeta meta = {};
+  meta.number = number;
+  meta.level = level;
+  meta.num_entries = entries;
+  meta.num_deletions = deletions;
+  return meta;
+}
+
+void test_obsolete_file_outlives_readers() {
+  ofstream(SST_NAME) << "data";
+  auto file = make_shared<SSTFile>(file_meta(0, 0, 1, 0), SST_NAME);
+  auto old_version = make_shared<Version>();
+  old_version->files.push_back(file);
+  auto new_version = make_shared<Version>();
+  file = NULL;
+
+  // A compaction replaced the file while a read still holds old_version
+  shared_ptr<Version> reader = old_version;
+  old_version->files[0]->obsolete = true;
+  old_version = new_version;
+  assert(fs::exists(SST_NAME));
+  reader = NULL;
+  assert(!fs::exists(SST_NAME));
+}
+
+void test_live_file_kept() {
+  ofstream(SST_NAME) << "data";
+  {
+    Version version;
+    version.files.push_back(
+        make_shared<SSTFile>(file_meta(0, 0, 1, 0), SST_NAME));
+  }
+  assert(fs::exists(SST_NAME));
+  fs::remove(SST_NAME);
+}
+
+void test_levels_and_keys() {
+  Version version;
+  version.files.push_back(make_shared<SSTFile>(file_meta(3, 1, 100, 0), ""));
+  version.files.push_back(make_shared<SSTFile>(file_meta(4, 0, 20, 5), ""));
+  version.files.push_back(make_shared<SSTFile>(file_meta(5, 0, 4, 3), ""));
+  assert(version.num_files_at_level(0) == 2);
+  assert(version.num_files_at_level(1) == 1);
+  assert(version.num_files_at_level(2) == 0);
+  assert(version.estimate_live_keys() == 100 + 10 + 0);
+}
+
+int main() {
+  test_obsolete_file_outlives_readers();
+  test_live_file_kept();
+  test_levels_and_keys();
+  cout << "Version tests passed!\n";
+  return 0;
+}